@@ -0,0 +1,180 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+// Generates the translation units of a synthetic program for the loading
+// benchmark: structures nested in deep namespaces, derived classes with
+// virtual methods, template instances, enumerations, annotations and typeof
+// sites. Every unit has a namespace of its own and refers to no other, so
+// that filters may leave out any of them.
+
+namespace {
+
+    struct Corpus {
+        std::string name;
+        int units;
+        int structs;    // per unit
+        int depth;      // of the namespaces
+    };
+
+    std::string namespace_of(const Corpus& corpus, int unit) {
+        std::string path = "corpus::u" + std::to_string(unit);
+        for (int level = 1; level < corpus.depth; ++level)
+            path += "::l" + std::to_string(level);
+        return path;
+    }
+
+    std::string struct_name(int unit, int index) {
+        return "S" + std::to_string(unit) + "_" + std::to_string(index);
+    }
+
+    void write_header(const Corpus& corpus, const std::string& path) {
+        std::ofstream out(path);
+        int last = corpus.units - 1;
+        out << "// generated by bench_corpus, do not edit\n"
+            << "#ifndef CORPUS_HH\n"
+            << "# define CORPUS_HH\n\n"
+            << "# include <cstddef>\n"
+            << "# include \"insight/annotate\"\n\n"
+            << "# define CORPUS_NAME \"" << corpus.name << "\"\n"
+            << "# define CORPUS_UNITS " << corpus.units << "\n"
+            << "# define CORPUS_STRUCTS " << corpus.units * corpus.structs << "\n"
+            << "# define CORPUS_FIRST_NAMESPACE \"" << namespace_of(corpus, 0) << "\"\n"
+            << "# define CORPUS_LAST_TYPE \"" << namespace_of(corpus, last)
+            << "::" << struct_name(last, corpus.structs - 1) << "\"\n\n"
+            << "insight_annotation(CorpusTag) {\n"
+            << "    int id;\n"
+            << "};\n\n"
+            << "namespace corpus {\n\n"
+            << "    template <typename T, int N>\n"
+            << "    struct Box {\n"
+            << "        T items[N];\n"
+            << "        Box* next;\n"
+            << "        size_t count;\n"
+            << "    };\n\n"
+            << "}\n\n"
+            << "#endif /* !CORPUS_HH */\n";
+    }
+
+    // Each structure refers to the previous one, in one of four ways.
+    void write_struct(std::ostream& out, int unit, int index) {
+        std::string name = struct_name(unit, index);
+        std::string previous = index ? struct_name(unit, index - 1) : "";
+        std::string id = std::to_string(unit * 100000 + index);
+
+        if (index % 4 == 0)
+            out << "enum class Kind" << index << " { A, B, C };\n";
+        if (index % 8 == 0)
+            out << "$(CorpusTag, .id = " << id << ")\n";
+
+        switch (index % 4) {
+            case 0:
+                out << "struct " << name << " {\n"
+                    << "    int id;\n"
+                    << "    double weight;\n"
+                    << "    const char* label;\n"
+                    << "    Kind" << index << " kind;\n"
+                    << "    " << name << "* next;\n"
+                    << "};\n";
+                break;
+            case 1:
+                out << "struct " << name << " : " << previous << " {\n"
+                    << "    long extra;\n"
+                    << "    virtual ~" << name << "() {}\n"
+                    << "    virtual int value() const;\n"
+                    << "};\n"
+                    << "int " << name << "::value() const { return id + extra; }\n";
+                break;
+            case 2:
+                out << "struct " << name << " {\n"
+                    << "    ::corpus::Box<" << previous << "*, " << index % 7 + 1 << "> box;\n"
+                    << "    char name[" << index % 13 + 3 << "];\n"
+                    << "    unsigned short flags;\n"
+                    << "};\n";
+                break;
+            case 3:
+                out << "class " << name << " {\n"
+                    << "public:\n"
+                    << "    $(CorpusTag, .id = " << id << ")\n"
+                    << "    " << previous << " inner;\n"
+                    << "    int count(int limit) const;\n"
+                    << "    static " << name << "* make();\n"
+                    << "private:\n"
+                    << "    float ratio;\n"
+                    << "};\n"
+                    << "int " << name << "::count(int limit) const { return limit + static_cast<int>(ratio); }\n"
+                    << name << "* " << name << "::make() { return new " << name << "(); }\n";
+                break;
+        }
+        out << name << " instance_" << index << ";\n\n";
+    }
+
+    void write_unit(const Corpus& corpus, int unit, const std::string& path) {
+        std::ofstream out(path);
+        out << "// generated by bench_corpus, do not edit\n"
+            << "#include \"insight/insight\"\n"
+            << "#include \"corpus.hh\"\n\n";
+
+        std::string ns = namespace_of(corpus, unit);
+        size_t levels = 0;
+        for (size_t start = 0; start != std::string::npos; ++levels) {
+            size_t end = ns.find("::", start);
+            out << "namespace " << ns.substr(start, end - start) << " {\n";
+            start = end == std::string::npos ? end : end + 2;
+        }
+        out << "\n";
+
+        for (int index = 0; index < corpus.structs; ++index)
+            write_struct(out, unit, index);
+
+        // a typeof site for every eighth structure
+        for (int index = 0; index < corpus.structs; index += 8) {
+            std::string name = struct_name(unit, index);
+            out << "Insight::TypeInfo& typeof_" << name << "() {\n"
+                << "    return type_of(instance_" << index << ");\n"
+                << "}\n";
+        }
+
+        for (size_t level = 0; level < levels; ++level)
+            out << "}\n";
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 6) {
+        std::fprintf(stderr, "usage: %s <directory> <name> <units> <structs per unit> <namespace depth>\n", argv[0]);
+        return 1;
+    }
+    std::string directory = argv[1];
+    Corpus corpus{argv[2], std::atoi(argv[3]), std::atoi(argv[4]), std::atoi(argv[5])};
+    if (corpus.units < 1 || corpus.structs < 1 || corpus.depth < 1) {
+        std::fprintf(stderr, "%s: the counts must be positive\n", argv[0]);
+        return 1;
+    }
+
+    write_header(corpus, directory + "/corpus.hh");
+    for (int unit = 0; unit < corpus.units; ++unit)
+        write_unit(corpus, unit, directory + "/unit_" + std::to_string(unit) + ".cc");
+    return 0;
+}
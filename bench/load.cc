@@ -0,0 +1,302 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "insight/insight"
+#include "insight/registry"
+#include "corpus.hh"
+
+// Measures the loading of the metadata of a synthetic corpus in each mode.
+// Every run is done in a process of its own, re-executed with --mode, and
+// reported as a line of JSON. Without --mode, every mode is run and the
+// median of the runs of each one is reported, then compared with a baseline
+// when one is given. Only the units of the corpus are read, and only the
+// memory measures fail the comparison, timings vary too much between runs.
+
+INSIGHT_MANUAL_INIT;
+
+static std::atomic<size_t> allocations(0);
+
+void *operator new(std::size_t size) {
+    ++allocations;
+    if (void *ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace {
+
+    const char* const modes[] = { "eager", "lazy", "async", "filtered" };
+
+    struct Result {
+        std::string mode;
+        double init_ms;             // until initialize() returns
+        double first_lookup_ms;     // until a type of the last unit is found
+        double complete_ms;         // until complete_metadata() returns
+        long peak_rss_kb;           // before completing the metadata
+        size_t allocations;         // likewise
+        long complete_rss_kb;       // once the metadata is complete
+        size_t complete_allocations;
+        size_t units_loaded;
+    };
+
+    double elapsed_ms(std::chrono::steady_clock::time_point since) {
+        auto elapsed = std::chrono::steady_clock::now() - since;
+        return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() / 1000.0;
+    }
+
+    long peak_rss_kb() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    std::string to_json(const Result& result) {
+        char line[1024];
+        std::snprintf(line, sizeof (line),
+                      "{\"corpus\": \"%s\", \"mode\": \"%s\", \"units\": %d, \"structs\": %d, "
+                      "\"init_ms\": %.2f, \"first_lookup_ms\": %.2f, \"complete_ms\": %.2f, "
+                      "\"peak_rss_kb\": %ld, \"allocations\": %zu, "
+                      "\"complete_rss_kb\": %ld, \"complete_allocations\": %zu, \"units_loaded\": %zu}",
+                      CORPUS_NAME, result.mode.c_str(), CORPUS_UNITS, CORPUS_STRUCTS,
+                      result.init_ms, result.first_lookup_ms, result.complete_ms,
+                      result.peak_rss_kb, result.allocations,
+                      result.complete_rss_kb, result.complete_allocations, result.units_loaded);
+        return line;
+    }
+
+    // Reads a field of a line written by to_json, empty when it is missing.
+    bool json_field(const std::string& line, const char* key, std::string& value) {
+        std::string quoted = std::string("\"") + key + "\": ";
+        size_t start = line.find(quoted);
+        value.clear();
+        if (start == std::string::npos)
+            return false;
+        start += quoted.size();
+        size_t end = line.find_first_of(",}", start);
+        value = line.substr(start, end - start);
+        value.erase(std::remove(value.begin(), value.end(), '"'), value.end());
+        return true;
+    }
+
+    bool from_json(const std::string& line, Result& result) {
+        std::string corpus, value;
+        if (!json_field(line, "corpus", corpus) || corpus != CORPUS_NAME || !json_field(line, "mode", result.mode))
+            return false;
+        if (!json_field(line, "init_ms", value))
+            return false;
+        result.init_ms = std::atof(value.c_str());
+        json_field(line, "first_lookup_ms", value);
+        result.first_lookup_ms = std::atof(value.c_str());
+        json_field(line, "complete_ms", value);
+        result.complete_ms = std::atof(value.c_str());
+        json_field(line, "peak_rss_kb", value);
+        result.peak_rss_kb = std::atol(value.c_str());
+        json_field(line, "allocations", value);
+        result.allocations = std::strtoul(value.c_str(), nullptr, 10);
+        json_field(line, "complete_rss_kb", value);
+        result.complete_rss_kb = std::atol(value.c_str());
+        json_field(line, "complete_allocations", value);
+        result.complete_allocations = std::strtoul(value.c_str(), nullptr, 10);
+        json_field(line, "units_loaded", value);
+        result.units_loaded = std::strtoul(value.c_str(), nullptr, 10);
+        return true;
+    }
+
+    Result run(const std::string& mode) {
+        Insight::InitOptions options = Insight::InitOptions();
+        options.mode = mode == "async" ? Insight::InitMode::ASYNC : Insight::InitMode::EAGER;
+        options.lazy_members = mode == "lazy";
+        // leaves out the units of the library and of this file
+        options.filter.source_paths.push_back(CORPUS_DIRECTORY);
+        if (mode == "filtered")
+            options.filter.namespaces.push_back(CORPUS_FIRST_NAMESPACE);
+
+        Result result = Result();
+        result.mode = mode;
+        size_t before = allocations;
+        auto start = std::chrono::steady_clock::now();
+        Insight::initialize(options);
+        result.init_ms = elapsed_ms(start);
+
+        // the last unit is left out by the filter
+        try {
+            Insight::self_registry().find_type(CORPUS_LAST_TYPE);
+        } catch (const std::out_of_range&) {
+            if (mode != "filtered")
+                throw;
+        }
+        result.first_lookup_ms = elapsed_ms(start);
+        result.peak_rss_kb = peak_rss_kb();
+        result.allocations = allocations - before;
+
+        Insight::complete_metadata();
+        result.complete_ms = elapsed_ms(start);
+        result.complete_rss_kb = peak_rss_kb();
+        result.complete_allocations = allocations - before;
+        result.units_loaded = Insight::self_registry().statistics().units_loaded;
+        return result;
+    }
+
+    // Runs a mode in a new process, which reads the metadata from scratch.
+    bool run_child(const char* self, const std::string& mode, Result& result) {
+        std::string command = std::string(self) + " --mode " + mode;
+        FILE* child = popen(command.c_str(), "r");
+        if (!child)
+            return false;
+        char line[1024];
+        bool parsed = std::fgets(line, sizeof (line), child) && from_json(line, result);
+        return pclose(child) == 0 && parsed;
+    }
+
+    template <typename T>
+    T median(std::vector<Result>& runs, T Result::* field) {
+        std::sort(runs.begin(), runs.end(), [&](const Result& a, const Result& b) { return a.*field < b.*field; });
+        return runs[runs.size() / 2].*field;
+    }
+
+    // Reports the measures that grew by more than the tolerance since the
+    // baseline. Only memory regressions fail, those of timings are reported.
+    // Measures missing from the baseline are skipped.
+    bool compare(const Result& result, const std::vector<Result>& baseline, double tolerance) {
+        bool regressed = false;
+        for (const Result& old : baseline) {
+            if (old.mode != result.mode)
+                continue;
+
+            auto check = [&](const char* name, double before, double after, bool gated) {
+                if (before > 0 && after > before * (1 + tolerance)) {
+                    std::fprintf(stderr, "%s/%s: %s %s from %.2f to %.2f\n",
+                                 CORPUS_NAME, result.mode.c_str(), name,
+                                 gated ? "regressed" : "grew", before, after);
+                    regressed = regressed || gated;
+                }
+            };
+            check("init_ms", old.init_ms, result.init_ms, false);
+            check("first_lookup_ms", old.first_lookup_ms, result.first_lookup_ms, false);
+            check("complete_ms", old.complete_ms, result.complete_ms, false);
+            check("peak_rss_kb", old.peak_rss_kb, result.peak_rss_kb, true);
+            check("allocations", old.allocations, result.allocations, true);
+            check("complete_rss_kb", old.complete_rss_kb, result.complete_rss_kb, true);
+            check("complete_allocations", old.complete_allocations, result.complete_allocations, true);
+        }
+        return !regressed;
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string mode;
+    std::string output;
+    std::string baseline_path;
+    int repeat = 5;
+    double tolerance = 0.1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--mode")
+            mode = argv[i + 1];
+        else if (option == "--output")
+            output = argv[i + 1];
+        else if (option == "--baseline")
+            baseline_path = argv[i + 1];
+        else if (option == "--repeat")
+            repeat = std::max(1, std::atoi(argv[i + 1]));
+        else if (option == "--tolerance")
+            tolerance = std::atof(argv[i + 1]);
+    }
+    if (argc % 2 == 0) {
+        std::fprintf(stderr, "usage: %s [--mode eager|lazy|async|filtered] [--repeat n] [--output file]"
+                             " [--baseline file] [--tolerance fraction]\n", argv[0]);
+        return 1;
+    }
+
+    if (!mode.empty()) {
+        std::printf("%s\n", to_json(run(mode)).c_str());
+        return 0;
+    }
+
+    std::vector<Result> baseline;
+    if (!baseline_path.empty()) {
+        std::ifstream in(baseline_path);
+        std::string line;
+        Result result;
+        while (std::getline(in, line)) {
+            if (from_json(line, result))
+                baseline.push_back(result);
+        }
+    }
+
+    FILE* out = output.empty() ? stdout : std::fopen(output.c_str(), "a");
+    if (!out) {
+        std::perror(output.c_str());
+        return 1;
+    }
+
+    // popen runs a shell, for which /proc/self/exe is the shell
+    char path[4096];
+    ssize_t length = readlink("/proc/self/exe", path, sizeof (path) - 1);
+    std::string self = length > 0 ? std::string(path, length) : argv[0];
+
+    bool passed = true;
+    for (const char* m : modes) {
+        std::vector<Result> runs;
+        for (int i = 0; i < repeat; ++i) {
+            Result result;
+            if (!run_child(self.c_str(), m, result)) {
+                std::fprintf(stderr, "%s/%s: the run failed\n", CORPUS_NAME, m);
+                return 1;
+            }
+            runs.push_back(result);
+        }
+
+        Result result = runs.front();
+        result.init_ms = median(runs, &Result::init_ms);
+        result.first_lookup_ms = median(runs, &Result::first_lookup_ms);
+        result.complete_ms = median(runs, &Result::complete_ms);
+        result.peak_rss_kb = median(runs, &Result::peak_rss_kb);
+        result.allocations = median(runs, &Result::allocations);
+        result.complete_rss_kb = median(runs, &Result::complete_rss_kb);
+        result.complete_allocations = median(runs, &Result::complete_allocations);
+        std::fprintf(out, "%s\n", to_json(result).c_str());
+        passed = compare(result, baseline, tolerance) && passed;
+    }
+    if (out != stdout)
+        std::fclose(out);
+    return passed ? 0 : 2;
+}
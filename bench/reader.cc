@@ -0,0 +1,146 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef INSIGHT_BENCH_LIBDWARFXX
+# include <libdwarf++/dwarf.hh>
+# include <libdwarf++/die.hh>
+# include <libdwarf++/cu.hh>
+#endif
+#include "core/dwarf/native/reader.hh"
+
+// Walks every DIE of a file with the native reader and, when available,
+// with libdwarf++, reading the attributes the registry builder reads most.
+
+static std::atomic<size_t> allocations(0);
+
+void *operator new(std::size_t size) {
+    ++allocations;
+    if (void *ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+template <typename Die, typename Unsigned>
+struct Walker {
+    using Result = typename Die::TraversalResult;
+
+    template <typename T>
+    Result operator()(T& die) {
+        ++dies;
+        if (die.get_name())
+            ++names;
+        auto type = die.get_attribute(DW_AT_type);
+        if (type)
+            sum += type->template as<Unsigned>();
+        auto line = die.get_attribute(DW_AT_decl_line);
+        if (line)
+            sum += line->template as<Unsigned>();
+        return traverse ? Result::TRAVERSE : Result::SKIP;
+    }
+
+    // SKIP stops at the children of the units, like the registry builder
+    // does for the bodies of functions
+    bool traverse = true;
+
+    size_t dies = 0;
+    size_t names = 0;
+    Unsigned sum = 0;
+};
+
+template <typename Walker, typename Open>
+void run(const char *label, int iterations, bool traverse, Open open) {
+    using clock = std::chrono::steady_clock;
+    clock::duration total = clock::duration::zero();
+    size_t allocs = 0;
+    Walker walker;
+
+    for (int i = 0; i < iterations; ++i) {
+        walker = Walker();
+        walker.traverse = traverse;
+        size_t before = allocations;
+        auto start = clock::now();
+        open(walker);
+        total += clock::now() - start;
+        allocs += allocations - before;
+    }
+
+    auto ms = std::chrono::duration_cast<std::chrono::microseconds>(total).count() / 1000.0 / iterations;
+    std::printf("%-12s %10zu dies %10zu names %10.2f ms %12zu allocations\n",
+                label, walker.dies, walker.names, ms, allocs / iterations);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <elf file> [iterations]\n", argv[0]);
+        return 1;
+    }
+    const char *path = argv[1];
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 10;
+
+    using NativeWalker = Walker<Insight::Native::Die, Insight::Native::Unsigned>;
+    auto native = [path](NativeWalker& walker) {
+        Insight::Native::Debug dbg(std::make_shared<Insight::ElfFile>(path));
+        for (const Insight::Native::CompilationUnit &cu : dbg) {
+            if (walker.traverse)
+                cu.visit(walker);
+            else
+                cu.die().visit_headless(walker);
+        }
+    };
+    run<NativeWalker>("native", iterations, true, native);
+    run<NativeWalker>("native-skim", iterations, false, native);
+
+#ifdef INSIGHT_BENCH_LIBDWARFXX
+    using DwarfWalker = Walker<Dwarf::Die, Dwarf::Unsigned>;
+    auto dwarf = [path](DwarfWalker& walker) {
+        int fd = open(path, O_RDONLY);
+        if (fd == -1)
+            return;
+        {
+            Dwarf::Debug dbg(fd);
+            for (const Dwarf::CompilationUnit &cu : dbg) {
+                if (walker.traverse)
+                    cu.visit(walker);
+                else
+                    cu.visit_headless(walker);
+            }
+        }
+        close(fd);
+    };
+    run<DwarfWalker>("libdwarf++", iterations, true, dwarf);
+    run<DwarfWalker>("libdwarf++-skim", iterations, false, dwarf);
+#endif
+    return 0;
+}
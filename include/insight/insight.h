@@ -22,10 +22,12 @@
 
 # include <stddef.h>
 # include "types.h"
+# include "typeof.h"
 
 # if defined(__GNUC__)
 #  define insight_type_of(Thing) ({                                                         \
         static __typeof__(Thing) *insight_typeof_dummy __attribute__((used)) = (void*)0;    \
+        insight_typeof_site(insight_typeof_dummy);                                          \
         insight_type_of_addr(&insight_typeof_dummy);                                        \
     })
 # else
@@ -0,0 +1,39 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef INSIGHT_TYPEOF_H
+# define INSIGHT_TYPEOF_H
+
+/*
+ * Records a typeof dummy in the insight_typeof section, along with an address
+ * in the code using it, so that the registry finds the dummies through the
+ * units containing that code instead of searching every function body.
+ * Binaries without the section are searched entirely.
+ */
+# if defined(__GNUC__) && defined(__x86_64__)
+#  define insight_typeof_site(Dummy)                                            \
+    __asm__("0:\n\t"                                                            \
+            ".pushsection insight_typeof, \"aw\"\n\t"                           \
+            ".dc.a %c0, 0b\n\t"                                                 \
+            ".popsection" :: "i" (&(Dummy)))
+# else
+#  define insight_typeof_site(Dummy) ((void) 0)
+# endif
+
+#endif /* !INSIGHT_TYPEOF_H */
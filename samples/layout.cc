@@ -0,0 +1,57 @@
+#include <insight/insight>
+#include <insight/layout>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+struct Connection {
+    bool open;
+    double last_seen;
+    char state;
+    long bytes_in;
+    short port;
+    long bytes_out;
+    char host[64];
+};
+
+struct Packed {
+    long id;
+    int size;
+    short kind;
+    char flags[2];
+};
+
+// usage: layout [-n count] [type...]
+//
+// Prints the layout of the given types, or ranks every structure of the
+// program by wasted bytes when no type is given.
+int main(int argc, char *argv[]) {
+    size_t count = 10;
+    int i = 1;
+    if (i + 1 < argc && !std::strcmp(argv[i], "-n")) {
+        count = std::strtoul(argv[i + 1], nullptr, 10);
+        i += 2;
+    }
+
+    if (i < argc) {
+        for (; i < argc; ++i) {
+            auto& type = dynamic_cast<Insight::StructInfo&>(Insight::type_of_(std::string(argv[i])));
+            std::cout << Insight::analyze_layout(type) << std::endl;
+        }
+        return 0;
+    }
+
+    auto layouts = Insight::analyze_layouts();
+
+    std::cout << "wasted  saving  size  type" << std::endl;
+    for (size_t n = 0; n < layouts.size() && n < count; ++n) {
+        auto& layout = layouts[n];
+        std::cout << layout.wasted << "\t" << layout.savings() << "\t"
+                  << layout.size << "\t" << layout.type->fullname() << std::endl;
+    }
+
+    if (!layouts.empty())
+        std::cout << std::endl << layouts.front();
+
+    return 0;
+}
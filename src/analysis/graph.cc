@@ -0,0 +1,313 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include "insight/graph"
+#include "ops/plan.hh"
+
+namespace Insight {
+
+    struct TracePlan {
+        struct Step {
+            enum Kind { POINTER, REPEAT };
+
+            Kind kind;
+            size_t offset;
+            size_t stride;          // stride of a REPEAT
+            size_t count;           // number of REPEAT iterations
+            const TracePlan* plan;  // plan of the pointee or of the repeated element
+        };
+
+        const TypeInfo* type;
+        size_t size;
+        size_t alignment;
+        size_t id;                  // dense index used for per-type accounting
+        std::vector<Step> steps;
+    };
+
+    class TracePlanCache : public PlanCache {
+    public:
+        TracePlanCache() : next_id_(0) {}
+
+        const TracePlan& get(const TypeInfo& type) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const TracePlan& plan = lookup(resolve_alias(type));
+            prune_repeats(compiled_);
+            return plan;
+        }
+
+        void forget(const std::unordered_set<const TypeInfo*>& types) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            forget_plans(plans_, types);
+        }
+
+    private:
+        using Step = TracePlan::Step;
+
+        const TracePlan& lookup(const TypeInfo& type) {
+            auto it = plans_.find(&type);
+            if (it != plans_.end())
+                return *it->second;
+
+            TracePlan* plan = new TracePlan();
+            plan->type = &type;
+            plan->size = type.size_of();
+            plan->alignment = alignment_of(type);
+            plan->id = next_id_++;
+            plans_[&type].reset(plan);
+            compiled_.push_back(plan);
+
+            compile(type, 0, plan->steps);
+            return *plan;
+        }
+
+        void compile(const TypeInfo& t, size_t base, std::vector<Step>& steps) {
+            const TypeInfo& type = resolve_alias(t);
+
+            if (auto* info = dynamic_cast<const StructInfo*>(&type)) {
+                walk_members(*info,
+                    [&](const StructInfo& super, size_t offset) {
+                        compile(super, base + offset, steps);
+                    },
+                    [&](const FieldInfo& field, size_t offset) {
+                        if (!is_vtable_pointer(field))
+                            compile(field.type(), base + offset, steps);
+                    },
+                    [](size_t, size_t) {});
+            } else if (auto* info = dynamic_cast<const PointerTypeInfo*>(&type)) {
+                const TypeInfo& pointee = resolve_alias(info->pointed_type());
+                auto* prim = dynamic_cast<const PrimitiveTypeInfo*>(&pointee);
+                bool character = prim && (prim->kind() == CHAR || prim->kind() == UNSIGNED_CHAR);
+                if (!character && pointee.size_of() > 0)
+                    steps.push_back(Step{Step::POINTER, base, 0, 0, &lookup(pointee)});
+            } else if (auto* info = dynamic_cast<const ArrayTypeInfo*>(&type)) {
+                const TypeInfo& element = resolve_alias(info->element_type());
+                const TracePlan& plan = lookup(element);
+                if (info->length() > 0)
+                    steps.push_back(Step{Step::REPEAT, base, element.size_of(), info->length(), &plan});
+            }
+        }
+
+        std::mutex mutex_;
+        std::unordered_map<const TypeInfo*, std::unique_ptr<TracePlan>> plans_;
+        std::vector<TracePlan*> compiled_;  // not pruned yet
+        size_t next_id_;
+    };
+
+    static TracePlanCache plan_cache;
+
+    // Open addressing set of addresses; a walk may visit millions of objects
+    // and a node based set would dominate both memory and time.
+    class AddressSet {
+    public:
+        AddressSet() : slots_(1024, 0), count_(0) {}
+
+        bool insert(uintptr_t address) {
+            if ((count_ + 1) * 2 > slots_.size())
+                grow();
+            if (place(slots_, address)) {
+                ++count_;
+                return true;
+            }
+            return false;
+        }
+
+    private:
+        static bool place(std::vector<uintptr_t>& slots, uintptr_t address) {
+            size_t mask = slots.size() - 1;
+            size_t i = static_cast<size_t>((address >> 3) * 0x9e3779b97f4a7c15ull) & mask;
+            for (;; i = (i + 1) & mask) {
+                if (slots[i] == address)
+                    return false;
+                if (!slots[i]) {
+                    slots[i] = address;
+                    return true;
+                }
+            }
+        }
+
+        void grow() {
+            std::vector<uintptr_t> slots(slots_.size() * 2, 0);
+            for (uintptr_t address : slots_) {
+                if (address)
+                    place(slots, address);
+            }
+            slots_.swap(slots);
+        }
+
+        std::vector<uintptr_t> slots_;
+        size_t count_;
+    };
+
+    GraphWalker::GraphWalker()
+        : local_(new LocalAddressSpace())
+        , space_(*local_)
+        , roots_()
+    {}
+
+    GraphWalker::GraphWalker(AddressSpace& space)
+        : local_()
+        , space_(space)
+        , roots_()
+    {}
+
+    GraphWalker::~GraphWalker() {}
+
+    void GraphWalker::add_root(const VariableInfo& variable) {
+        add_root(variable.fullname(), reinterpret_cast<uintptr_t>(variable.address()), variable.type());
+    }
+
+    void GraphWalker::add_root(const std::string& name, uintptr_t address, const TypeInfo& type) {
+        roots_.push_back(Root{name, address, &type});
+    }
+
+    void GraphWalker::add_variables(const Container& container) {
+        for (auto& variable : container.variables())
+            add_root(variable);
+
+        if (auto* ns = dynamic_cast<const NamespaceInfo*>(&container)) {
+            for (auto& nested : ns->nested_namespaces())
+                add_variables(nested);
+        }
+    }
+
+    namespace {
+
+        struct Pending {
+            uintptr_t address;
+            const TracePlan* plan;
+        };
+
+        struct Walk {
+            Walk(AddressSpace& space) : space(space), invalid(0) {}
+
+            void scan(const TracePlan& plan, const char* data, std::vector<Pending>& next) {
+                for (const TracePlan::Step& step : plan.steps) {
+                    if (step.kind == TracePlan::Step::REPEAT) {
+                        for (size_t i = 0; i < step.count; ++i)
+                            scan(*step.plan, data + step.offset + i * step.stride, next);
+                        continue;
+                    }
+
+                    uintptr_t target;
+                    std::memcpy(&target, data + step.offset, sizeof (target));
+                    if (!target)
+                        continue;
+
+                    const TracePlan& tp = *step.plan;
+                    if (target % tp.alignment || !space.map().readable(target, tp.size)) {
+                        ++invalid;
+                        continue;
+                    }
+                    if (visited.insert(target))
+                        next.push_back(Pending{target, &tp});
+                }
+            }
+
+            // Reads the objects of the graph one level at a time, so that each
+            // level is fetched with a single batch from the address space.
+            void run(const Pending& root, RootUsage& usage, std::vector<TypeUsage>& types) {
+                std::vector<Pending> frontier{root};
+                std::vector<Pending> next;
+                std::vector<AddressSpace::Read> reads;
+                std::vector<char> buffer;
+                bool first = true;
+
+                while (!frontier.empty()) {
+                    size_t total = 0;
+                    for (const Pending& p : frontier)
+                        total += p.plan->size;
+                    buffer.resize(total);
+                    reads.clear();
+
+                    size_t off = 0;
+                    for (const Pending& p : frontier) {
+                        reads.push_back(AddressSpace::Read{p.address, buffer.data() + off, p.plan->size, false});
+                        off += p.plan->size;
+                    }
+                    space.read(reads.data(), reads.size());
+
+                    next.clear();
+                    for (size_t i = 0; i < frontier.size(); ++i) {
+                        if (!reads[i].ok) {
+                            ++invalid;
+                            continue;
+                        }
+
+                        const TracePlan& plan = *frontier[i].plan;
+                        if (!first) {
+                            if (types.size() <= plan.id)
+                                types.resize(plan.id + 1, TypeUsage{nullptr, 0, 0});
+                            TypeUsage& t = types[plan.id];
+                            t.type = plan.type;
+                            ++t.objects;
+                            t.bytes += plan.size;
+                            ++usage.objects;
+                            usage.bytes += plan.size;
+                        }
+                        scan(plan, static_cast<const char*>(reads[i].buffer), next);
+                    }
+                    frontier.swap(next);
+                    first = false;
+                }
+            }
+
+            AddressSpace& space;
+            AddressSet visited;
+            size_t invalid;
+        };
+
+    }
+
+    GraphUsage GraphWalker::walk() {
+        GraphUsage result;
+        result.objects = 0;
+        result.bytes = 0;
+
+        Walk walk(space_);
+        std::vector<TypeUsage> types;
+
+        for (const Root& root : roots_) {
+            const TracePlan& plan = plan_cache.get(*root.type);
+            RootUsage usage = {root.name, root.type, root.address, 0, 0};
+
+            if (walk.visited.insert(root.address))
+                walk.run(Pending{root.address, &plan}, usage, types);
+
+            result.objects += usage.objects;
+            result.bytes += usage.bytes;
+            result.roots.push_back(usage);
+        }
+
+        for (const TypeUsage& t : types) {
+            if (t.objects)
+                result.types.push_back(t);
+        }
+        std::sort(result.types.begin(), result.types.end(), [](const TypeUsage& a, const TypeUsage& b) {
+            return a.bytes > b.bytes;
+        });
+
+        result.invalid_pointers = walk.invalid;
+        return result;
+    }
+
+}
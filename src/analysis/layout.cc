@@ -0,0 +1,215 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <algorithm>
+#include <iomanip>
+#include <unordered_set>
+#include "insight/layout"
+#include "ops/plan.hh"
+
+namespace Insight {
+
+    static bool is_empty(const StructInfo& info) {
+        return info.fields().begin() == info.fields().end()
+            && info.supertypes().begin() == info.supertypes().end();
+    }
+
+    static size_t align_up(size_t value, size_t align) {
+        return (value + align - 1) / align * align;
+    }
+
+    static void suggest_order(StructLayout& layout) {
+        std::vector<size_t> fixed;
+        std::vector<size_t> movable;
+
+        // base subobjects and the vtable pointer cannot be moved around
+        for (size_t i = 0; i < layout.members.size(); ++i) {
+            const LayoutMember& m = layout.members[i];
+            if (m.base || m.name.compare(0, 5, "_vptr") == 0)
+                fixed.push_back(i);
+            else
+                movable.push_back(i);
+        }
+
+        std::stable_sort(movable.begin(), movable.end(), [&](size_t a, size_t b) {
+            const LayoutMember& ma = layout.members[a];
+            const LayoutMember& mb = layout.members[b];
+            if (ma.alignment != mb.alignment)
+                return ma.alignment > mb.alignment;
+            return ma.size > mb.size;
+        });
+
+        std::vector<size_t> order(fixed);
+        order.insert(order.end(), movable.begin(), movable.end());
+
+        size_t cursor = 0;
+        for (size_t i : order) {
+            const LayoutMember& m = layout.members[i];
+            cursor = align_up(cursor, m.alignment) + m.size;
+        }
+        cursor = std::max<size_t>(align_up(cursor, layout.alignment), 1);
+
+        if (cursor < layout.size) {
+            layout.suggested_order = order;
+            layout.suggested_size = cursor;
+        } else {
+            for (size_t i = 0; i < layout.members.size(); ++i)
+                layout.suggested_order.push_back(i);
+            layout.suggested_size = layout.size;
+        }
+    }
+
+    StructLayout analyze_layout(const StructInfo& type, size_t cache_line) {
+        StructLayout layout;
+        layout.type = &type;
+        layout.size = type.size_of();
+        layout.alignment = alignment_of(type);
+        layout.cache_line = cache_line;
+        layout.wasted = 0;
+
+        walk_members(type,
+            [&](const StructInfo& super, size_t offset) {
+                size_t size = is_empty(super) ? 0 : super.size_of();
+                layout.members.push_back(LayoutMember{super.name(), &super, offset, size, alignment_of(super), true});
+            },
+            [&](const FieldInfo& field, size_t offset) {
+                const TypeInfo& t = resolve_alias(field.type());
+                layout.members.push_back(LayoutMember{field.name(), &field.type(), offset, t.size_of(), alignment_of(t), false});
+            },
+            [&](size_t offset, size_t size) {
+                layout.members.push_back(LayoutMember{"<unknown>", nullptr, offset, size, 1, false});
+            });
+
+        std::stable_sort(layout.members.begin(), layout.members.end(), [](const LayoutMember& a, const LayoutMember& b) {
+            return a.offset < b.offset;
+        });
+
+        size_t cursor = 0;
+        for (const LayoutMember& m : layout.members) {
+            if (m.offset > cursor)
+                layout.holes.push_back(LayoutHole{cursor, m.offset - cursor});
+            cursor = std::max(cursor, m.offset + m.size);
+        }
+        if (layout.size > cursor)
+            layout.holes.push_back(LayoutHole{cursor, layout.size - cursor});
+
+        for (const LayoutHole& hole : layout.holes)
+            layout.wasted += hole.size;
+
+        // cache lines are counted from the start of the structure, which
+        // assumes that instances are allocated on a cache line boundary
+        layout.cache_lines.resize((layout.size + cache_line - 1) / cache_line);
+        for (size_t i = 0; i < layout.members.size(); ++i) {
+            const LayoutMember& m = layout.members[i];
+            if (!m.size)
+                continue;
+
+            size_t first = m.offset / cache_line;
+            size_t last = (m.offset + m.size - 1) / cache_line;
+            if (first != last)
+                layout.straddling.push_back(i);
+            for (size_t line = first; line <= last && line < layout.cache_lines.size(); ++line)
+                layout.cache_lines[line].push_back(i);
+        }
+
+        suggest_order(layout);
+        return layout;
+    }
+
+    static void collect_layouts(const Container& container, size_t cache_line,
+            std::unordered_set<const TypeInfo*>& seen, std::vector<StructLayout>& layouts) {
+        for (auto& type : container.types()) {
+            auto* info = dynamic_cast<const StructInfo*>(&type);
+            if (!info || !seen.insert(info).second)
+                continue;
+
+            if (info->size_of() > 0)
+                layouts.push_back(analyze_layout(*info, cache_line));
+            collect_layouts(*info, cache_line, seen, layouts);
+        }
+
+        if (auto* ns = dynamic_cast<const NamespaceInfo*>(&container)) {
+            for (auto& nested : ns->nested_namespaces())
+                collect_layouts(nested, cache_line, seen, layouts);
+        }
+    }
+
+    std::vector<StructLayout> analyze_layouts(const Container& container, size_t cache_line) {
+        std::unordered_set<const TypeInfo*> seen;
+        std::vector<StructLayout> layouts;
+
+        collect_layouts(container, cache_line, seen, layouts);
+
+        std::stable_sort(layouts.begin(), layouts.end(), [](const StructLayout& a, const StructLayout& b) {
+            if (a.wasted != b.wasted)
+                return a.wasted > b.wasted;
+            return a.type->fullname() < b.type->fullname();
+        });
+        return layouts;
+    }
+
+    std::vector<StructLayout> analyze_layouts(size_t cache_line) {
+        return analyze_layouts(root_namespace(), cache_line);
+    }
+
+    std::ostream& operator<<(std::ostream& out, const StructLayout& layout) {
+        out << "struct " << layout.type->fullname() << " {" << std::endl;
+
+        size_t hole = 0;
+        size_t line = 0;
+        for (size_t i = 0; i < layout.members.size(); ++i) {
+            const LayoutMember& m = layout.members[i];
+
+            for (; hole < layout.holes.size() && layout.holes[hole].offset < m.offset; ++hole)
+                out << "    /* XXX " << layout.holes[hole].size << " bytes hole */" << std::endl;
+
+            for (; m.offset >= (line + 1) * layout.cache_line; ++line)
+                out << "    /* --- cacheline " << line + 1 << " boundary ("
+                    << (line + 1) * layout.cache_line << " bytes) --- */" << std::endl;
+
+            std::string type = m.base ? "<base>" : m.type ? m.type->name() : "<unknown>";
+            out << "    " << std::left << std::setw(32) << type
+                << std::setw(24) << m.name
+                << "/* " << std::right << std::setw(5) << m.offset << " " << std::setw(5) << m.size << " */";
+            if (std::find(layout.straddling.begin(), layout.straddling.end(), i) != layout.straddling.end())
+                out << " /* straddles a cache line */";
+            out << std::endl;
+        }
+        for (; hole < layout.holes.size(); ++hole)
+            out << "    /* XXX " << layout.holes[hole].size << " bytes padding */" << std::endl;
+
+        size_t sum = layout.size - layout.wasted;
+        out << std::endl
+            << "    /* size: " << layout.size << ", cachelines: " << layout.cache_lines.size()
+            << ", members: " << layout.members.size() << " */" << std::endl
+            << "    /* sum members: " << sum << ", holes: " << layout.holes.size()
+            << ", sum holes: " << layout.wasted << " */" << std::endl;
+
+        if (layout.savings()) {
+            out << "    /* suggested order (size: " << layout.suggested_size
+                << ", saves " << layout.savings() << " bytes):";
+            for (size_t i : layout.suggested_order)
+                out << " " << layout.members[i].name;
+            out << " */" << std::endl;
+        }
+        out << "};" << std::endl;
+        return out;
+    }
+
+}
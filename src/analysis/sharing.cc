@@ -0,0 +1,239 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <algorithm>
+#include <cctype>
+#include <unordered_set>
+#include "insight/sharing"
+#include "ops/plan.hh"
+
+namespace Insight {
+
+    // Only the unqualified name of the type counts, without its template
+    // arguments, so that e.g. std::atomic<int> matches but
+    // std::vector<std::atomic<int>> or a pointer to a mutex do not.
+    static std::string unqualified_name(const std::string& name) {
+        std::string stripped;
+        int depth = 0;
+        for (char c : name) {
+            if (c == '<')
+                ++depth;
+            else if (c == '>')
+                --depth;
+            else if (depth == 0)
+                stripped += c;
+        }
+        if (stripped.find_first_of("*&(") != std::string::npos)
+            return "";
+
+        size_t scope = stripped.rfind("::");
+        if (scope != std::string::npos)
+            stripped = stripped.substr(scope + 2);
+        return stripped.substr(0, stripped.find('['));
+    }
+
+    // Names are split into lowercase words, on punctuation and on camel case
+    // boundaries, so that e.g. SpinLock and pthread_spinlock_t match but
+    // Clock or Block do not.
+    static bool has_synchronization_name(const std::string& fullname) {
+        static const std::unordered_set<std::string> words = {
+            "atomic", "mutex", "lock", "spinlock", "rwlock", "seqlock",
+            "futex", "sem", "semaphore", "cond", "condition", "latch", "barrier",
+        };
+
+        std::string name = unqualified_name(fullname);
+        std::string word;
+        for (size_t i = 0; i <= name.size(); ++i) {
+            char c = i < name.size() ? name[i] : '\0';
+            bool boundary = !std::isalnum(c)
+                || (std::isupper(c) && i > 0 && std::islower(name[i - 1]));
+
+            if (boundary && !word.empty()) {
+                if (words.count(word))
+                    return true;
+                word.clear();
+            }
+            if (std::isalnum(c))
+                word += static_cast<char>(std::tolower(c));
+        }
+        return false;
+    }
+
+    // Typedef names count as well, e.g. pthread_mutex_t is a typedef on an
+    // anonymous union.
+    static bool is_synchronization_type(const TypeInfo& type) {
+        const TypeInfo* t = &type;
+        for (;;) {
+            if (has_synchronization_name(t->name()))
+                return true;
+
+            if (auto* td = dynamic_cast<const TypeDefInfo*>(t))
+                t = &td->aliased_type();
+            else if (auto* ct = dynamic_cast<const ConstTypeInfo*>(t))
+                t = &ct->type();
+            else
+                return false;
+        }
+    }
+
+    static const AnnotationInfo* hot_write_annotation(const TypeInfo& type) {
+        const TypeInfo* t = &type;
+        for (;;) {
+            if (auto* a = find_annotation(*t, "HotWrite"))
+                return a;
+
+            if (auto* td = dynamic_cast<const TypeDefInfo*>(t))
+                t = &td->aliased_type();
+            else if (auto* ct = dynamic_cast<const ConstTypeInfo*>(t))
+                t = &ct->type();
+            else
+                return nullptr;
+        }
+    }
+
+    static int annotation_group(const AnnotationInfo& annotation) {
+        return static_cast<const HotWrite*>(annotation.data_ptr())->group;
+    }
+
+    static void collect_fields(const TypeInfo& t, const std::string& prefix, size_t base,
+            const AnnotationInfo* annotation, std::vector<ConcurrentField>& fields) {
+        const TypeInfo& type = resolve_alias(t);
+
+        if (!annotation)
+            annotation = hot_write_annotation(t);
+
+        if (annotation || is_synchronization_type(t)) {
+            ConcurrentField::Reason reason = annotation ? ConcurrentField::ANNOTATED : ConcurrentField::SYNCHRONIZATION;
+            int group = annotation ? annotation_group(*annotation) : 0;
+
+            // each element of an array of counters is its own writer
+            if (auto* array = dynamic_cast<const ArrayTypeInfo*>(&type)) {
+                size_t stride = resolve_alias(array->element_type()).size_of();
+                for (size_t i = 0; i < array->length(); ++i) {
+                    fields.push_back(ConcurrentField{prefix + "[" + std::to_string(i) + "]",
+                            &array->element_type(), base + i * stride, stride, group, reason});
+                }
+            } else {
+                fields.push_back(ConcurrentField{prefix, &t, base, type.size_of(), group, reason});
+            }
+            return;
+        }
+
+        if (auto* info = dynamic_cast<const StructInfo*>(&type)) {
+            std::string dot = prefix.empty() ? "" : prefix + ".";
+            walk_members(*info,
+                [&](const StructInfo& super, size_t offset) {
+                    collect_fields(super, dot + super.name(), base + offset, nullptr, fields);
+                },
+                [&](const FieldInfo& field, size_t offset) {
+                    collect_fields(field.type(), dot + field.name(), base + offset,
+                            find_annotation(field, "HotWrite"), fields);
+                },
+                [](size_t, size_t) {});
+        } else if (auto* info = dynamic_cast<const ArrayTypeInfo*>(&type)) {
+            size_t stride = resolve_alias(info->element_type()).size_of();
+            for (size_t i = 0; i < info->length(); ++i) {
+                collect_fields(info->element_type(), prefix + "[" + std::to_string(i) + "]",
+                        base + i * stride, nullptr, fields);
+            }
+        }
+    }
+
+    SharingReport analyze_sharing(const StructInfo& type, size_t cache_line) {
+        SharingReport report;
+        report.type = &type;
+        report.cache_line = cache_line;
+
+        collect_fields(type, "", 0, nullptr, report.fields);
+
+        std::stable_sort(report.fields.begin(), report.fields.end(), [](const ConcurrentField& a, const ConcurrentField& b) {
+            return a.offset < b.offset;
+        });
+
+        std::vector<SharedCacheLine> lines((type.size_of() + cache_line - 1) / cache_line);
+        for (size_t i = 0; i < lines.size(); ++i)
+            lines[i] = SharedCacheLine{i, {}, 0};
+
+        for (size_t i = 0; i < report.fields.size(); ++i) {
+            const ConcurrentField& f = report.fields[i];
+            size_t first = f.offset / cache_line;
+            size_t last = (f.offset + std::max<size_t>(f.size, 1) - 1) / cache_line;
+            for (size_t line = first; line <= last && line < lines.size(); ++line)
+                lines[line].fields.push_back(i);
+        }
+
+        for (SharedCacheLine& line : lines) {
+            std::unordered_set<int> groups;
+            for (size_t i : line.fields) {
+                int group = report.fields[i].group;
+                if (!group || groups.insert(group).second)
+                    ++line.writers;
+            }
+            if (line.writers > 1)
+                report.conflicts.push_back(line);
+        }
+        return report;
+    }
+
+    static void collect_reports(const Container& container, size_t cache_line,
+            std::unordered_set<const TypeInfo*>& seen, std::vector<SharingReport>& reports) {
+        for (auto& type : container.types()) {
+            auto* info = dynamic_cast<const StructInfo*>(&type);
+            if (!info || !seen.insert(info).second)
+                continue;
+
+            if (info->size_of() > 0) {
+                SharingReport report = analyze_sharing(*info, cache_line);
+                if (report.has_conflicts())
+                    reports.push_back(std::move(report));
+            }
+            collect_reports(*info, cache_line, seen, reports);
+        }
+
+        if (auto* ns = dynamic_cast<const NamespaceInfo*>(&container)) {
+            for (auto& nested : ns->nested_namespaces())
+                collect_reports(nested, cache_line, seen, reports);
+        }
+    }
+
+    std::vector<SharingReport> analyze_sharing(const Container& container, size_t cache_line) {
+        std::unordered_set<const TypeInfo*> seen;
+        std::vector<SharingReport> reports;
+        collect_reports(container, cache_line, seen, reports);
+        return reports;
+    }
+
+    std::ostream& operator<<(std::ostream& out, const SharingReport& report) {
+        out << report.type->fullname() << ": " << report.conflicts.size()
+            << " cache line(s) written by several threads" << std::endl;
+
+        for (const SharedCacheLine& line : report.conflicts) {
+            out << "    cacheline " << line.index << " (" << line.writers << " writers):";
+            for (size_t i : line.fields) {
+                const ConcurrentField& f = report.fields[i];
+                out << " " << f.name << "@" << f.offset;
+                if (f.group)
+                    out << "#" << f.group;
+            }
+            out << std::endl;
+        }
+        return out;
+    }
+
+}
@@ -0,0 +1,162 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <algorithm>
+#include "background.hh"
+#include "core.hh"
+
+namespace Insight {
+
+    namespace {
+        thread_local bool loader_thread = false;
+    }
+
+    BackgroundLoader& BackgroundLoader::instance() {
+        // the registry is constructed first, so that it outlives the loader
+        default_registry();
+        static BackgroundLoader loader;
+        return loader;
+    }
+
+    BackgroundLoader::BackgroundLoader()
+        : mutex_()
+        , progress_()
+        , thread_()
+        , running_(false)
+        , stopping_(false)
+        , update_(false)
+        , generation_(0)
+        , waiters_(0)
+        , wanted_()
+    {}
+
+    BackgroundLoader::~BackgroundLoader() {
+        stop();
+    }
+
+    void BackgroundLoader::start() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (running_ || thread_.joinable())
+            return;
+        running_ = true;
+        thread_ = std::thread(&BackgroundLoader::run, this);
+    }
+
+    // Libraries loaded or unloaded meanwhile are read by another update.
+    void BackgroundLoader::run() {
+        loader_thread = true;
+        std::unique_lock<std::mutex> lock(mutex_);
+        do {
+            update_ = false;
+            lock.unlock();
+            try {
+                update_modules();
+            } catch (const std::exception&) {
+            }
+            lock.lock();
+        } while (update_ && !stopping_);
+
+        running_ = false;
+        wanted_.clear();
+        progress_.notify_all();
+    }
+
+    void BackgroundLoader::stop() {
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            stopping_ = true;
+        }
+        if (thread_.joinable() && !in_loader_thread())
+            thread_.join();
+    }
+
+    bool BackgroundLoader::wait_for_progress(const std::string* name) {
+        if (in_loader_thread())
+            return false;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!running_)
+            return false;
+
+        if (name)
+            wanted_.push_back(*name);
+        ++waiters_;
+        size_t generation = generation_;
+        progress_.wait(lock, [&] { return !running_ || generation_ != generation; });
+        --waiters_;
+        if (name) {
+            auto it = std::find(wanted_.begin(), wanted_.end(), *name);
+            if (it != wanted_.end())
+                wanted_.erase(it);
+        }
+        return true;
+    }
+
+    void BackgroundLoader::wait_until_done() {
+        if (in_loader_thread())
+            return;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        progress_.wait(lock, [&] { return !running_; });
+    }
+
+    void BackgroundLoader::prioritize(const std::string& name) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (running_)
+            wanted_.push_back(name);
+    }
+
+    bool BackgroundLoader::update_later() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (!running_)
+            return false;
+        update_ = true;
+        return true;
+    }
+
+    bool BackgroundLoader::in_loader_thread() {
+        return loader_thread;
+    }
+
+    std::vector<std::string> BackgroundLoader::wanted() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return wanted_;
+    }
+
+    bool BackgroundLoader::has_waiters() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return waiters_ != 0;
+    }
+
+    bool BackgroundLoader::stopping() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return stopping_;
+    }
+
+    void BackgroundLoader::published() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        ++generation_;
+        progress_.notify_all();
+    }
+
+    void prioritize(const std::string& name) {
+        BackgroundLoader::instance().prioritize(name);
+    }
+
+}
@@ -0,0 +1,81 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef INSIGHT_BACKGROUND_HH
+# define INSIGHT_BACKGROUND_HH
+
+# include <condition_variable>
+# include <mutex>
+# include <string>
+# include <thread>
+# include <vector>
+
+namespace Insight {
+
+    // Reads the metadata of the current process in a thread of its own, so
+    // that the process does not wait for it to start. Units are published as
+    // lookups need them, and those defining the names lookups wait for are
+    // built first.
+    class BackgroundLoader {
+    public:
+        static BackgroundLoader& instance();
+
+        ~BackgroundLoader();
+
+        void start();
+
+        // Asks the loader to stop after the unit being built, and waits.
+        void stop();
+
+        // Waits until more metadata is published or loading ends. Returns
+        // false when nothing is being loaded in the background.
+        bool wait_for_progress(const std::string* name);
+        void wait_until_done();
+
+        void prioritize(const std::string& name);
+
+        // Has the loader read the modules again once it is done, when it is
+        // running. Returns false when it is not.
+        bool update_later();
+
+        // Used by the loader thread.
+        static bool in_loader_thread();
+        std::vector<std::string> wanted();
+        bool has_waiters();
+        bool stopping();
+        void published();
+
+    private:
+        BackgroundLoader();
+        void run();
+
+        std::mutex mutex_;
+        std::condition_variable progress_;
+        std::thread thread_;
+        bool running_;
+        bool stopping_;
+        bool update_;
+        size_t generation_;
+        size_t waiters_;
+        std::vector<std::string> wanted_;
+    };
+
+}
+
+#endif /* !INSIGHT_BACKGROUND_HH */
@@ -1,22 +1,219 @@
 #include "core.hh"
 #include "util/mangle.hh"
+#include "background.hh"
+#include "ops/plan.hh"
 
 namespace Insight {
 
-    std::shared_ptr<NamespaceInfoImpl> ROOT_NAMESPACE = std::make_shared<NamespaceInfoImpl>("");
-    std::shared_ptr<TypeInfo> VOID_TYPE = std::make_shared<PrimitiveTypeInfoImpl>("void", 0, PrimitiveKind::VOID, ROOT_NAMESPACE);
-    std::unordered_map<std::string, std::shared_ptr<NamespaceInfo>> namespaces;
+    RegistryImpl::RegistryImpl(std::string path)
+        : path_(std::move(path))
+        , bias_(0)
+        , loaded_(false)
+        , root_(std::make_shared<NamespaceInfoImpl>(""))
+        , void_type_(std::make_shared<PrimitiveTypeInfoImpl>("void", 0, PrimitiveKind::VOID, root_))
+        , namespaces_()
+        , types_()
+        , inferred_types_()
+        , objects_()
+        , canonical_types_()
+        , listener_(nullptr)
+        , filter_()
+        , lazy_members_(false)
+        , build_mutex_()
+        , track_additions_(false)
+        , additions_()
+        , unmerged_(false)
+        , lock_()
+        , modules_mutex_()
+        , modules_()
+        , pending_mutex_()
+        , pending_units_()
+        , statistics_mutex_()
+        , files_()
+        , member_loaders_()
+        , statistics_()
+    {
+        types_["void"] = void_type_;
+    }
+
+    RegistryImpl::~RegistryImpl() {
+        std::unordered_set<const TypeInfo*> types;
+        types.insert(void_type_.get());
+        for (auto& object : objects_) {
+            if (auto* type = dynamic_cast<const TypeInfo*>(object.get()))
+                types.insert(type);
+        }
+        forget_plans(types);
+    }
+
+    SelfRegistryImpl::SelfRegistryImpl()
+        : RegistryImpl("")
+    {}
+
+    namespace {
+
+        // number of RegistryReadLock held by the thread
+        thread_local unsigned read_locks = 0;
+
+        const std::string* wanted_name(const std::string& key) {
+            return &key;
+        }
+
+        const std::string* wanted_name(size_t) {
+            return nullptr;
+        }
+
+        // Looks a name up, reading deferred metadata until it is found.
+        template <typename Map>
+        auto lookup(const RegistryImpl& registry, const Map& map, const typename Map::key_type& key) -> decltype(*map.at(key)) {
+            for (;;) {
+                {
+                    LookupLock lock(registry);
+                    auto it = map.find(key);
+                    if (it != map.end())
+                        return *it->second;
+                }
+                if (!LookupLock::can_load(registry))
+                    break;
+                if (registry.unmerged_.exchange(false)) {
+                    std::unique_lock<std::shared_timed_mutex> lock(registry.lock_);
+                    if (merge_modules(const_cast<RegistryImpl&>(registry)))
+                        continue;
+                }
+                // the metadata of the process may still be read in the background
+                if (&registry == &default_registry()
+                        && BackgroundLoader::instance().wait_for_progress(wanted_name(key)))
+                    continue;
+                if (!const_cast<RegistryImpl&>(registry).load_more())
+                    break;
+            }
+            LookupLock lock(registry);
+            return *map.at(key);
+        }
+
+    }
+
+    LookupLock::LookupLock(const RegistryImpl& registry)
+        : locked_(nullptr)
+    {
+        if (&registry == &default_registry() && read_locks)
+            return;
+        registry.lock_.lock_shared();
+        locked_ = &registry;
+    }
+
+    LookupLock::~LookupLock() {
+        if (locked_)
+            locked_->lock_.unlock_shared();
+    }
+
+    bool LookupLock::can_load(const RegistryImpl& registry) {
+        return &registry != &default_registry() || !read_locks;
+    }
+
+    // Containers are only complete once all deferred metadata is loaded.
+    NamespaceInfo& RegistryImpl::root_namespace() const {
+        if (LookupLock::can_load(*this))
+            const_cast<RegistryImpl*>(this)->load_all();
+        return *root_;
+    }
+
+    TypeInfo& RegistryImpl::find_type(const std::string& name) const {
+        return lookup(*this, types_, name);
+    }
+
+    NamespaceInfo& RegistryImpl::find_namespace(const std::string& name) const {
+        return lookup(*this, namespaces_, name);
+    }
 
-    std::unordered_map<std::string, std::shared_ptr<TypeInfo>> type_registry;
-    std::unordered_map<size_t, std::shared_ptr<TypeInfo>> inferred_type_registry;
-    std::vector<std::shared_ptr<Named>> all_objects;
+    void RegistryImpl::load_all() {
+        while (load_more())
+            ;
+    }
+
+    void RegistryImpl::added_namespace(std::shared_ptr<NamespaceInfoImpl> ns) {
+        if (track_additions_)
+            additions_.namespaces.push_back(std::move(ns));
+    }
+
+    void RegistryImpl::added_member(std::shared_ptr<NamespaceInfoImpl> parent, std::shared_ptr<Named> member) {
+        if (track_additions_)
+            additions_.members.push_back(std::make_pair(std::move(parent), std::move(member)));
+    }
+
+    void RegistryImpl::added_type(const std::string& name) {
+        if (track_additions_)
+            additions_.types.push_back(name);
+    }
+
+    void RegistryImpl::added_inferred_type(size_t address) {
+        if (track_additions_)
+            additions_.inferred_types.push_back(address);
+    }
+
+    const std::string& RegistryImpl::path() const {
+        return path_;
+    }
+
+    LoadStatistics RegistryImpl::statistics() const {
+        LoadStatistics result;
+        {
+            std::lock_guard<std::mutex> guard(statistics_mutex_);
+            result = statistics_;
+            for (auto& file : files_) {
+                DebugSection::Statistics sections = file->statistics();
+                result.compressed_bytes += sections.compressed_bytes;
+                result.decompressed_bytes += sections.decompressed_bytes;
+                result.decompression_time += sections.decompression_time;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> guard(pending_mutex_);
+            result.units_deferred = pending_units_.size();
+        }
+
+        std::lock_guard<std::mutex> guard(modules_mutex_);
+        for (auto& module : modules_) {
+            if (!module->registry)
+                continue;
+            LoadStatistics stats = module->registry->statistics();
+            result.units_loaded += stats.units_loaded;
+            result.units_deferred += stats.units_deferred;
+            result.types_deferred += stats.types_deferred;
+            result.load_time += stats.load_time;
+            result.compressed_bytes += stats.compressed_bytes;
+            result.decompressed_bytes += stats.decompressed_bytes;
+            result.decompression_time += stats.decompression_time;
+        }
+        return result;
+    }
+
+    RegistryImpl& default_registry() {
+        static SelfRegistryImpl registry;
+        return registry;
+    }
+
+    Registry& self_registry() {
+        return default_registry();
+    }
+
+    RegistryReadLock::RegistryReadLock() {
+        if (!read_locks++)
+            default_registry().lock_.lock_shared();
+    }
+
+    RegistryReadLock::~RegistryReadLock() {
+        if (!--read_locks)
+            default_registry().lock_.unlock_shared();
+    }
 
     TypeInfo& type_of_(void *dummy_addr) {
-        return *inferred_type_registry.at(reinterpret_cast<size_t>(dummy_addr));
+        RegistryImpl& registry = default_registry();
+        return lookup(registry, registry.inferred_types_, reinterpret_cast<size_t>(dummy_addr));
     }
 
     TypeInfo& type_of_(std::string name) {
-        return *type_registry.at(name);
+        return default_registry().find_type(name);
     }
 
     TypeInfo& type_of_(const std::type_info& info) {
@@ -24,11 +221,11 @@ namespace Insight {
     }
 
     NamespaceInfo& root_namespace() {
-        return *ROOT_NAMESPACE;
+        return default_registry().root_namespace();
     }
 
     NamespaceInfo& namespace_of_(std::string name) {
-        return *namespaces.at(name);
+        return default_registry().find_namespace(name);
     }
 
 }
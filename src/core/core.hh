@@ -1,23 +1,194 @@
 #ifndef INSIGHT_CORE_CC_H
 # define INSIGHT_CORE_CC_H
 
+# include <atomic>
+# include <functional>
 # include <unordered_map>
 # include <vector>
 # include <memory>
+# include <mutex>
+# include <shared_mutex>
 # include <string>
+# include <sys/stat.h>
 # include "insight/insight"
+# include "insight/registry"
 # include "data/internal.hh"
+# include "util/elf.hh"
 
 namespace Insight {
 
-    extern std::shared_ptr<NamespaceInfoImpl> ROOT_NAMESPACE;
-    extern std::shared_ptr<TypeInfo> VOID_TYPE;
-    extern std::unordered_map<std::string, std::shared_ptr<NamespaceInfo>> namespaces;
+    class RegistryImpl;
 
-    extern std::unordered_map<std::string, std::shared_ptr<TypeInfo>> type_registry;
-    extern std::unordered_map<size_t, std::shared_ptr<TypeInfo>> inferred_type_registry;
+    // Follows the units of a registry as they are built, so that they can be
+    // published while the others are still being read.
+    class UnitListener {
+    public:
+        virtual ~UnitListener() {}
 
-    extern std::vector<std::shared_ptr<Named>> all_objects;
+        // Names that lookups are waiting for, the units defining them are
+        // built first.
+        virtual std::vector<std::string> wanted() = 0;
+
+        // Called around the building of each unit, which happens without
+        // locking the registry. Loading stops before a unit if begin_unit
+        // returns false. end_unit calls complete, when set, under the exclusive
+        // lock of the registry to change elements that may already be published.
+        virtual bool begin_unit() = 0;
+        virtual void end_unit(const std::function<void()>& complete) = 0;
+    };
+
+    // An object loaded in the current process: its own metadata, and the
+    // elements it added to the namespaces shared by all objects.
+    struct Module {
+        ModuleInfo info;
+        struct stat file;   // when read, to tell reloads of objects without build id
+        std::shared_ptr<RegistryImpl> registry;
+        std::vector<std::pair<std::shared_ptr<NamespaceInfoImpl>, std::shared_ptr<Named>>> members;
+    };
+
+    // A type shared by the units describing it, with the size and the number
+    // of members of its DIE, which the DIEs of the same signature must have.
+    struct CanonicalType {
+        std::shared_ptr<TypeInfo> type;
+        uint64_t size;
+        size_t members;
+    };
+
+    // Elements added to the metadata of a registry since it was last merged
+    // into the registry holding it as a module.
+    struct Additions {
+        std::vector<std::shared_ptr<NamespaceInfoImpl>> namespaces;
+        std::vector<std::pair<std::shared_ptr<NamespaceInfoImpl>, std::shared_ptr<Named>>> members;
+        std::vector<std::string> types;
+        std::vector<size_t> inferred_types;
+    };
+
+    // A split unit whose contents were not read yet: the file holding it,
+    // and its DWO id when the file is a package of the units of a binary.
+    struct SplitUnit {
+        std::string path;
+        uint64_t id;
+    };
+
+    class RegistryImpl : public Registry {
+    public:
+        RegistryImpl(std::string path);
+        virtual ~RegistryImpl();
+        RegistryImpl(const RegistryImpl&) = delete;
+        RegistryImpl& operator=(const RegistryImpl&) = delete;
+
+        virtual NamespaceInfo& root_namespace() const override;
+        virtual TypeInfo& find_type(const std::string& name) const override;
+        virtual NamespaceInfo& find_namespace(const std::string& name) const override;
+        virtual const std::string& path() const override;
+        virtual LoadStatistics statistics() const override;
+
+        // Reads more of the metadata whose loading was deferred, and returns
+        // false once everything is loaded.
+        virtual bool load_more();
+        void load_all();
+
+        // Record what is added to the metadata, when additions are tracked.
+        void added_namespace(std::shared_ptr<NamespaceInfoImpl> ns);
+        void added_member(std::shared_ptr<NamespaceInfoImpl> parent, std::shared_ptr<Named> member);
+        void added_type(const std::string& name);
+        void added_inferred_type(size_t address);
+
+        std::string path_;
+        uintptr_t bias_;
+        bool loaded_;       // whether the object is loaded in the current process
+        std::shared_ptr<NamespaceInfoImpl> root_;
+        std::shared_ptr<TypeInfo> void_type_;
+        std::unordered_map<std::string, std::shared_ptr<NamespaceInfo>> namespaces_;
+
+        std::unordered_map<std::string, std::shared_ptr<TypeInfo>> types_;
+        std::unordered_map<size_t, std::shared_ptr<TypeInfo>> inferred_types_;
+
+        std::vector<std::shared_ptr<Named>> objects_;
+
+        // types shared by the units describing them, by signature
+        std::unordered_map<uint64_t, CanonicalType> canonical_types_;
+
+        // set while the registry is loaded in the background
+        UnitListener* listener_;
+
+        // restricts what is read, null to read everything
+        std::shared_ptr<const LoadFilter> filter_;
+
+        // Whether the members of structures are built on first access. Types
+        // are built under the build lock, by the loader or on first access.
+        bool lazy_members_;
+        mutable std::recursive_mutex build_mutex_;
+
+        // Registries of modules keep what was added since they were last
+        // merged, so that they are merged incrementally. Under the build lock.
+        bool track_additions_;
+        Additions additions_;
+
+        // Set on the registry of the process when building the members of a
+        // structure added to a module, which the next missed lookup merges.
+        mutable std::atomic<bool> unmerged_;
+
+        // Lookups share the lock, adding or removing a module takes it
+        // exclusively. Modules are updated by one thread at a time. Split
+        // units are read as modules of the registry of their binary.
+        mutable std::shared_timed_mutex lock_;
+        mutable std::mutex modules_mutex_;
+        std::vector<std::shared_ptr<Module>> modules_;
+
+        // split DWARF units that have not been read yet
+        mutable std::mutex pending_mutex_;
+        std::vector<SplitUnit> pending_units_;
+
+        // files the metadata is read from, and the cost of reading it
+        mutable std::mutex statistics_mutex_;
+        std::vector<std::shared_ptr<ElfFile>> files_;
+        std::vector<std::shared_ptr<MemberLoader>> member_loaders_;
+        LoadStatistics statistics_;
+    };
+
+    // The registry of the current process, whose deferred metadata is held
+    // by the registries of its modules.
+    class SelfRegistryImpl : public RegistryImpl {
+    public:
+        SelfRegistryImpl();
+
+        virtual bool load_more() override;
+    };
+
+    RegistryImpl& default_registry();
+
+    // Called after a library is loaded or unloaded: updates the modules once
+    // the process is initialized, with its options, or has the background
+    // loader do it when it is running.
+    void modules_changed();
+
+    // Adds to a registry what one of its modules added since it was last
+    // merged, under the exclusive lock of the registry. Returns whether the
+    // module added anything.
+    bool merge_module(RegistryImpl& registry, Module& module);
+
+    // Merges every module of a registry, and the parts of those modules,
+    // to publish what was built after they were loaded: the types built
+    // with the members of structures. Under the exclusive lock.
+    bool merge_modules(RegistryImpl& registry);
+
+    // Shared lock on the metadata of a registry for the duration of a lookup,
+    // unless the thread already holds a RegistryReadLock on it.
+    class LookupLock {
+    public:
+        LookupLock(const RegistryImpl& registry);
+        ~LookupLock();
+
+        LookupLock(const LookupLock&) = delete;
+        LookupLock& operator=(const LookupLock&) = delete;
+
+        // Whether deferred metadata may be loaded by the current thread.
+        static bool can_load(const RegistryImpl& registry);
+
+    private:
+        const RegistryImpl* locked_;
+    };
 
 }
 
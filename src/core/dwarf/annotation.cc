@@ -42,8 +42,8 @@ namespace Insight {
     }
 
     size_t get_src_location_offset(Dwarf::Die& die) {
-        std::unique_ptr<const Dwarf::Attribute> lineattr = die.get_attribute(DW_AT_decl_line);
-        std::unique_ptr<const Dwarf::Attribute> fileattr = die.get_attribute(DW_AT_decl_file);
+        auto lineattr = die.get_attribute(DW_AT_decl_line);
+        auto fileattr = die.get_attribute(DW_AT_decl_file);
 
         if (!lineattr || !fileattr)
             return 0;
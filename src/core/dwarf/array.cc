@@ -0,0 +1,82 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "array.hh"
+
+namespace Insight {
+
+    Result ArrayBuilder::operator()(Dwarf::TaggedDie<DW_TAG_subrange_type> &die) {
+        auto countattr = die.get_attribute(DW_AT_count);
+        auto boundattr = die.get_attribute(DW_AT_upper_bound);
+
+        // flexible array members have neither a count nor an upper bound
+        if (countattr)
+            dimensions.push_back(countattr->as<Dwarf::Unsigned>());
+        else if (boundattr)
+            dimensions.push_back(boundattr->as<Dwarf::Unsigned>() + 1);
+        else
+            dimensions.push_back(0);
+
+        return Result::SKIP;
+    }
+
+    ArrayBuilder::ArrayBuilder()
+        : dimensions()
+    {}
+
+    std::shared_ptr<TypeInfo> build_array_type(Dwarf::Die &die, TypeBuilder& tb, bool register_parent) {
+        std::shared_ptr<Container> parent = get_parent(tb.ctx);
+
+        std::shared_ptr<ArrayTypeInfoImpl> info = std::make_shared<ArrayTypeInfoImpl>();
+        tb.ctx.types[die.get_offset()] = info;
+
+        std::shared_ptr<TypeInfo> element = tb.get_type_attr(die);
+        if (!element) {
+            tb.ctx.types.erase(die.get_offset());
+            return nullptr;
+        }
+
+        ArrayBuilder builder;
+        die.visit_headless(builder);
+        if (builder.dimensions.empty())
+            builder.dimensions.push_back(0);
+
+        // T[a][b] is described by a single DIE with one subrange per
+        // dimension, and is modeled as an array of a elements of T[b].
+        std::string base = element->name();
+        std::string suffix;
+        for (size_t i = builder.dimensions.size() - 1; i > 0; --i) {
+            suffix = "[" + std::to_string(builder.dimensions[i]) + "]" + suffix;
+
+            std::shared_ptr<ArrayTypeInfoImpl> sub = std::make_shared<ArrayTypeInfoImpl>();
+            sub->set_type(element, builder.dimensions[i]);
+            sub->name_ = base + suffix;
+            tb.ctx.registry.objects_.push_back(sub);
+            element = sub;
+        }
+        info->set_type(element, builder.dimensions[0]);
+        info->name_ = base + "[" + std::to_string(builder.dimensions[0]) + "]" + suffix;
+
+        if (register_parent)
+            info->set_parent(parent);
+
+        return info;
+    }
+
+}
@@ -0,0 +1,45 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef INSIGHT_ARRAY_HH
+# define INSIGHT_ARRAY_HH
+
+# include "type.hh"
+
+namespace Insight {
+
+    struct ArrayBuilder : public Dwarf::DefaultDieVisitor {
+
+        Result operator()(Dwarf::TaggedDie<DW_TAG_subrange_type> &die);
+
+        template <typename T>
+        Result operator()([[gnu::unused]] T& t) {
+            return Result::SKIP;
+        }
+
+        ArrayBuilder();
+
+        std::vector<size_t> dimensions;
+    };
+
+    std::shared_ptr<TypeInfo> build_array_type(Dwarf::Die &die, TypeBuilder& tb, bool register_parent);
+
+}
+
+#endif /* !INSIGHT_ARRAY_HH */
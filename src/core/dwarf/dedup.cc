@@ -0,0 +1,481 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <cstring>
+#include "dedup.hh"
+#include "annotation.hh"
+
+namespace Insight {
+
+    Signature::Signature()
+        : value_(0xcbf29ce484222325ull)
+    {}
+
+    void Signature::add_bytes(const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            value_ ^= bytes[i];
+            value_ *= 0x100000001b3ull;
+        }
+    }
+
+    void Signature::add(const char* str) {
+        add_bytes(str, std::strlen(str) + 1);
+    }
+
+    void Signature::add(uint64_t value) {
+        add_bytes(&value, sizeof (value));
+    }
+
+    void Signature::add(const void* identity) {
+        add(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(identity)));
+    }
+
+    uint64_t Signature::value() const {
+        return value_ ? value_ : 1;
+    }
+
+    ScopeFinder::ScopeFinder(BuildContext& ctx, Dwarf::Off unit)
+        : ctx(ctx)
+        , unit(unit)
+        , scope(0)
+        , path()
+        , filter(NamespaceFilter::READ)
+    {
+        // types built on first access may be described by any unit
+        if (ctx.member_loader.expired()) {
+            ctx.scopes.clear();
+            ctx.scope_names.assign(1, "");
+        } else if (ctx.scope_names.empty()) {
+            ctx.scope_names.assign(1, "");
+        }
+    }
+
+    Result ScopeFinder::enter(Dwarf::Die& die, const std::string& name) {
+        uint32_t outer = scope;
+        scope = ctx.scope_names.size();
+        ctx.scope_names.push_back(ctx.scope_names[outer] + "::" + name);
+        die.visit_headless(*this);
+        scope = outer;
+        return Result::SKIP;
+    }
+
+    Result ScopeFinder::enter_type(Dwarf::Die& die) {
+        const char* name = die.get_name();
+        if (!name)
+            return Result::SKIP;
+        ctx.scopes[die.get_offset()] = scope;
+        return filter == NamespaceFilter::READ ? enter(die, name) : Result::SKIP;
+    }
+
+    Result ScopeFinder::operator()(Dwarf::TaggedDie<DW_TAG_namespace>& die) {
+        // anonymous namespaces are private to their unit
+        const char* name = die.get_name();
+        if (!name)
+            return enter(die, "(anonymous " + std::to_string(unit) + ")");
+
+        if (!ctx.registry.filter_ || filter == NamespaceFilter::SKIP)
+            return enter(die, name);
+
+        std::string outer = path;
+        NamespaceFilter outer_filter = filter;
+        path += "::";
+        path += name;
+        filter = filter_namespace(*ctx.registry.filter_, path);
+        enter(die, name);
+        filter = outer_filter;
+        path = outer;
+        return Result::SKIP;
+    }
+
+    Result ScopeFinder::operator()(Dwarf::TaggedDie<DW_TAG_class_type>& die) {
+        return enter_type(die);
+    }
+
+    Result ScopeFinder::operator()(Dwarf::TaggedDie<DW_TAG_structure_type>& die) {
+        return enter_type(die);
+    }
+
+    Result ScopeFinder::operator()(Dwarf::TaggedDie<DW_TAG_union_type>& die) {
+        return enter_type(die);
+    }
+
+    Result ScopeFinder::operator()(Dwarf::TaggedDie<DW_TAG_enumeration_type>& die) {
+        if (die.get_name())
+            ctx.scopes[die.get_offset()] = scope;
+        return Result::SKIP;
+    }
+
+    Result ScopeFinder::operator()(Dwarf::TaggedDie<DW_TAG_typedef>& die) {
+        if (die.get_name())
+            ctx.scopes[die.get_offset()] = scope;
+        return Result::SKIP;
+    }
+
+    namespace {
+
+        // how deep anonymous aggregates are described within a signature
+        const int max_depth = 4;
+
+        uint64_t unsigned_attr(Dwarf::Die& die, Dwarf::Half name) {
+            auto attr = die.get_attribute(name);
+            return attr ? attr->as<Dwarf::Unsigned>() : static_cast<uint64_t>(-1);
+        }
+
+        void describe(BuildContext& ctx, Dwarf::Die& die, Signature& signature, int depth);
+
+        void describe_type_attr(BuildContext& ctx, Dwarf::Die& die, Signature& signature, int depth) {
+            auto attr = die.get_attribute(DW_AT_type);
+            if (!attr) {
+                signature.add("void");
+                return;
+            }
+
+            auto target = attr->as_die();
+            if (!target) {
+                signature.add("?");
+                return;
+            }
+
+            Dwarf::Die::visitor_to_die to_die;
+            describe(ctx, target->apply_visitor(to_die), signature, depth);
+        }
+
+        // Aggregates nested too deep are described by their layout, without
+        // the types of their members.
+        struct BodySignature : public Dwarf::DefaultDieVisitor {
+
+            Result operator()(Dwarf::TaggedDie<DW_TAG_member>& die) {
+                return add_member(die);
+            }
+
+            Result operator()(Dwarf::TaggedDie<DW_TAG_variable>& die) {
+                return add_member(die);
+            }
+
+            Result operator()(Dwarf::TaggedDie<DW_TAG_subprogram>& die) {
+                signature.add(static_cast<uint64_t>(DW_TAG_subprogram));
+                signature.add(die.get_name() ?: "");
+                auto linkage = die.get_attribute(DW_AT_linkage_name);
+                signature.add(linkage ? linkage->as<const char*>() : "");
+                return Result::SKIP;
+            }
+
+            Result operator()(Dwarf::TaggedDie<DW_TAG_inheritance>& die) {
+                signature.add(static_cast<uint64_t>(DW_TAG_inheritance));
+                signature.add(static_cast<uint64_t>(get_offset(die)));
+                if (depth <= max_depth)
+                    describe_type_attr(ctx, die, signature, depth);
+                return Result::SKIP;
+            }
+
+            Result operator()(Dwarf::TaggedDie<DW_TAG_enumerator>& die) {
+                signature.add(static_cast<uint64_t>(DW_TAG_enumerator));
+                signature.add(die.get_name() ?: "");
+                auto attr = die.get_attribute(DW_AT_const_value);
+                if (attr) {
+                    switch (attr->form()) {
+                        case DW_FORM_block1:
+                        case DW_FORM_block2:
+                        case DW_FORM_block4:
+                        case DW_FORM_block:
+                            signature.add(static_cast<uint64_t>(attr->form()));
+                            break;
+                        default:
+                            signature.add(attr->as<Dwarf::Unsigned>());
+                            break;
+                    }
+                }
+                return Result::SKIP;
+            }
+
+            template <typename T>
+            Result operator()([[gnu::unused]] T& die) {
+                return Result::SKIP;
+            }
+
+            Result add_member(Dwarf::Die& die) {
+                signature.add(static_cast<uint64_t>(die.get_tag().get_id()));
+                signature.add(die.get_name() ?: "");
+                signature.add(static_cast<uint64_t>(get_offset(die)));
+                signature.add(unsigned_attr(die, DW_AT_data_bit_offset));
+                signature.add(unsigned_attr(die, DW_AT_bit_size));
+                if (depth <= max_depth)
+                    describe_type_attr(ctx, die, signature, depth);
+                return Result::SKIP;
+            }
+
+            BodySignature(BuildContext& ctx, Signature& signature, int depth)
+                : ctx(ctx), signature(signature), depth(depth)
+            {}
+
+            BuildContext& ctx;
+            Signature& signature;
+            int depth;
+        };
+
+        // Describes a type referenced by another: named types by their
+        // qualified name, anonymous ones by their structure.
+        void describe(BuildContext& ctx, Dwarf::Die& die, Signature& signature, int depth) {
+            int tag = die.get_tag().get_id();
+            signature.add(static_cast<uint64_t>(tag));
+
+            const char* name = die.get_name();
+            if (name) {
+                auto it = ctx.scopes.find(die.get_offset());
+                signature.add(it != ctx.scopes.end() ? ctx.scope_names[it->second].c_str() : "?");
+                signature.add(name);
+                return;
+            }
+
+            if (depth >= max_depth) {
+                switch (tag) {
+                    case DW_TAG_class_type:
+                    case DW_TAG_structure_type:
+                    case DW_TAG_union_type:
+                    case DW_TAG_enumeration_type:
+                        break;
+                    default:
+                        return;
+                }
+            }
+
+            switch (tag) {
+                case DW_TAG_class_type:
+                case DW_TAG_structure_type:
+                case DW_TAG_union_type:
+                case DW_TAG_enumeration_type: {
+                    signature.add(unsigned_attr(die, DW_AT_byte_size));
+                    BodySignature body(ctx, signature, depth + 1);
+                    die.visit_headless(body);
+                } break;
+                case DW_TAG_array_type: {
+                    ArrayBuilder builder;
+                    die.visit_headless(builder);
+                    for (size_t dimension : builder.dimensions)
+                        signature.add(static_cast<uint64_t>(dimension));
+                    describe_type_attr(ctx, die, signature, depth + 1);
+                } break;
+                default:
+                    describe_type_attr(ctx, die, signature, depth + 1);
+                    break;
+            }
+        }
+
+        template <typename M>
+        void adopt_method(BuildContext& ctx, Dwarf::Off off, std::shared_ptr<M> method) {
+            if (!method)
+                return;
+
+            ctx.methods.insert(std::make_pair(off, AnyMethod(method)));
+
+            auto it = ctx.method_addresses.find(off);
+            if (it != ctx.method_addresses.end() && !method->address_) {
+                method->address_ = it->second;
+                method->bias_ = &ctx.registry.bias_;
+            }
+        }
+
+        struct MethodAdopter : public Dwarf::DefaultDieVisitor {
+
+            Result operator()(Dwarf::TaggedDie<DW_TAG_subprogram>& die) {
+                const char* name = die.get_name();
+                if (!name)
+                    return Result::SKIP;
+
+                if (struct_) {
+                    auto it = struct_->methods_.find(name);
+                    if (it != struct_->methods_.end())
+                        adopt_method(ctx, die.get_offset(), std::dynamic_pointer_cast<MethodInfoImpl>(it->second));
+                } else if (union_) {
+                    auto it = union_->methods_.find(name);
+                    if (it != union_->methods_.end())
+                        adopt_method(ctx, die.get_offset(), std::dynamic_pointer_cast<UnionMethodInfoImpl>(it->second));
+                }
+                return Result::SKIP;
+            }
+
+            template <typename T>
+            Result operator()([[gnu::unused]] T& die) {
+                return Result::SKIP;
+            }
+
+            MethodAdopter(BuildContext& ctx, std::shared_ptr<TypeInfo>& type)
+                : ctx(ctx)
+                , struct_(std::dynamic_pointer_cast<StructInfoImpl>(type))
+                , union_(std::dynamic_pointer_cast<UnionInfoImpl>(type))
+            {}
+
+            BuildContext& ctx;
+            std::shared_ptr<StructInfoImpl> struct_;
+            std::shared_ptr<UnionInfoImpl> union_;
+        };
+
+    }
+
+    uint64_t type_signature(BuildContext& ctx, Dwarf::Die& die) {
+        const char* name = die.get_name();
+        if (!name)
+            return 0;
+
+        int tag = die.get_tag().get_id();
+        Signature signature;
+        signature.add(static_cast<uint64_t>(tag));
+        signature.add(name);
+
+        switch (tag) {
+            case DW_TAG_base_type:
+                signature.add(unsigned_attr(die, DW_AT_byte_size));
+                signature.add(unsigned_attr(die, DW_AT_encoding));
+                return signature.value();
+            case DW_TAG_unspecified_type:
+                return signature.value();
+            case DW_TAG_class_type:
+            case DW_TAG_structure_type:
+            case DW_TAG_union_type:
+            case DW_TAG_enumeration_type:
+            case DW_TAG_typedef:
+                break;
+            default:
+                return 0;
+        }
+
+        auto it = ctx.scopes.find(die.get_offset());
+        if (it == ctx.scopes.end())
+            return 0;
+        signature.add(ctx.scope_names[it->second].c_str());
+
+        if (tag == DW_TAG_typedef) {
+            describe_type_attr(ctx, die, signature, 0);
+            return signature.value();
+        }
+
+        signature.add(static_cast<uint64_t>(bool(die.get_attribute(DW_AT_declaration))));
+        signature.add(unsigned_attr(die, DW_AT_byte_size));
+        signature.add(unsigned_attr(die, DW_AT_alignment));
+
+        BodySignature body(ctx, signature, 0);
+        die.visit_headless(body);
+        return signature.value();
+    }
+
+    uint64_t derived_signature(const TypeInfo& type) {
+        Signature signature;
+        if (auto pointer = dynamic_cast<const PointerTypeInfoImpl*>(&type)) {
+            signature.add(static_cast<uint64_t>(DW_TAG_pointer_type));
+            signature.add(pointer->type_.get());
+            signature.add(static_cast<uint64_t>(pointer->size_));
+        } else if (auto constant = dynamic_cast<const ConstTypeInfoImpl*>(&type)) {
+            signature.add(static_cast<uint64_t>(DW_TAG_const_type));
+            signature.add(constant->type_.get());
+        } else if (auto array = dynamic_cast<const ArrayTypeInfoImpl*>(&type)) {
+            // the inner dimensions of an array are not shared, the signature
+            // goes through them down to the element type
+            signature.add(static_cast<uint64_t>(DW_TAG_array_type));
+            std::shared_ptr<TypeInfo> element;
+            while (array) {
+                signature.add(static_cast<uint64_t>(array->length_));
+                element = array->type_.lock();
+                array = dynamic_cast<const ArrayTypeInfoImpl*>(element.get());
+            }
+            signature.add(element.get());
+        } else {
+            return 0;
+        }
+        return signature.value();
+    }
+
+    namespace {
+
+        struct MemberCounter : public Dwarf::DefaultDieVisitor {
+
+            Result operator()(Dwarf::TaggedDie<DW_TAG_member>&) {
+                ++count;
+                return Result::SKIP;
+            }
+
+            Result operator()(Dwarf::TaggedDie<DW_TAG_variable>&) {
+                ++count;
+                return Result::SKIP;
+            }
+
+            Result operator()(Dwarf::TaggedDie<DW_TAG_inheritance>&) {
+                ++count;
+                return Result::SKIP;
+            }
+
+            Result operator()(Dwarf::TaggedDie<DW_TAG_enumerator>&) {
+                ++count;
+                return Result::SKIP;
+            }
+
+            template <typename T>
+            Result operator()([[gnu::unused]] T& die) {
+                return Result::SKIP;
+            }
+
+            size_t count = 0;
+        };
+
+        // Methods are left out, as units only describe those they use.
+        size_t count_members(Dwarf::Die& die) {
+            MemberCounter counter;
+            die.visit_headless(counter);
+            return counter.count;
+        }
+
+    }
+
+    CanonicalType canonical_type(Dwarf::Die& die, std::shared_ptr<TypeInfo> type) {
+        return CanonicalType{std::move(type), unsigned_attr(die, DW_AT_byte_size), count_members(die)};
+    }
+
+    bool same_shape(Dwarf::Die& die, const CanonicalType& canonical) {
+        const char* name = die.get_name();
+        return canonical.type && name && canonical.type->name() == name
+            && canonical.size == unsigned_attr(die, DW_AT_byte_size)
+            && canonical.members == count_members(die);
+    }
+
+    void adopt_methods(BuildContext& ctx, Dwarf::Die& die, std::shared_ptr<TypeInfo>& type) {
+        MethodAdopter adopter(ctx, type);
+        die.visit_headless(adopter);
+    }
+
+    void adopt_duplicate(BuildContext& ctx, Dwarf::Die& die, std::shared_ptr<TypeInfo>& type) {
+        // the methods of types whose members are not built yet are adopted
+        // once they are, by the loader reading the same file as this unit
+        auto lazy = std::dynamic_pointer_cast<StructInfoImpl>(type);
+        if (lazy && !lazy->materialized_ && lazy->member_loader_.lock() == ctx.member_loader.lock()) {
+            lazy->duplicates_.push_back(die.get_offset());
+        } else {
+            if (lazy)
+                lazy->materialize();
+            adopt_methods(ctx, die, type);
+        }
+
+        if (auto info = std::dynamic_pointer_cast<StructInfoImpl>(type))
+            mark_element_line(ctx, die, info);
+        else if (auto info = std::dynamic_pointer_cast<UnionInfoImpl>(type))
+            mark_element_line(ctx, die, info);
+        else if (auto info = std::dynamic_pointer_cast<EnumInfoImpl>(type))
+            mark_element_line(ctx, die, info);
+    }
+
+}
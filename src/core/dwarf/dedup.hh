@@ -0,0 +1,100 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef INSIGHT_DEDUP_HH
+# define INSIGHT_DEDUP_HH
+
+# include "dwarf.hh"
+# include "type.hh"
+
+namespace Insight {
+
+    // Every unit including a header describes its types again. Types are
+    // shared between units when their signatures, a hash of their
+    // structure, are equal.
+    class Signature {
+    public:
+        Signature();
+
+        void add(const char* str);
+        void add(uint64_t value);
+        void add(const void* identity);
+
+        uint64_t value() const;
+
+    private:
+        void add_bytes(const void* data, size_t size);
+
+        uint64_t value_;
+    };
+
+    // Records the scope of the named types of a unit, which is not part of
+    // their DIE. Types local to functions or anonymous aggregates are left
+    // out, and are never shared. Neither are the types nested in those of
+    // the namespaces left out by the filter of the registry, which are not
+    // entered.
+    struct ScopeFinder : public Dwarf::DefaultDieVisitor {
+
+        Result operator()(Dwarf::TaggedDie<DW_TAG_namespace>& die);
+        Result operator()(Dwarf::TaggedDie<DW_TAG_class_type>& die);
+        Result operator()(Dwarf::TaggedDie<DW_TAG_structure_type>& die);
+        Result operator()(Dwarf::TaggedDie<DW_TAG_union_type>& die);
+        Result operator()(Dwarf::TaggedDie<DW_TAG_enumeration_type>& die);
+        Result operator()(Dwarf::TaggedDie<DW_TAG_typedef>& die);
+
+        template <typename T>
+        Result operator()([[gnu::unused]] T& die) {
+            return Result::SKIP;
+        }
+
+        ScopeFinder(BuildContext& ctx, Dwarf::Off unit);
+
+    private:
+        Result enter(Dwarf::Die& die, const std::string& name);
+        Result enter_type(Dwarf::Die& die);
+
+        BuildContext& ctx;
+        Dwarf::Off unit;
+        uint32_t scope;
+        std::string path;   // full name of the namespace
+        NamespaceFilter filter;
+    };
+
+    // The signature of a named type, computed from its DIE before it is
+    // built, or 0 if the type cannot be shared.
+    uint64_t type_signature(BuildContext& ctx, Dwarf::Die& die);
+
+    // The signature of a pointer, const or array type, from the identity of
+    // the types it is made of.
+    uint64_t derived_signature(const TypeInfo& type);
+
+    // A type shared under the signature of its DIE, and whether the type of
+    // another DIE with the same signature has the same name, size and number
+    // of members, so that colliding signatures do not merge distinct types.
+    CanonicalType canonical_type(Dwarf::Die& die, std::shared_ptr<TypeInfo> type);
+    bool same_shape(Dwarf::Die& die, const CanonicalType& canonical);
+
+    // Binds the methods described by the DIE of a duplicate type to those of
+    // the shared type, so that their definitions in the unit find them.
+    void adopt_duplicate(BuildContext& ctx, Dwarf::Die& die, std::shared_ptr<TypeInfo>& type);
+    void adopt_methods(BuildContext& ctx, Dwarf::Die& die, std::shared_ptr<TypeInfo>& type);
+
+}
+
+#endif /* !INSIGHT_DEDUP_HH */
@@ -17,12 +17,22 @@
  * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
  *
  */
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <unordered_set>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
 #include "dwarf.hh"
 #include "type.hh"
 #include "inference.hh"
 #include "annotation.hh"
 #include "util/mangle.hh"
 #include "subprogram.hh"
+#include "split.hh"
+#include "dedup.hh"
+#include "util/elf.hh"
 
 namespace Insight {
 
@@ -34,22 +44,37 @@ namespace Insight {
         }
     };
 
-    BuildContext::BuildContext(const Dwarf::Debug& d)
+    BuildContext::BuildContext(const Dwarf::Debug& d, RegistryImpl& r)
             : dbg(d)
+            , registry(r)
             , types()
             , methods()
             , method_addresses()
             , anonymous_count(0)
             , container_stack()
             , annotations()
+            , annotated()
+            , infer_types(true)
+            , scope_names()
+            , scopes()
+            , member_loader()
+            , defer_published(false)
+            , deferred()
     {}
 
+    void complete_published(BuildContext& ctx, std::function<void()> change) {
+        if (ctx.defer_published)
+            ctx.deferred.push_back(std::move(change));
+        else
+            change();
+    }
+
     std::shared_ptr<Container> get_parent(BuildContext& ctx) {
         return boost::apply_visitor(get_superclass<Container>(), ctx.container_stack.top());
     }
 
     size_t get_offset(Dwarf::Die &die) {
-        std::unique_ptr<const Dwarf::Attribute> attr = die.get_attribute(DW_AT_data_member_location);
+        auto attr = die.get_attribute(DW_AT_data_member_location);
         if (attr) {
             return attr->as<Dwarf::Unsigned>();
         }
@@ -60,12 +85,28 @@ namespace Insight {
 
         using Result = Dwarf::Die::TraversalResult;
 
-        DieVisitor(BuildContext& ctx, TypeBuilder& tb) : ctx(ctx), tb(tb) {}
+        DieVisitor(BuildContext& ctx, TypeBuilder& tb) : ctx(ctx), tb(tb), traversing(false) {}
 
         Result operator()(Dwarf::TaggedDie<DW_TAG_namespace>& die) {
+            // the members of anonymous namespaces are found from the
+            // enclosing namespace
+            if (!die.get_name()) {
+                visit_children(die);
+                return Result::SKIP;
+            }
+
             std::shared_ptr<Container> parent = get_parent(ctx);
 
             std::shared_ptr<NamespaceInfoImpl> parentns = boost::get<std::shared_ptr<NamespaceInfoImpl>>(ctx.container_stack.top());
+
+            // namespaces left out by the filter are skipped without being read
+            NamespaceFilter filter = NamespaceFilter::READ;
+            if (ctx.registry.filter_) {
+                filter = filter_namespace(*ctx.registry.filter_, parentns->fullname() + "::" + die.get_name());
+                if (filter == NamespaceFilter::SKIP)
+                    return Result::SKIP;
+            }
+
             std::shared_ptr<NamespaceInfoImpl> ns;
             auto it = parentns->nested_namespaces_.find(die.get_name());
             if (it != parentns->nested_namespaces_.end()) {
@@ -73,10 +114,15 @@ namespace Insight {
             } else {
                 ns = std::make_shared<NamespaceInfoImpl>(die.get_name(), parent);
                 parentns->add_nested_namespace(ns);
-                namespaces[ns->fullname()] = ns;
+                ctx.registry.namespaces_[ns->fullname()] = ns;
             }
+            // again for each unit, which may annotate it
+            ctx.registry.added_namespace(ns);
             ctx.container_stack.push(AnyContainer(ns));
-            die.visit_headless(*this);
+            bool outer = traversing;
+            traversing = filter == NamespaceFilter::TRAVERSE;
+            visit_children(die);
+            traversing = outer;
             ctx.container_stack.pop();
 
             mark_element_line(ctx, die, ns);
@@ -94,11 +140,19 @@ namespace Insight {
             return Result::SKIP;
         }
 
-        Result operator()(Dwarf::TaggedDie<DW_TAG_const_type>& die) {
-            handle_type(die);
+        // Derived types are described where they are used, at the top of the
+        // unit. When namespaces are filtered out, they are only built when
+        // something that is read uses them.
+        Result handle_derived_type(Dwarf::Die& die) {
+            if (!ctx.registry.filter_ || ctx.registry.filter_->namespaces.empty())
+                handle_type(die);
             return Result::SKIP;
         }
 
+        Result operator()(Dwarf::TaggedDie<DW_TAG_const_type>& die) {
+            return handle_derived_type(die);
+        }
+
         Result operator()(Dwarf::TaggedDie<DW_TAG_base_type>& die) {
             handle_type(die);
             return Result::SKIP;
@@ -125,8 +179,7 @@ namespace Insight {
         }
 
         Result operator()(Dwarf::TaggedDie<DW_TAG_pointer_type>& die) {
-            handle_type(die);
-            return Result::SKIP;
+            return handle_derived_type(die);
         }
 
         Result operator()(Dwarf::TaggedDie<DW_TAG_typedef>& die) {
@@ -137,30 +190,31 @@ namespace Insight {
         Result operator()(Dwarf::TaggedDie<DW_TAG_subprogram>& die) {
             std::shared_ptr<Container> parent = get_parent(ctx);
 
-            std::unique_ptr<const Dwarf::Attribute> attrspec = die.get_attribute(DW_AT_specification);
+            auto attrspec = die.get_attribute(DW_AT_specification);
             if (!attrspec) {
-                TypeInferer inferer(tb);
-
-                die.visit_headless(inferer);
+                if (ctx.infer_types) {
+                    TypeInferer inferer(tb);
+                    die.visit_headless(inferer);
+                }
 
                 if (!die.get_name()) // ignore unnamed functions
                     return Result::SKIP;
 
                 auto return_type = tb.get_type_attr(die);
                 if (!return_type)
-                    return_type = VOID_TYPE;
+                    return_type = ctx.registry.void_type_;
 
                 std::shared_ptr<FunctionInfoImpl> func = std::make_shared<FunctionInfoImpl>(die.get_name(), return_type, parent);
 
                 add_func_to_parent(ctx, func);
 
-                std::unique_ptr<const Dwarf::Attribute> attraddr = die.get_attribute(DW_AT_low_pc);
+                auto attraddr = die.get_attribute(DW_AT_low_pc);
                 if (!attraddr)
                     return Result::SKIP;
 
                 Dwarf::Addr addr = attraddr->as<Dwarf::Addr>();
 
-                func->address_ = reinterpret_cast<void*>(addr);
+                set_address(ctx, *func, addr);
 
                 mark_element_line(ctx, die, func);
             } else {
@@ -172,21 +226,21 @@ namespace Insight {
                             if (method->is_virtual())
                                 return;
 
-                            std::unique_ptr<const Dwarf::Attribute> attraddr = die.get_attribute(DW_AT_low_pc);
+                            auto attraddr = die.get_attribute(DW_AT_low_pc);
                             if (!attraddr)
                                 return;
                             Dwarf::Addr addr = attraddr->as<Dwarf::Addr>();
 
-                            method->address_ = reinterpret_cast<void*>(addr);
+                            set_address(tb.ctx, *method, addr);
                         }
 
                         void operator()(std::shared_ptr<UnionMethodInfoImpl>& method) {
-                            std::unique_ptr<const Dwarf::Attribute> attraddr = die.get_attribute(DW_AT_low_pc);
+                            auto attraddr = die.get_attribute(DW_AT_low_pc);
                             if (!attraddr)
                                 return;
                             Dwarf::Addr addr = attraddr->as<Dwarf::Addr>();
 
-                            method->address_ = reinterpret_cast<void*>(addr);
+                            set_address(tb.ctx, *method, addr);
                         }
 
                         AddMethod(Dwarf::Die& d, TypeBuilder& tb) : die(d), tb(tb) {}
@@ -198,7 +252,7 @@ namespace Insight {
                     AddMethod visitor(die, tb);
                     it->second.apply_visitor(visitor);
                 } else {
-                    std::unique_ptr<const Dwarf::Attribute> attraddr = die.get_attribute(DW_AT_low_pc);
+                    auto attraddr = die.get_attribute(DW_AT_low_pc);
                     if (attraddr) {
                         Dwarf::Addr addr = attraddr->as<Dwarf::Addr>();
                         ctx.method_addresses[off] = reinterpret_cast<void*>(addr);
@@ -229,13 +283,17 @@ namespace Insight {
                 std::string annotationName = constType ? constType->type().name() : type->name();
 
                 size_t off = get_src_location_offset(die);
-                if (off)
-                    ctx.annotations[off] = std::make_shared<AnnotationInfoImpl>(annotationName, addr, type);
+                if (off) {
+                    auto annotation = std::make_shared<AnnotationInfoImpl>(annotationName, addr, type);
+                    annotation->bias_ = &ctx.registry.bias_;
+                    ctx.annotations[off] = annotation;
+                }
             } else {
                 size_t loc = locattr->as<Dwarf::Off>();
                 void *addr = reinterpret_cast<void*>(loc);
 
                 auto var = std::make_shared<VariableInfoImpl>(name, addr, type, parent);
+                var->bias_ = &ctx.registry.bias_;
 
                 add_var_to_parent(ctx, var);
 
@@ -249,30 +307,389 @@ namespace Insight {
             return Result::SKIP;
         }
 
+        // Reads only the nested namespaces of a namespace that is traversed.
+        struct NestedNamespaces : public Dwarf::DefaultDieVisitor {
+            Result operator()(Dwarf::TaggedDie<DW_TAG_namespace>& die) {
+                return visitor(die);
+            }
+
+            template <typename T>
+            Result operator()([[gnu::unused]] T& t) {
+                return Result::SKIP;
+            }
+
+            NestedNamespaces(DieVisitor& visitor) : visitor(visitor) {}
+
+            DieVisitor& visitor;
+        };
+
+        void visit_children(Dwarf::Die& die) {
+            if (traversing) {
+                NestedNamespaces nested(*this);
+                die.visit_headless(nested);
+            } else {
+                die.visit_headless(*this);
+            }
+        }
+
         BuildContext& ctx;
         TypeBuilder& tb;
+        bool traversing;
     };
 
-    void initialize() {
-        std::shared_ptr<const Dwarf::Debug> dbg = Dwarf::Debug::self();
-        type_registry["void"] = VOID_TYPE;
+    NamespaceFilter filter_namespace(const LoadFilter& filter, const std::string& fullname) {
+        if (filter.namespaces.empty())
+            return NamespaceFilter::READ;
+
+        NamespaceFilter result = NamespaceFilter::SKIP;
+        for (const std::string& allowed : filter.namespaces) {
+            if (fullname.compare(0, allowed.size(), allowed) == 0
+                    && (fullname.size() == allowed.size() || fullname.compare(allowed.size(), 2, "::") == 0))
+                return NamespaceFilter::READ;
+            if (allowed.compare(0, fullname.size(), fullname) == 0 && allowed.compare(fullname.size(), 2, "::") == 0)
+                result = NamespaceFilter::TRAVERSE;
+        }
+        return result;
+    }
 
-        BuildContext ctx(*dbg);
-        ctx.container_stack.push(AnyContainer(ROOT_NAMESPACE));
+    std::shared_ptr<const LoadFilter> make_filter(LoadFilter filter) {
+        if (filter.units.empty() && filter.source_paths.empty() && filter.namespaces.empty())
+            return nullptr;
+        for (std::string& name : filter.namespaces) {
+            if (name.compare(0, 2, "::") != 0)
+                name = "::" + name;
+        }
+        return std::make_shared<const LoadFilter>(std::move(filter));
+    }
+
+    namespace {
+
+        // Whether a unit is read, from its name and compilation directory.
+        // Units without a name are kept.
+        struct UnitFilter : public Dwarf::DefaultDieVisitor {
+
+            template <typename T>
+            Result operator()(T& die) {
+                const char* name = die.get_name();
+                if (!name)
+                    return Result::BREAK;
+
+                allowed = false;
+                std::string unit(name);
+                for (const std::string& wanted : filter.units) {
+                    if (unit == wanted || (unit.size() > wanted.size()
+                            && unit.compare(unit.size() - wanted.size(), wanted.size(), wanted) == 0
+                            && unit[unit.size() - wanted.size() - 1] == '/')) {
+                        allowed = true;
+                        return Result::BREAK;
+                    }
+                }
+
+                auto dirattr = die.get_attribute(DW_AT_comp_dir);
+                std::string path = unit[0] == '/' || !dirattr ? unit : std::string(dirattr->template as<const char*>()) + "/" + unit;
+                for (const std::string& directory : filter.source_paths) {
+                    std::string prefix = directory.empty() || directory.back() == '/' ? directory : directory + "/";
+                    if (path.compare(0, prefix.size(), prefix) == 0) {
+                        allowed = true;
+                        break;
+                    }
+                }
+                return Result::BREAK;
+            }
+
+            UnitFilter(const LoadFilter& filter) : filter(filter), allowed(true) {}
+
+            const LoadFilter& filter;
+            bool allowed;
+        };
+
+        struct PendingUnit {
+            Dwarf::Off offset;
+            bool infer_types;
+        };
+
+        // Splits a qualified name into its components, leaving the template
+        // arguments whole.
+        std::vector<std::string> split_name(std::string name) {
+            for (const char* prefix : {"struct ", "union ", "enum "}) {
+                if (name.compare(0, std::strlen(prefix), prefix) == 0) {
+                    name = name.substr(std::strlen(prefix));
+                    break;
+                }
+            }
+
+            std::vector<std::string> path;
+            size_t start = name.compare(0, 2, "::") == 0 ? 2 : 0;
+            int depth = 0;
+            for (size_t i = start; i < name.size(); ++i) {
+                if (name[i] == '<' || name[i] == '(')
+                    ++depth;
+                else if (name[i] == '>' || name[i] == ')')
+                    --depth;
+                else if (!depth && name.compare(i, 2, "::") == 0) {
+                    path.push_back(name.substr(start, i - start));
+                    start = i + 2;
+                    ++i;
+                }
+            }
+            path.push_back(name.substr(start));
+            return path;
+        }
+
+        // Finds whether a unit defines a name, only looking into its
+        // namespaces.
+        struct NameFinder : public Dwarf::DefaultDieVisitor {
+
+            Result operator()(Dwarf::TaggedDie<DW_TAG_namespace>& die) {
+                const char* name = die.get_name();
+                if (!name) {
+                    die.visit_headless(*this);
+                } else if (depth + 1 < path.size() && path[depth] == name) {
+                    ++depth;
+                    die.visit_headless(*this);
+                    --depth;
+                }
+                return found ? Result::BREAK : Result::SKIP;
+            }
+
+            template <typename T>
+            Result operator()(T& die) {
+                if (depth + 1 != path.size() || die.get_attribute(DW_AT_declaration))
+                    return Result::SKIP;
+
+                const char* name = die.get_name();
+                found = name && path.back() == name;
+                return found ? Result::BREAK : Result::SKIP;
+            }
+
+            NameFinder(const std::string& name) : path(split_name(name)), depth(0), found(false) {}
+
+            std::vector<std::string> path;
+            size_t depth;
+            bool found;
+        };
+
+        // Index of the first unit left defining one of the names lookups are
+        // waiting for. Each name is only searched for once.
+        size_t pick_unit(const Dwarf::Debug& dbg, const std::vector<PendingUnit>& units, size_t next,
+                         const std::vector<std::string>& wanted, std::unordered_set<std::string>& searched) {
+            for (const std::string& name : wanted) {
+                if (!searched.insert(name).second)
+                    continue;
+
+                for (size_t i = next; i < units.size(); ++i) {
+                    auto die = dbg.offdie(units[i].offset);
+                    if (!die)
+                        continue;
+
+                    NameFinder finder(name);
+                    Dwarf::Die::visitor_to_die to_die;
+                    die->apply_visitor(to_die).visit_headless(finder);
+                    if (finder.found)
+                        return i;
+                }
+            }
+            return next;
+        }
+
+#ifndef INSIGHT_NATIVE_DWARF
+        // libdwarf decompresses whole the sections it reads, without going
+        // through those of the file.
+        void add_compressed_sizes(RegistryImpl& registry, const ElfFile& file) {
+            DebugSection::Statistics sections = file.compressed_sizes();
+            std::lock_guard<std::mutex> guard(registry.statistics_mutex_);
+            registry.statistics_.compressed_bytes += sections.compressed_bytes;
+            registry.statistics_.decompressed_bytes += sections.decompressed_bytes;
+        }
+#endif
+
+    }
+
+    void load(RegistryImpl& registry, std::shared_ptr<const Dwarf::Debug> dbg, uintptr_t bias, const TypeofSites* sites,
+              uint64_t split_id) {
+        registry.bias_ = bias;
+        auto start = std::chrono::steady_clock::now();
+        size_t built = 0;
+
+        // the state of the build is kept while members are left to be built
+        std::shared_ptr<MemberBuilder> builder = std::make_shared<MemberBuilder>(registry, dbg);
+        BuildContext& ctx = builder->ctx;
+        TypeBuilder& tb = builder->tb;
+        ctx.container_stack.push(AnyContainer(registry.root_));
+        if (registry.lazy_members_) {
+            ctx.member_loader = builder;
+            std::lock_guard<std::mutex> guard(registry.statistics_mutex_);
+            registry.member_loaders_.push_back(builder);
+        }
 
-        TypeBuilder tb(ctx);
         DieVisitor visitor(ctx, tb);
 
+        std::vector<PendingUnit> units;
         for (const Dwarf::CompilationUnit &cu : *dbg) {
-            cu.visit_headless(visitor);
+            // type units are built when their types are first referenced
+            UnitOffset unit;
+            cu.visit(unit);
+            if (unit.tag == DW_TAG_type_unit)
+                continue;
+            if (split_id && split_unit_id(cu) != split_id)
+                continue;
+
+            const LoadFilter* filter = registry.filter_.get();
+            if (filter && (!filter->units.empty() || !filter->source_paths.empty())) {
+                UnitFilter unit_filter(*filter);
+                cu.visit(unit_filter);
+                if (!unit_filter.allowed)
+                    continue;
+            }
 
-            process_annotations(ctx);
+            // the contents of split units are only read when first needed,
+            // one at a time from a package
+            SkeletonFinder skeleton(registry.path_);
+            cu.visit(skeleton);
+            if (!skeleton.path.empty()) {
+                SplitUnit split{skeleton.path, skeleton.package ? split_unit_id(cu) : 0};
+                std::lock_guard<std::mutex> guard(registry.pending_mutex_);
+                auto& pending = registry.pending_units_;
+                auto same = [&](const SplitUnit& other) { return other.path == split.path && other.id == split.id; };
+                if (std::find_if(pending.begin(), pending.end(), same) == pending.end())
+                    pending.push_back(split);
+                continue;
+            }
+
+            units.push_back(PendingUnit{unit.offset, !sites || sites->in_unit(unit.offset)});
         }
 
+        // in the background, type_of queries are answered by the units using
+        // typeof, which are built first
+        UnitListener* listener = registry.listener_;
+        if (listener)
+            std::stable_partition(units.begin(), units.end(), [](const PendingUnit& unit) { return unit.infer_types; });
+
+        std::unordered_set<std::string> searched;
+        for (size_t next = 0; next < units.size(); ++next) {
+            if (listener && !listener->begin_unit())
+                break;
+
+            {
+                std::lock_guard<std::recursive_mutex> guard(registry.build_mutex_);
+                ctx.defer_published = listener != nullptr;
+                if (listener) {
+                    size_t index = pick_unit(*dbg, units, next, listener->wanted(), searched);
+                    std::rotate(units.begin() + next, units.begin() + index, units.begin() + index + 1);
+                }
+
+                auto die = dbg->offdie(units[next].offset);
+                if (die) {
+                    Dwarf::Die::visitor_to_die to_die;
+                    Dwarf::Die& unit = die->apply_visitor(to_die);
+                    ctx.infer_types = units[next].infer_types;
+
+                    ScopeFinder scopes(ctx, units[next].offset);
+                    unit.visit_headless(scopes);
+
+                    unit.visit_headless(visitor);
+
+                    // the elements marked by deferred adoptions may be annotated
+                    if (ctx.annotations.empty() && ctx.deferred.empty())
+                        process_annotations(ctx);
+                    else
+                        complete_published(ctx, [&ctx] { process_annotations(ctx); });
+                    ++built;
+                }
+                ctx.defer_published = false;
+            }
+
+            if (listener) {
+                std::function<void()> complete;
+                if (!ctx.deferred.empty()) {
+                    complete = [&] {
+                        std::lock_guard<std::recursive_mutex> guard(registry.build_mutex_);
+                        for (size_t i = 0; i < ctx.deferred.size(); ++i)
+                            ctx.deferred[i]();
+                        ctx.deferred.clear();
+                    };
+                }
+                listener->end_unit(complete);
+            }
+        }
+
+        std::lock_guard<std::mutex> guard(registry.statistics_mutex_);
+        registry.statistics_.units_loaded += built;
+        registry.statistics_.load_time += std::chrono::steady_clock::now() - start;
+    }
+
+    void load_file(RegistryImpl& registry, const std::string& debug_file, uintptr_t bias,
+                   std::shared_ptr<ElfFile> skeleton, uint64_t split_id) {
+        std::shared_ptr<ElfFile> file = std::make_shared<ElfFile>(debug_file);
+        if (!file->valid())
+            throw std::runtime_error("Could not open " + debug_file);
+
+        {
+            std::lock_guard<std::mutex> guard(registry.statistics_mutex_);
+            registry.files_.push_back(file);
+        }
+
+        // the typeof sites are allocated in the binary, separate debug files
+        // only keep the header of their section
+        std::shared_ptr<ElfFile> binary = file;
+        if (!registry.path_.empty() && registry.path_ != debug_file)
+            binary = std::make_shared<ElfFile>(registry.path_);
+        std::unique_ptr<TypeofSites> sites;
+        if (binary->valid())
+            sites = read_typeof_sites(*binary, *file, registry.loaded_ ? &bias : nullptr);
+
+#ifdef INSIGHT_NATIVE_DWARF
+        load(registry, std::make_shared<Dwarf::Debug>(file, skeleton), bias, sites.get(), split_id);
+#else
+        int fd = open(debug_file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw std::runtime_error("Could not open " + debug_file);
+
+        Dwarf::Debug* debug;
+        try {
+            debug = new Dwarf::Debug(fd);
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+
+        // the reader may outlive the loading, to build members on demand
+        std::shared_ptr<Dwarf::Debug> dbg(debug, [fd](Dwarf::Debug* debug) {
+            delete debug;
+            close(fd);
+        });
+        load(registry, dbg, bias, sites.get(), split_id);
+        add_compressed_sizes(registry, *file);
+#endif
+    }
+
+    std::shared_ptr<Registry> load_registry(int fd) {
+        std::shared_ptr<RegistryImpl> registry = std::make_shared<RegistryImpl>("");
+        std::shared_ptr<ElfFile> file = std::make_shared<ElfFile>(fd);
+        std::unique_ptr<TypeofSites> sites;
+        if (file->valid())
+            sites = read_typeof_sites(*file, *file);
+#ifdef INSIGHT_NATIVE_DWARF
+        registry->files_.push_back(file);
+        load(*registry, std::make_shared<Dwarf::Debug>(file), 0, sites.get());
+#else
+        load(*registry, std::make_shared<Dwarf::Debug>(fd), 0, sites.get());
+        if (file->valid())
+            add_compressed_sizes(*registry, *file);
+#endif
+        return registry;
+    }
+
+    std::shared_ptr<Registry> load_registry(const std::string& path) {
+        return load_registry(path, LoadFilter());
     }
-}
 
-static class Init {
-public:
-    Init() { Insight::initialize(); }
-} init;
+    std::shared_ptr<Registry> load_registry(const std::string& path, const LoadFilter& filter) {
+        std::string debug_file = find_debug_file(path);
+
+        std::shared_ptr<RegistryImpl> registry = std::make_shared<RegistryImpl>(path);
+        registry->filter_ = make_filter(filter);
+        load_file(*registry, debug_file.empty() ? path : debug_file);
+        return registry;
+    }
+}
@@ -20,6 +20,7 @@
 #ifndef INSIGHT_DWARF_HH
 # define INSIGHT_DWARF_HH
 
+# include <functional>
 # include <memory>
 # include <unordered_map>
 # include <vector>
@@ -27,9 +28,14 @@
 # include <stack>
 # include <boost/variant.hpp>
 # include <boost/noncopyable.hpp>
-# include <libdwarf++/dwarf.hh>
-# include <libdwarf++/die.hh>
-# include <libdwarf++/cu.hh>
+# ifdef INSIGHT_NATIVE_DWARF
+#  include "native/reader.hh"
+namespace Dwarf = Insight::Native;
+# else
+#  include <libdwarf++/dwarf.hh>
+#  include <libdwarf++/die.hh>
+#  include <libdwarf++/cu.hh>
+# endif
 # include "insight/insight"
 # include "data/internal.hh"
 # include "core/core.hh"
@@ -73,9 +79,10 @@ namespace Insight {
     using AddressOffsetMap = OffsetMap<void*>;
 
     struct BuildContext : public boost::noncopyable {
-        BuildContext(const Dwarf::Debug& d);
+        BuildContext(const Dwarf::Debug& d, RegistryImpl& r);
 
         const Dwarf::Debug& dbg;
+        RegistryImpl& registry;
         TypeOffsetMap types;
         MethodOffsetMap methods;
         AddressOffsetMap method_addresses;
@@ -83,25 +90,85 @@ namespace Insight {
         std::stack<AnyContainer> container_stack;
         std::map<size_t, std::shared_ptr<AnnotationInfoImpl>> annotations;
         std::map<size_t, AnyAnnotated> annotated;
+        bool infer_types;   // whether the functions of the unit use typeof
+
+        // scopes of the named types of the unit, see ScopeFinder
+        std::vector<std::string> scope_names;
+        std::unordered_map<Dwarf::Off, uint32_t> scopes;
+
+        // set when the members of structures are built on first access
+        std::weak_ptr<MemberLoader> member_loader;
+
+        // changes to elements of earlier units, see complete_published
+        bool defer_published;
+        std::vector<std::function<void()>> deferred;
+    };
+
+    // Changes an element that may already be published. In the background,
+    // the change is deferred until the unit is published, under the
+    // exclusive lock of the shared metadata.
+    void complete_published(BuildContext& ctx, std::function<void()> change);
+
+    struct TypeofSites;
+
+    // How much of a namespace is read, given its full name.
+    enum class NamespaceFilter {
+        READ,
+        TRAVERSE,   // only its nested namespaces, some of which are read
+        SKIP,
     };
 
+    NamespaceFilter filter_namespace(const LoadFilter& filter, const std::string& fullname);
+
+    // The filter of a registry, its namespaces qualified from the root.
+    std::shared_ptr<const LoadFilter> make_filter(LoadFilter filter);
+
     CONTAINER_VISITOR(TypeInfo, add_type, info->add_type(ptr));
     CONTAINER_VISITOR(FunctionInfo, add_function, info->add_function(ptr));
     CONTAINER_VISITOR(VariableInfo, add_variable, info->add_variable(ptr));
 
+    // Builds the metadata of a binary loaded at the given bias into a registry.
+    // Without typeof sites, every function is searched for typeof dummies.
+    // Given a DWO id, only the split unit with that id is built.
+    void load(RegistryImpl& registry, std::shared_ptr<const Dwarf::Debug> dbg, uintptr_t bias = 0,
+              const TypeofSites* sites = nullptr, uint64_t split_id = 0);
+
+    // Reads a debug file with the configured DWARF reader, and keeps it in
+    // the files of the registry. Split units are read with the file holding
+    // their skeletons.
+    void load_file(RegistryImpl& registry, const std::string& debug_file, uintptr_t bias = 0,
+                   std::shared_ptr<ElfFile> skeleton = nullptr, uint64_t split_id = 0);
+
     size_t get_offset(Dwarf::Die &die);
     std::shared_ptr<Container> get_parent(BuildContext& ctx);
 
+    // Sets the link-time address of an element, relocated by the load bias of
+    // the binary when it is read.
+    template <typename T>
+    inline void set_address(BuildContext& ctx, T& element, Dwarf::Addr addr) {
+        element.address_ = reinterpret_cast<void*>(addr);
+        element.bias_ = &ctx.registry.bias_;
+    }
+
+    // Members of namespaces are recorded in the additions of the registry.
+    inline void added_to_parent(BuildContext& ctx, std::shared_ptr<Named> ptr) {
+        if (auto* ns = boost::get<std::shared_ptr<NamespaceInfoImpl>>(&ctx.container_stack.top()))
+            ctx.registry.added_member(*ns, std::move(ptr));
+    }
+
     inline void add_type_to_parent(BuildContext& ctx, std::shared_ptr<TypeInfo> ptr) {
         boost::apply_visitor(add_type(ptr), ctx.container_stack.top());
+        added_to_parent(ctx, ptr);
     }
 
     inline void add_func_to_parent(BuildContext& ctx, std::shared_ptr<FunctionInfo> ptr) {
         boost::apply_visitor(add_function(ptr), ctx.container_stack.top());
+        added_to_parent(ctx, ptr);
     }
 
     inline void add_var_to_parent(BuildContext& ctx, std::shared_ptr<VariableInfo> ptr) {
         boost::apply_visitor(add_variable(ptr), ctx.container_stack.top());
+        added_to_parent(ctx, ptr);
     }
 
 }
@@ -23,7 +23,7 @@
 namespace Insight {
 
     Result EnumBuilder::operator()(Dwarf::TaggedDie<DW_TAG_enumerator> &die) {
-        std::unique_ptr<const Dwarf::Attribute> constattr = die.get_attribute(DW_AT_const_value);
+        auto constattr = die.get_attribute(DW_AT_const_value);
         if (!constattr || !die.get_name())
             return Result::SKIP;
 
@@ -38,7 +38,7 @@ namespace Insight {
                 // we leak the block because we need it alive until the program ends
                 addr = std::malloc(block->bl_len);
                 std::memcpy(addr, block->bl_data, block->bl_len);
-                std::shared_ptr<const Dwarf::Debug> dbg = die.get_debug();
+                auto dbg = die.get_debug();
                 if (dbg)
                     dbg->dealloc(block);
             } break;
@@ -83,7 +83,7 @@ namespace Insight {
     {}
 
     std::shared_ptr<TypeInfo> build_enum_type(Dwarf::Die &die, TypeBuilder& tb, bool register_parent) {
-        std::unique_ptr<const Dwarf::Attribute> attrsize = die.get_attribute(DW_AT_byte_size);
+        auto attrsize = die.get_attribute(DW_AT_byte_size);
         size_t size = !attrsize ? 0 : attrsize->as<Dwarf::Off>();
 
         std::shared_ptr<Container> parent = get_parent(tb.ctx);
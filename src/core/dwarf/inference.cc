@@ -17,30 +17,223 @@
  * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
  *
  */
+#include <algorithm>
+#include <cstring>
+#include <string>
 #include "inference.hh"
 
 namespace Insight {
 
+    namespace {
+
+        template <typename T>
+        bool read(const char*& p, const char* end, T& value) {
+            if (static_cast<size_t>(end - p) < sizeof (T))
+                return false;
+            std::memcpy(&value, p, sizeof (T));
+            p += sizeof (T);
+            return true;
+        }
+
+        // Offsets take 8 bytes in 64-bit DWARF, and 4 otherwise.
+        bool read_offset(const char*& p, const char* end, bool dwarf64, uint64_t& value) {
+            if (dwarf64)
+                return read(p, end, value);
+            uint32_t value32;
+            if (!read(p, end, value32))
+                return false;
+            value = value32;
+            return true;
+        }
+
+        // Adds the units of .debug_aranges covering the addresses, and
+        // returns whether they cover all of them.
+        bool find_units(DebugSection& aranges, const std::vector<uintptr_t>& addresses,
+                        std::vector<Dwarf::Off>& units) {
+            std::vector<bool> covered(addresses.size());
+            const char* start = aranges.data(aranges.size());
+            const char* end = start + aranges.size();
+            const char* p = start;
+            while (p < end) {
+                const char* set = p;
+                uint32_t length32;
+                if (!read(p, end, length32))
+                    break;
+                bool dwarf64 = length32 == 0xffffffff;
+                uint64_t length = length32;
+                if ((dwarf64 && !read(p, end, length)) || length > static_cast<uint64_t>(end - p))
+                    break;
+                const char* next = p + length;
+
+                uint16_t version;
+                uint64_t offset;
+                uint8_t address_size, segment_size;
+                if (!read(p, next, version) || !read_offset(p, next, dwarf64, offset)
+                        || !read(p, next, address_size) || !read(p, next, segment_size))
+                    break;
+
+                // only host-sized addresses, without segments, are supported
+                if (address_size == sizeof (uintptr_t) && !segment_size) {
+                    size_t tuple = 2 * address_size;
+                    p = set + (p - set + tuple - 1) / tuple * tuple;
+                    uintptr_t address, size;
+                    bool used = false;
+                    while (read(p, next, address) && read(p, next, size) && (address || size)) {
+                        auto it = std::lower_bound(addresses.begin(), addresses.end(), address);
+                        for (; it != addresses.end() && *it - address < size; ++it) {
+                            covered[it - addresses.begin()] = true;
+                            used = true;
+                        }
+                    }
+                    if (used)
+                        units.push_back(offset);
+                }
+                p = next;
+            }
+            return std::find(covered.begin(), covered.end(), false) == covered.end();
+        }
+
+        struct LoadedRecords {
+            uintptr_t bias;
+            uintptr_t address;
+            size_t size;
+            std::string data;
+            bool found;
+        };
+
+        // Copies the records from the object loaded at the bias, which the
+        // loader cannot unload meanwhile.
+        int copy_records(struct dl_phdr_info* info, [[gnu::unused]] size_t size, void* data) {
+            auto& records = *static_cast<LoadedRecords*>(data);
+            if (info->dlpi_addr != records.bias)
+                return 0;
+            for (ElfW(Half) i = 0; i < info->dlpi_phnum; ++i) {
+                const ElfW(Phdr)& phdr = info->dlpi_phdr[i];
+                uintptr_t start = info->dlpi_addr + phdr.p_vaddr;
+                if (phdr.p_type == PT_LOAD && start <= records.address
+                        && records.address + records.size <= start + phdr.p_memsz) {
+                    records.data.assign(reinterpret_cast<const char*>(records.address), records.size);
+                    records.found = true;
+                    return 1;
+                }
+            }
+            return 0;
+        }
+
+        // Offset of the DIE of the unit whose header is at an offset of
+        // .debug_info, or zero if the header cannot be read.
+        Dwarf::Off unit_die_offset(DebugSection& info, Dwarf::Off offset) {
+            // the longest unit header, of 64-bit DWARF 5 type units
+            const size_t max_header = 40;
+            if (offset >= info.size())
+                return 0;
+            size_t available = std::min<size_t>(info.size(), offset + max_header);
+            const char* start = info.data(available);
+            const char* end = start + available;
+            const char* p = start + offset;
+
+            uint32_t length32;
+            uint64_t length, abbrev, id;
+            uint16_t version;
+            uint8_t unit_type = DW_UT_compile, address_size;
+            if (!read(p, end, length32) || (length32 >= 0xfffffff0 && length32 != 0xffffffff))
+                return 0;
+            bool dwarf64 = length32 == 0xffffffff;
+            if ((dwarf64 && !read(p, end, length)) || !read(p, end, version))
+                return 0;
+            if (version >= 5) {
+                if (!read(p, end, unit_type) || !read(p, end, address_size) || !read_offset(p, end, dwarf64, abbrev))
+                    return 0;
+                if ((unit_type == DW_UT_skeleton || unit_type == DW_UT_split_compile) && !read(p, end, id))
+                    return 0;
+            } else if (!read_offset(p, end, dwarf64, abbrev) || !read(p, end, address_size)) {
+                return 0;
+            }
+            return p - start;
+        }
+
+    }
+
+    bool TypeofSites::in_unit(Dwarf::Off die_offset) const {
+        return all_units || units.count(die_offset);
+    }
+
+    std::unique_ptr<TypeofSites> read_typeof_sites(const ElfFile& binary, const ElfFile& debug,
+                                                   const uintptr_t* loaded_bias) {
+        ElfFile::Section section;
+        if (!binary.section("insight_typeof", section) || section.type == SHT_NOBITS)
+            return nullptr;
+
+        std::unique_ptr<TypeofSites> sites(new TypeofSites());
+        sites->all_units = false;
+
+        // pairs of the address of a dummy and of the code using it, which
+        // the file only holds when the linker applied the addends of their
+        // relocations
+        const char* p = section.data;
+        uintptr_t bias = loaded_bias ? *loaded_bias : 0;
+        LoadedRecords records{bias, section.addr + bias, section.size, std::string(), false};
+        if (loaded_bias) {
+            dl_iterate_phdr(copy_records, &records);
+            if (!records.found) {
+                sites->all_units = true;
+                return sites;
+            }
+            p = records.data.data();
+        }
+        const char* end = p + section.size;
+
+        std::vector<uintptr_t> code;
+        uintptr_t dummy, pc;
+        while (read(p, end, dummy) && read(p, end, pc)) {
+            if (!dummy || !pc) {
+                sites->all_units = true;
+                return sites;
+            }
+            code.push_back(pc - bias);
+        }
+        std::sort(code.begin(), code.end());
+
+        std::shared_ptr<DebugSection> aranges = debug.debug_section(".debug_aranges");
+        std::shared_ptr<DebugSection> info = debug.debug_section(".debug_info");
+        std::vector<Dwarf::Off> units;
+        if (!aranges || !info || !find_units(*aranges, code, units)) {
+            sites->all_units = true;
+            return sites;
+        }
+        for (Dwarf::Off unit : units) {
+            Dwarf::Off die = unit_die_offset(*info, unit);
+            if (!die) {
+                sites->all_units = true;
+                break;
+            }
+            sites->units.insert(die);
+        }
+        return sites;
+    }
+
     Result TypeInferer::operator()(Dwarf::TaggedDie<DW_TAG_variable>& die) {
         const char *name = die.get_name();
         if (!name)
             return Result::SKIP;
 
-        if (std::string(name) != "insight_typeof_dummy")
+        if (std::strcmp(name, "insight_typeof_dummy"))
             return Result::SKIP;
 
         auto type = tb.get_type_attr(die);
         if (!type)
             return Result::SKIP;
 
-        std::unique_ptr<const Dwarf::Attribute> locattr = die.get_attribute(DW_AT_location);
+        auto locattr = die.get_attribute(DW_AT_location);
         if (!locattr)
             return Result::SKIP;
 
         size_t loc = locattr->as<Dwarf::Off>();
 
         auto inferred_type = std::dynamic_pointer_cast<PointerTypeInfoImpl>(type);
-        inferred_type_registry[loc] = inferred_type->type_.lock();
+        // typeof lookups use the runtime address of the dummy variable
+        tb.ctx.registry.inferred_types_[loc + tb.ctx.registry.bias_] = inferred_type->type_.lock();
+        tb.ctx.registry.added_inferred_type(loc + tb.ctx.registry.bias_);
 
         return Result::SKIP;
     }
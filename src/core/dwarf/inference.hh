@@ -20,11 +20,43 @@
 #ifndef INSIGHT_INFERENCE_HH
 # define INSIGHT_INFERENCE_HH
 
+# include <unordered_set>
 # include "dwarf.hh"
 # include "type.hh"
+# include "util/elf.hh"
 
 namespace Insight {
 
+    // The units holding the code that uses the typeof dummies recorded in the
+    // insight_typeof section of a binary.
+    struct TypeofSites {
+        // Whether the unit whose DIE is at an offset defines typeof dummies.
+        bool in_unit(Dwarf::Off die_offset) const;
+
+        std::unordered_set<Dwarf::Off> units;   // offsets of their unit DIEs
+        bool all_units;     // some sites could not be found in the units
+    };
+
+    // Null for binaries that do not record their typeof dummies. The records
+    // of a binary loaded in the current process are read from memory, given
+    // its load bias, as linkers may leave them to the dynamic relocations.
+    std::unique_ptr<TypeofSites> read_typeof_sites(const ElfFile& binary, const ElfFile& debug,
+                                                   const uintptr_t* loaded_bias = nullptr);
+
+    // Finds the offset and the tag of the DIE of a unit.
+    struct UnitOffset : public Dwarf::DefaultDieVisitor {
+
+        template <typename T>
+        Result operator()(T& die) {
+            offset = die.get_offset();
+            tag = die.get_tag().get_id();
+            return Result::BREAK;
+        }
+
+        Dwarf::Off offset = 0;
+        int tag = 0;
+    };
+
     struct TypeInferer : public Dwarf::DefaultDieVisitor {
 
         Result operator()(Dwarf::TaggedDie<DW_TAG_variable>& die);
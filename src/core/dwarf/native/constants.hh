@@ -0,0 +1,155 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef INSIGHT_NATIVE_CONSTANTS_HH
+# define INSIGHT_NATIVE_CONSTANTS_HH
+
+// The DWARF constants used by Insight, under the names of libdwarf's
+// <dwarf.h>, for builds that do not depend on it.
+# ifndef DW_TAG_array_type
+#  define DW_TAG_array_type                 0x01
+#  define DW_TAG_class_type                 0x02
+#  define DW_TAG_enumeration_type           0x04
+#  define DW_TAG_formal_parameter           0x05
+#  define DW_TAG_lexical_block              0x0b
+#  define DW_TAG_member                     0x0d
+#  define DW_TAG_pointer_type               0x0f
+#  define DW_TAG_reference_type             0x10
+#  define DW_TAG_compile_unit               0x11
+#  define DW_TAG_structure_type             0x13
+#  define DW_TAG_subroutine_type            0x15
+#  define DW_TAG_typedef                    0x16
+#  define DW_TAG_union_type                 0x17
+#  define DW_TAG_inheritance                0x1c
+#  define DW_TAG_subrange_type              0x21
+#  define DW_TAG_base_type                  0x24
+#  define DW_TAG_const_type                 0x26
+#  define DW_TAG_enumerator                 0x28
+#  define DW_TAG_subprogram                 0x2e
+#  define DW_TAG_variable                   0x34
+#  define DW_TAG_volatile_type              0x35
+#  define DW_TAG_namespace                  0x39
+#  define DW_TAG_unspecified_type           0x3b
+#  define DW_TAG_partial_unit               0x3c
+#  define DW_TAG_type_unit                  0x41
+#  define DW_TAG_rvalue_reference_type      0x42
+#  define DW_TAG_skeleton_unit              0x4a
+
+#  define DW_AT_sibling                     0x01
+#  define DW_AT_location                    0x02
+#  define DW_AT_name                        0x03
+#  define DW_AT_byte_size                   0x0b
+#  define DW_AT_bit_size                    0x0d
+#  define DW_AT_low_pc                      0x11
+#  define DW_AT_high_pc                     0x12
+#  define DW_AT_comp_dir                    0x1b
+#  define DW_AT_const_value                 0x1c
+#  define DW_AT_upper_bound                 0x2f
+#  define DW_AT_artificial                  0x34
+#  define DW_AT_count                       0x37
+#  define DW_AT_data_member_location        0x38
+#  define DW_AT_decl_file                   0x3a
+#  define DW_AT_decl_line                   0x3b
+#  define DW_AT_declaration                 0x3c
+#  define DW_AT_encoding                    0x3e
+#  define DW_AT_external                    0x3f
+#  define DW_AT_specification               0x47
+#  define DW_AT_type                        0x49
+#  define DW_AT_virtuality                  0x4c
+#  define DW_AT_vtable_elem_location        0x4d
+#  define DW_AT_signature                   0x69
+#  define DW_AT_data_bit_offset             0x6b
+#  define DW_AT_linkage_name                0x6e
+#  define DW_AT_str_offsets_base            0x72
+#  define DW_AT_addr_base                   0x73
+#  define DW_AT_dwo_name                    0x76
+#  define DW_AT_alignment                   0x88
+#  define DW_AT_GNU_dwo_name                0x2130
+#  define DW_AT_GNU_dwo_id                  0x2131
+#  define DW_AT_GNU_addr_base               0x2133
+
+#  define DW_FORM_addr                      0x01
+#  define DW_FORM_block2                    0x03
+#  define DW_FORM_block4                    0x04
+#  define DW_FORM_data2                     0x05
+#  define DW_FORM_data4                     0x06
+#  define DW_FORM_data8                     0x07
+#  define DW_FORM_string                    0x08
+#  define DW_FORM_block                     0x09
+#  define DW_FORM_block1                    0x0a
+#  define DW_FORM_data1                     0x0b
+#  define DW_FORM_flag                      0x0c
+#  define DW_FORM_sdata                     0x0d
+#  define DW_FORM_strp                      0x0e
+#  define DW_FORM_udata                     0x0f
+#  define DW_FORM_ref_addr                  0x10
+#  define DW_FORM_ref1                      0x11
+#  define DW_FORM_ref2                      0x12
+#  define DW_FORM_ref4                      0x13
+#  define DW_FORM_ref8                      0x14
+#  define DW_FORM_ref_udata                 0x15
+#  define DW_FORM_indirect                  0x16
+#  define DW_FORM_sec_offset                0x17
+#  define DW_FORM_exprloc                   0x18
+#  define DW_FORM_flag_present              0x19
+#  define DW_FORM_strx                      0x1a
+#  define DW_FORM_addrx                     0x1b
+#  define DW_FORM_ref_sup4                  0x1c
+#  define DW_FORM_strp_sup                  0x1d
+#  define DW_FORM_data16                    0x1e
+#  define DW_FORM_line_strp                 0x1f
+#  define DW_FORM_ref_sig8                  0x20
+#  define DW_FORM_implicit_const            0x21
+#  define DW_FORM_loclistx                  0x22
+#  define DW_FORM_rnglistx                  0x23
+#  define DW_FORM_ref_sup8                  0x24
+#  define DW_FORM_strx1                     0x25
+#  define DW_FORM_strx2                     0x26
+#  define DW_FORM_strx3                     0x27
+#  define DW_FORM_strx4                     0x28
+#  define DW_FORM_addrx1                    0x29
+#  define DW_FORM_addrx2                    0x2a
+#  define DW_FORM_addrx3                    0x2b
+#  define DW_FORM_addrx4                    0x2c
+#  define DW_FORM_GNU_addr_index            0x1f01
+#  define DW_FORM_GNU_str_index             0x1f02
+#  define DW_FORM_GNU_ref_alt               0x1f20
+#  define DW_FORM_GNU_strp_alt              0x1f21
+
+#  define DW_OP_addr                        0x03
+#  define DW_OP_constu                      0x10
+#  define DW_OP_plus_uconst                 0x23
+#  define DW_OP_addrx                       0xa1
+#  define DW_OP_GNU_addr_index              0xfb
+
+#  define DW_UT_compile                     0x01
+#  define DW_UT_type                        0x02
+#  define DW_UT_partial                     0x03
+#  define DW_UT_skeleton                    0x04
+#  define DW_UT_split_compile               0x05
+#  define DW_UT_split_type                  0x06
+
+#  define DW_SECT_INFO                      1
+#  define DW_SECT_ABBREV                    3
+#  define DW_SECT_STR_OFFSETS               6
+
+#  define DW_VIRTUALITY_none                0
+# endif
+
+#endif /* !INSIGHT_NATIVE_CONSTANTS_HH */
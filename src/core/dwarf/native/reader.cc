@@ -0,0 +1,938 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "reader.hh"
+
+namespace Insight {
+
+    namespace Native {
+
+        namespace {
+
+            struct Cursor {
+                const char* p;
+                const char* end;
+
+                void need(size_t size) {
+                    if (static_cast<size_t>(end - p) < size)
+                        throw std::runtime_error("Truncated DWARF data");
+                }
+
+                template <typename T>
+                T read() {
+                    need(sizeof (T));
+                    T value;
+                    std::memcpy(&value, p, sizeof (value));
+                    p += sizeof (value);
+                    return value;
+                }
+
+                Unsigned read_sized(size_t size) {
+                    switch (size) {
+                        case 1: return read<uint8_t>();
+                        case 2: return read<uint16_t>();
+                        case 4: return read<uint32_t>();
+                        case 8: return read<uint64_t>();
+                        case 3: {
+                            need(3);
+                            const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+                            p += 3;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                            return (Unsigned(b[0]) << 16) | (Unsigned(b[1]) << 8) | b[2];
+#else
+                            return (Unsigned(b[2]) << 16) | (Unsigned(b[1]) << 8) | b[0];
+#endif
+                        }
+                        default: throw std::runtime_error("Unsupported DWARF value size");
+                    }
+                }
+
+                Unsigned uleb() {
+                    Unsigned value = 0;
+                    unsigned shift = 0;
+                    for (;;) {
+                        need(1);
+                        unsigned char byte = *p++;
+                        if (shift < 64)
+                            value |= Unsigned(byte & 0x7f) << shift;
+                        shift += 7;
+                        if (!(byte & 0x80))
+                            return value;
+                    }
+                }
+
+                Signed sleb() {
+                    Unsigned value = 0;
+                    unsigned shift = 0;
+                    unsigned char byte;
+                    do {
+                        need(1);
+                        byte = *p++;
+                        if (shift < 64)
+                            value |= Unsigned(byte & 0x7f) << shift;
+                        shift += 7;
+                    } while (byte & 0x80);
+                    if (shift < 64 && (byte & 0x40))
+                        value |= ~Unsigned(0) << shift;
+                    return static_cast<Signed>(value);
+                }
+
+                void skip(size_t size) {
+                    need(size);
+                    p += size;
+                }
+
+                void skip_string() {
+                    const void* nul = std::memchr(p, 0, end - p);
+                    if (!nul)
+                        throw std::runtime_error("Truncated DWARF string");
+                    p = static_cast<const char*>(nul) + 1;
+                }
+            };
+
+            // Size of the forms that do not depend on the unit header.
+            size_t constant_size(Half form) {
+                switch (form) {
+                    case DW_FORM_flag_present:
+                    case DW_FORM_implicit_const:
+                        return 0;
+                    case DW_FORM_data1: case DW_FORM_ref1: case DW_FORM_flag:
+                    case DW_FORM_strx1: case DW_FORM_addrx1:
+                        return 1;
+                    case DW_FORM_data2: case DW_FORM_ref2:
+                    case DW_FORM_strx2: case DW_FORM_addrx2:
+                        return 2;
+                    case DW_FORM_strx3: case DW_FORM_addrx3:
+                        return 3;
+                    case DW_FORM_data4: case DW_FORM_ref4: case DW_FORM_ref_sup4:
+                    case DW_FORM_strx4: case DW_FORM_addrx4:
+                        return 4;
+                    case DW_FORM_data8: case DW_FORM_ref8: case DW_FORM_ref_sig8: case DW_FORM_ref_sup8:
+                        return 8;
+                    case DW_FORM_data16:
+                        return 16;
+                    default:
+                        return static_cast<size_t>(-1);
+                }
+            }
+
+            size_t fixed_size(Half form, const CompilationUnit& unit) {
+                switch (form) {
+                    case DW_FORM_addr:
+                        return unit.address_size_;
+                    case DW_FORM_ref_addr:
+                        return unit.version_ <= 2 ? unit.address_size_ : unit.offset_size_;
+                    case DW_FORM_strp: case DW_FORM_sec_offset: case DW_FORM_line_strp:
+                    case DW_FORM_strp_sup: case DW_FORM_GNU_ref_alt: case DW_FORM_GNU_strp_alt:
+                        return unit.offset_size_;
+                    default:
+                        return constant_size(form);
+                }
+            }
+
+            // Adds the size of a form to a layout, unless its size depends on
+            // the data or on the version of the unit.
+            bool extend_layout(AttributeLayout& layout, Half form) {
+                switch (form) {
+                    case DW_FORM_addr:
+                        ++layout.addresses;
+                        return true;
+                    case DW_FORM_strp: case DW_FORM_sec_offset: case DW_FORM_line_strp:
+                    case DW_FORM_strp_sup: case DW_FORM_GNU_ref_alt: case DW_FORM_GNU_strp_alt:
+                        ++layout.offsets;
+                        return true;
+                    default:
+                        break;
+                }
+                size_t size = constant_size(form);
+                if (size == static_cast<size_t>(-1))
+                    return false;
+                layout.bytes += static_cast<uint32_t>(size);
+                return true;
+            }
+
+            const char* locate(const char* attributes, const AttributeLayout& layout, const CompilationUnit& unit) {
+                size_t offset = layout.bytes + layout.addresses * unit.address_size_
+                        + layout.offsets * unit.offset_size_;
+                if (offset > static_cast<size_t>(unit.end() - attributes))
+                    throw std::runtime_error("Truncated DWARF entry");
+                return attributes + offset;
+            }
+
+            void skip_form(Cursor& c, Half form, const CompilationUnit& unit) {
+                size_t size = fixed_size(form, unit);
+                if (size != static_cast<size_t>(-1)) {
+                    c.skip(size);
+                    return;
+                }
+
+                switch (form) {
+                    case DW_FORM_string:
+                        c.skip_string();
+                        break;
+                    case DW_FORM_block1:
+                        c.skip(c.read<uint8_t>());
+                        break;
+                    case DW_FORM_block2:
+                        c.skip(c.read<uint16_t>());
+                        break;
+                    case DW_FORM_block4:
+                        c.skip(c.read<uint32_t>());
+                        break;
+                    case DW_FORM_block:
+                    case DW_FORM_exprloc:
+                        c.skip(c.uleb());
+                        break;
+                    case DW_FORM_sdata:
+                        c.sleb();
+                        break;
+                    case DW_FORM_udata: case DW_FORM_ref_udata:
+                    case DW_FORM_strx: case DW_FORM_addrx:
+                    case DW_FORM_loclistx: case DW_FORM_rnglistx:
+                    case DW_FORM_GNU_addr_index: case DW_FORM_GNU_str_index:
+                        c.uleb();
+                        break;
+                    case DW_FORM_indirect:
+                        skip_form(c, static_cast<Half>(c.uleb()), unit);
+                        break;
+                    default:
+                        throw std::runtime_error("Unknown DWARF form " + std::to_string(form));
+                }
+            }
+
+            bool is_reference(Half form) {
+                switch (form) {
+                    case DW_FORM_ref1: case DW_FORM_ref2: case DW_FORM_ref4:
+                    case DW_FORM_ref8: case DW_FORM_ref_udata: case DW_FORM_ref_addr:
+                        return true;
+                    default:
+                        return false;
+                }
+            }
+
+            bool is_block(Half form) {
+                switch (form) {
+                    case DW_FORM_block1: case DW_FORM_block2: case DW_FORM_block4:
+                    case DW_FORM_block: case DW_FORM_exprloc:
+                        return true;
+                    default:
+                        return false;
+                }
+            }
+
+            Block read_block(Cursor& c, Half form) {
+                Unsigned size;
+                switch (form) {
+                    case DW_FORM_block1: size = c.read<uint8_t>(); break;
+                    case DW_FORM_block2: size = c.read<uint16_t>(); break;
+                    case DW_FORM_block4: size = c.read<uint32_t>(); break;
+                    default:             size = c.uleb(); break;
+                }
+                c.need(size);
+                return Block{size, const_cast<char*>(c.p)};
+            }
+
+        }
+
+        const Abbreviation* AbbreviationTable::find(Unsigned code) const {
+            if (code < dense_.size()) {
+                const Abbreviation& abbreviation = dense_[code];
+                return abbreviation.tag ? &abbreviation : nullptr;
+            }
+            auto it = sparse_.find(code);
+            return it != sparse_.end() ? &it->second : nullptr;
+        }
+
+        Attribute::Attribute()
+            : unit_(nullptr)
+            , form_(0)
+            , data_(nullptr)
+            , implicit_const_(0)
+            , value_(0)
+            , block_{0, nullptr}
+        {}
+
+        Attribute::Attribute(const CompilationUnit* unit, Half form, const char* data, Signed implicit_const)
+            : unit_(unit)
+            , form_(form)
+            , data_(data)
+            , implicit_const_(implicit_const)
+            , value_(0)
+            , block_{0, nullptr}
+        {}
+
+        Unsigned Attribute::read_address(Unsigned index) const {
+            const Debug& debug = *unit_->debug_;
+            if (!debug.addr_)
+                return 0;
+
+            Off offset = unit_->addr_base_ + index * unit_->address_size_;
+            if (offset + unit_->address_size_ > debug.addr_->size())
+                return 0;
+
+            const char* data = debug.addr_->data(offset + unit_->address_size_);
+            Cursor c{data + offset, data + offset + unit_->address_size_};
+            return c.read_sized(unit_->address_size_);
+        }
+
+        template <>
+        Unsigned Attribute::as<Unsigned>() const {
+            Cursor c{data_, unit_->end()};
+            switch (form_) {
+                case DW_FORM_implicit_const:
+                    return implicit_const_;
+                case DW_FORM_flag_present:
+                    return 1;
+                case DW_FORM_sdata:
+                    return c.sleb();
+                case DW_FORM_udata: case DW_FORM_strx:
+                case DW_FORM_loclistx: case DW_FORM_rnglistx:
+                case DW_FORM_GNU_str_index:
+                    return c.uleb();
+                case DW_FORM_ref_udata:
+                    return unit_->offset_ + c.uleb();
+                case DW_FORM_addrx: case DW_FORM_GNU_addr_index:
+                    return read_address(c.uleb());
+                case DW_FORM_addrx1: case DW_FORM_addrx2: case DW_FORM_addrx3: case DW_FORM_addrx4:
+                    return read_address(c.read_sized(fixed_size(form_, *unit_)));
+                case DW_FORM_ref1: case DW_FORM_ref2: case DW_FORM_ref4: case DW_FORM_ref8:
+                    return unit_->offset_ + c.read_sized(fixed_size(form_, *unit_));
+                case DW_FORM_block1: case DW_FORM_block2: case DW_FORM_block4:
+                case DW_FORM_block: case DW_FORM_exprloc: {
+                    // location expressions made of a single operation
+                    Block block = read_block(c, form_);
+                    Cursor expr{static_cast<const char*>(block.bl_data),
+                                static_cast<const char*>(block.bl_data) + block.bl_len};
+                    if (!block.bl_len)
+                        return 0;
+                    switch (expr.read<uint8_t>()) {
+                        case DW_OP_addr:
+                            return expr.read_sized(unit_->address_size_);
+                        case DW_OP_addrx:
+                        case DW_OP_GNU_addr_index:
+                            return read_address(expr.uleb());
+                        case DW_OP_constu:
+                        case DW_OP_plus_uconst:
+                            return expr.uleb();
+                        default:
+                            return 0;
+                    }
+                }
+                default: {
+                    size_t size = fixed_size(form_, *unit_);
+                    if (size == static_cast<size_t>(-1) || size > 8)
+                        return 0;
+                    return c.read_sized(size);
+                }
+            }
+        }
+
+        template <>
+        Signed Attribute::as<Signed>() const {
+            Cursor c{data_, unit_->end()};
+            switch (form_) {
+                case DW_FORM_data1: return c.read<int8_t>();
+                case DW_FORM_data2: return c.read<int16_t>();
+                case DW_FORM_data4: return c.read<int32_t>();
+                case DW_FORM_data8: return c.read<int64_t>();
+                default:            return static_cast<Signed>(as<Unsigned>());
+            }
+        }
+
+        template <>
+        const char* Attribute::as<const char*>() const {
+            const Debug& debug = *unit_->debug_;
+            Cursor c{data_, unit_->end()};
+
+            Off offset;
+            const std::shared_ptr<DebugSection>* section = &debug.str_;
+            switch (form_) {
+                case DW_FORM_string:
+                    return data_;
+                case DW_FORM_strp:
+                    offset = c.read_sized(unit_->offset_size_);
+                    break;
+                case DW_FORM_line_strp:
+                    offset = c.read_sized(unit_->offset_size_);
+                    section = &debug.line_str_;
+                    break;
+                case DW_FORM_strx: case DW_FORM_GNU_str_index:
+                case DW_FORM_strx1: case DW_FORM_strx2: case DW_FORM_strx3: case DW_FORM_strx4: {
+                    Unsigned index = (form_ == DW_FORM_strx || form_ == DW_FORM_GNU_str_index)
+                        ? c.uleb() : c.read_sized(fixed_size(form_, *unit_));
+                    if (!debug.str_offsets_)
+                        return nullptr;
+                    Off entry = unit_->str_offsets_base_ + index * unit_->offset_size_;
+                    if (entry + unit_->offset_size_ > debug.str_offsets_->size())
+                        return nullptr;
+                    const char* offsets = debug.str_offsets_->data(entry + unit_->offset_size_);
+                    Cursor o{offsets + entry, offsets + entry + unit_->offset_size_};
+                    offset = o.read_sized(unit_->offset_size_);
+                } break;
+                default:
+                    // strings in supplementary files are not supported
+                    return nullptr;
+            }
+
+            if (!*section || offset >= (*section)->size())
+                return nullptr;
+            return (*section)->data() + offset;
+        }
+
+        template <>
+        Block* Attribute::as<Block*>() const {
+            Cursor c{data_, unit_->end()};
+            if (is_block(form_)) {
+                block_ = read_block(c, form_);
+                return &block_;
+            }
+
+            size_t size = fixed_size(form_, *unit_);
+            if (size != static_cast<size_t>(-1) && size > 0 && form_ != DW_FORM_addr && !is_reference(form_)) {
+                c.need(size);
+                block_ = Block{size, const_cast<char*>(data_)};
+                return &block_;
+            }
+
+            if (form_ == DW_FORM_udata || form_ == DW_FORM_sdata || form_ == DW_FORM_implicit_const) {
+                value_ = as<Unsigned>();
+                block_ = Block{sizeof (value_), &value_};
+                return &block_;
+            }
+            return nullptr;
+        }
+
+        boost::optional<AnyDie> Attribute::as_die() const {
+            if (form_ == DW_FORM_ref_sig8) {
+                const Debug& debug = *unit_->debug_;
+                const CompilationUnit* unit = debug.type_unit(Cursor{data_, unit_->end()}.read<uint64_t>());
+                return unit ? debug.offdie(unit->offset_ + unit->type_offset_) : boost::none;
+            }
+
+            if (!is_reference(form_))
+                return boost::none;
+
+            Off offset = form_ == DW_FORM_ref_addr
+                ? Cursor{data_, unit_->end()}.read_sized(fixed_size(form_, *unit_))
+                : as<Unsigned>();
+            return unit_->debug_->offdie(offset);
+        }
+
+        Die::Die(const CompilationUnit* unit, const char* data)
+            : unit_(unit)
+            , data_(data)
+            , abbreviation_(nullptr)
+            , attributes_(nullptr)
+        {
+            Cursor c{data, unit->end()};
+            Unsigned code = c.uleb();
+            attributes_ = c.p;
+            if (!code)
+                return;
+
+            abbreviation_ = unit->abbreviations_->find(code);
+            if (!abbreviation_)
+                throw std::runtime_error("Unknown DWARF abbreviation " + std::to_string(code));
+        }
+
+        const char* Die::get_name() const {
+            Attribute attr = get_attribute(DW_AT_name);
+            return attr ? attr.as<const char*>() : nullptr;
+        }
+
+        Off Die::get_offset() const {
+            return unit_->base_ + (data_ - unit_->data_);
+        }
+
+        Tag Die::get_tag() const {
+            return Tag(abbreviation_ ? abbreviation_->tag : 0);
+        }
+
+        const Debug* Die::get_debug() const {
+            return unit_->debug_;
+        }
+
+        Attribute Die::get_attribute(Half name) const {
+            if (!abbreviation_)
+                return Attribute();
+
+            const AttributeSpec* specs = &unit_->abbreviations_->specs_[abbreviation_->first_spec];
+            for (uint32_t i = 0; i < abbreviation_->spec_count; ++i)
+                if (specs[i].name == name)
+                    return attribute_at(i);
+            return Attribute();
+        }
+
+        // Only the attributes following the fixed-size ones need to be
+        // decoded to be located.
+        Attribute Die::attribute_at(uint32_t index) const {
+            const AttributeSpec* specs = &unit_->abbreviations_->specs_[abbreviation_->first_spec];
+            if (index < abbreviation_->fixed_count) {
+                const AttributeSpec& spec = specs[index];
+                return Attribute(unit_, spec.form, locate(attributes_, spec.position, *unit_), spec.implicit_const);
+            }
+
+            Cursor c{locate(attributes_, abbreviation_->fixed_end, *unit_), unit_->end()};
+            for (uint32_t i = abbreviation_->fixed_count; ; ++i) {
+                Half form = specs[i].form;
+                if (form == DW_FORM_indirect)
+                    form = static_cast<Half>(c.uleb());
+                if (i == index)
+                    return Attribute(unit_, form, c.p, specs[i].implicit_const);
+                skip_form(c, form, *unit_);
+            }
+        }
+
+        const char* Die::attributes_end() const {
+            if (!abbreviation_)
+                return attributes_;
+
+            const AttributeSpec* specs = &unit_->abbreviations_->specs_[abbreviation_->first_spec];
+            Cursor c{locate(attributes_, abbreviation_->fixed_end, *unit_), unit_->end()};
+            for (uint32_t i = abbreviation_->fixed_count; i < abbreviation_->spec_count; ++i)
+                skip_form(c, specs[i].form, *unit_);
+            return c.p;
+        }
+
+        const char* Die::sibling() const {
+            if (!abbreviation_ || !abbreviation_->has_children || abbreviation_->sibling < 0)
+                return nullptr;
+
+            Attribute attr = attribute_at(static_cast<uint32_t>(abbreviation_->sibling));
+            if (!is_reference(attr.form()) || attr.form() == DW_FORM_ref_addr)
+                return nullptr;
+
+            // siblings must come after the DIE, inside its unit
+            Off offset = attr.as<Unsigned>();
+            if (offset <= get_offset() || offset > unit_->end_)
+                return nullptr;
+            return unit_->at(offset);
+        }
+
+        const char* skip_siblings(const CompilationUnit* unit, const char* data) {
+            size_t depth = 1;
+            while (data < unit->end()) {
+                Die die(unit, data);
+                if (die.is_null()) {
+                    data = die.attributes_end();
+                    if (!--depth)
+                        return data;
+                } else if (const char* sibling = die.sibling()) {
+                    data = sibling;
+                } else {
+                    data = die.attributes_end();
+                    if (die.has_children())
+                        ++depth;
+                }
+            }
+            return data;
+        }
+
+        Die CompilationUnit::die() const {
+            prepare();
+            return Die(this, begin());
+        }
+
+        void CompilationUnit::prepare() const {
+            if (prepared_)
+                return;
+
+            const Debug& debug = *debug_;
+            Off abbrev_offset = abbrev_offset_;
+            str_offsets_base_ = 0;
+            addr_base_ = 0;
+
+            // split units index their strings from the start of their
+            // contribution, past the header of DWARF 5 string offset tables
+            if (debug.split_) {
+                auto contribution = debug.package_.find(offset_);
+                if (contribution != debug.package_.end()) {
+                    abbrev_offset += contribution->second.abbrev;
+                    str_offsets_base_ = contribution->second.str_offsets;
+                }
+                if (version_ >= 5)
+                    str_offsets_base_ += 2 * offset_size_;
+            }
+
+            data_ = section_->data(end_ - base_);
+            abbreviations_ = &debug.abbreviations(abbrev_offset);
+            prepared_ = true;
+
+            Die unit_die(this, begin());
+            if (unit_die.is_null())
+                return;
+
+            Attribute base = unit_die.get_attribute(DW_AT_str_offsets_base);
+            if (base)
+                str_offsets_base_ = base.as<Unsigned>();
+            base = unit_die.get_attribute(DW_AT_addr_base);
+            if (!base)
+                base = unit_die.get_attribute(DW_AT_GNU_addr_base);
+            if (base)
+                addr_base_ = base.as<Unsigned>();
+
+            if (debug.split_) {
+                Unsigned id = id_;
+                if (version_ < 5) {
+                    Attribute attr = unit_die.get_attribute(DW_AT_GNU_dwo_id);
+                    id = attr ? attr.as<Unsigned>() : 0;
+                }
+                auto skeleton = debug.addr_bases_.find(id);
+                if (skeleton != debug.addr_bases_.end())
+                    addr_base_ = skeleton->second;
+            }
+        }
+
+        bool Debug::const_iterator::operator==(const const_iterator& other) const {
+            auto at_end = [](const const_iterator& it) {
+                return it.index_ == static_cast<size_t>(-1) || !it.debug_->unit(it.index_);
+            };
+            bool end = at_end(*this);
+            bool other_end = at_end(other);
+            return end || other_end ? end == other_end : index_ == other.index_;
+        }
+
+        Debug::Debug(int fd)
+            : Debug(std::make_shared<ElfFile>(fd), nullptr)
+        {}
+
+        Debug::Debug(std::shared_ptr<ElfFile> file, std::shared_ptr<ElfFile> skeleton)
+            : file_(std::move(file))
+            , info_()
+            , abbrev_()
+            , str_()
+            , line_str_()
+            , str_offsets_()
+            , addr_()
+            , types_()
+            , split_(false)
+            , package_()
+            , skeleton_(std::move(skeleton))
+            , addr_bases_()
+            , units_()
+            , complete_(false)
+            , type_units_()
+            , signatures_()
+            , signatures_read_(false)
+            , abbreviation_tables_()
+        {
+            open();
+        }
+
+        void Debug::open() {
+            if (!file_->valid())
+                throw std::runtime_error("Not an ELF file");
+
+            info_ = file_->debug_section(".debug_info");
+            if (!info_) {
+                info_ = file_->debug_section(".debug_info.dwo");
+                split_ = info_ != nullptr;
+            }
+            std::string suffix = split_ ? ".dwo" : "";
+
+            abbrev_ = file_->debug_section(".debug_abbrev" + suffix);
+            if (!info_ || !abbrev_)
+                throw std::runtime_error("No DWARF debugging information");
+
+            str_ = file_->debug_section(".debug_str" + suffix);
+            str_offsets_ = file_->debug_section(".debug_str_offsets" + suffix);
+            types_ = file_->debug_section(".debug_types" + suffix);
+            if (!split_) {
+                line_str_ = file_->debug_section(".debug_line_str");
+                addr_ = file_->debug_section(".debug_addr");
+            } else {
+                read_package_index();
+                read_skeletons();
+            }
+        }
+
+        void Debug::read_skeletons() {
+            if (!skeleton_ || !skeleton_->valid())
+                return;
+
+            Debug skeleton(skeleton_);
+            if (skeleton.split_)
+                return;
+
+            addr_ = skeleton.addr_;
+            for (const CompilationUnit& unit : skeleton) {
+                unit.prepare();
+                Unsigned id = unit.id_;
+                if (unit.version_ < 5) {
+                    Attribute attr = unit.die().get_attribute(DW_AT_GNU_dwo_id);
+                    if (!attr)
+                        continue;
+                    id = attr.as<Unsigned>();
+                }
+                addr_bases_[id] = unit.addr_base_;
+            }
+        }
+
+        // The index of a .dwp package has a header, a hash table of unit
+        // signatures, then a table of the offsets of the contributions of
+        // each unit to each section, whose first row holds the section ids.
+        void Debug::read_package_index() {
+            std::shared_ptr<DebugSection> index = file_->debug_section(".debug_cu_index");
+            if (!index)
+                return;
+
+            const char* data = index->data();
+            Cursor c{data, data + index->size()};
+            uint16_t version = c.read<uint16_t>();
+            c.skip(2);
+            if (version != 2 && version != 5)
+                return;
+
+            uint32_t sections = c.read<uint32_t>();
+            uint32_t units = c.read<uint32_t>();
+            uint32_t slots = c.read<uint32_t>();
+            c.skip(size_t(slots) * 12);
+
+            std::vector<uint32_t> ids(sections);
+            for (uint32_t& id : ids)
+                id = c.read<uint32_t>();
+
+            for (uint32_t unit = 0; unit < units; ++unit) {
+                Off info = 0;
+                Contribution contribution{0, 0};
+                for (uint32_t id : ids) {
+                    uint32_t offset = c.read<uint32_t>();
+                    if (id == DW_SECT_INFO)
+                        info = offset;
+                    else if (id == DW_SECT_ABBREV)
+                        contribution.abbrev = offset;
+                    else if (id == DW_SECT_STR_OFFSETS)
+                        contribution.str_offsets = offset;
+                }
+                package_[info] = contribution;
+            }
+        }
+
+        bool Debug::read_unit_header(DebugSection& section, Off base, Off offset, CompilationUnit& unit) const {
+            static const size_t MAX_HEADER_SIZE = 48;
+
+            size_t size = section.size();
+            size_t available = std::min(size, offset + MAX_HEADER_SIZE);
+            const char* data = section.data(available);
+            Cursor c{data + offset, data + available};
+
+            unit.offset_size_ = 4;
+            Unsigned length = c.read<uint32_t>();
+            if (length == 0xffffffff) {
+                unit.offset_size_ = 8;
+                length = c.read<uint64_t>();
+            } else if (length >= 0xfffffff0) {
+                return false;
+            }
+
+            Off start = c.p - data;
+            if (length > size - start)
+                return false;
+
+            unit.debug_ = this;
+            unit.section_ = &section;
+            unit.base_ = base;
+            unit.offset_ = base + offset;
+            unit.end_ = base + start + length;
+            unit.version_ = c.read<uint16_t>();
+            unit.unit_type_ = DW_UT_compile;
+            unit.id_ = 0;
+            unit.type_offset_ = 0;
+            if (unit.version_ < 2 || unit.version_ > 5)
+                return false;
+
+            if (unit.version_ >= 5) {
+                unit.unit_type_ = c.read<uint8_t>();
+                unit.address_size_ = c.read<uint8_t>();
+                unit.abbrev_offset_ = c.read_sized(unit.offset_size_);
+                switch (unit.unit_type_) {
+                    case DW_UT_skeleton:
+                    case DW_UT_split_compile:
+                        unit.id_ = c.read<uint64_t>();
+                        break;
+                    case DW_UT_type:
+                    case DW_UT_split_type:
+                        unit.id_ = c.read<uint64_t>();
+                        unit.type_offset_ = c.read_sized(unit.offset_size_);
+                        break;
+                    default:
+                        break;
+                }
+            } else {
+                unit.abbrev_offset_ = c.read_sized(unit.offset_size_);
+                unit.address_size_ = c.read<uint8_t>();
+                if (&section == types_.get()) {
+                    unit.unit_type_ = split_ ? DW_UT_split_type : DW_UT_type;
+                    unit.id_ = c.read<uint64_t>();
+                    unit.type_offset_ = c.read_sized(unit.offset_size_);
+                }
+            }
+            unit.die_offset_ = base + (c.p - data);
+
+            unit.prepared_ = false;
+            unit.data_ = nullptr;
+            unit.abbreviations_ = nullptr;
+            unit.str_offsets_base_ = 0;
+            unit.addr_base_ = 0;
+            return unit.die_offset_ <= unit.end_;
+        }
+
+        Debug::const_iterator Debug::begin() const {
+            return const_iterator(this, 0);
+        }
+
+        Debug::const_iterator Debug::end() const {
+            return const_iterator(this, static_cast<size_t>(-1));
+        }
+
+        const CompilationUnit* Debug::unit(size_t index) const {
+            while (units_.size() <= index && !complete_) {
+                Off offset = units_.empty() ? 0 : units_.back().end_;
+                CompilationUnit unit;
+                if (offset >= info_->size() || !read_unit_header(*info_, 0, offset, unit)) {
+                    complete_ = true;
+                    break;
+                }
+                units_.push_back(unit);
+            }
+            return index < units_.size() ? &units_[index] : nullptr;
+        }
+
+        const CompilationUnit* Debug::unit_at(Off offset) const {
+            std::deque<CompilationUnit>* units = &units_;
+            if (offset >= info_->size()) {
+                read_type_units();
+                units = &type_units_;
+            } else {
+                while (!complete_ && (units_.empty() || units_.back().end_ <= offset))
+                    unit(units_.size());
+            }
+
+            auto it = std::upper_bound(units->begin(), units->end(), offset,
+                                       [](Off off, const CompilationUnit& unit) { return off < unit.offset_; });
+            if (it == units->begin())
+                return nullptr;
+            --it;
+            return offset < it->end_ ? &*it : nullptr;
+        }
+
+        const CompilationUnit* Debug::type_unit(Unsigned signature) const {
+            read_type_units();
+            auto it = signatures_.find(signature);
+            return it != signatures_.end() ? it->second : nullptr;
+        }
+
+        // DWARF 5 type units are found among the units of .debug_info, and
+        // DWARF 4 ones in .debug_types.
+        void Debug::read_type_units() const {
+            if (signatures_read_)
+                return;
+            signatures_read_ = true;
+
+            for (size_t index = 0; const CompilationUnit* unit = this->unit(index); ++index)
+                if (unit->is_type_unit())
+                    signatures_.emplace(unit->id_, unit);
+
+            if (!types_)
+                return;
+
+            Off base = info_->size();
+            for (Off offset = 0; offset < types_->size(); ) {
+                CompilationUnit unit;
+                if (!read_unit_header(*types_, base, offset, unit))
+                    break;
+                type_units_.push_back(unit);
+                offset = unit.end_ - base;
+            }
+            for (const CompilationUnit& unit : type_units_)
+                signatures_.emplace(unit.id_, &unit);
+        }
+
+        boost::optional<AnyDie> Debug::offdie(Off offset) const {
+            const CompilationUnit* unit = unit_at(offset);
+            if (!unit)
+                return boost::none;
+
+            unit->prepare();
+            if (offset < unit->die_offset_)
+                return boost::none;
+            return AnyDie(Die(unit, unit->at(offset)));
+        }
+
+        const AbbreviationTable& Debug::abbreviations(Off offset) const {
+            auto it = abbreviation_tables_.find(offset);
+            if (it != abbreviation_tables_.end())
+                return *it->second;
+
+            if (offset >= abbrev_->size())
+                throw std::runtime_error("Invalid DWARF abbreviation offset");
+
+            std::unique_ptr<AbbreviationTable> table(new AbbreviationTable());
+            const char* data = abbrev_->data();
+            Cursor c{data + offset, data + abbrev_->size()};
+            for (;;) {
+                Unsigned code = c.uleb();
+                if (!code)
+                    break;
+
+                Abbreviation abbreviation;
+                abbreviation.tag = static_cast<Half>(c.uleb());
+                abbreviation.has_children = c.read<uint8_t>() != 0;
+                abbreviation.first_spec = static_cast<uint32_t>(table->specs_.size());
+                abbreviation.spec_count = 0;
+                abbreviation.fixed_count = 0;
+                abbreviation.fixed_end = AttributeLayout{0, 0, 0};
+                abbreviation.sibling = -1;
+                bool fixed = true;
+                for (;;) {
+                    AttributeSpec spec;
+                    spec.name = static_cast<Half>(c.uleb());
+                    spec.form = static_cast<Half>(c.uleb());
+                    if (!spec.name && !spec.form)
+                        break;
+                    spec.implicit_const = spec.form == DW_FORM_implicit_const ? c.sleb() : 0;
+                    spec.position = abbreviation.fixed_end;
+                    if (fixed && extend_layout(abbreviation.fixed_end, spec.form))
+                        ++abbreviation.fixed_count;
+                    else
+                        fixed = false;
+                    if (spec.name == DW_AT_sibling && abbreviation.sibling < 0)
+                        abbreviation.sibling = static_cast<int32_t>(abbreviation.spec_count);
+                    table->specs_.push_back(spec);
+                    ++abbreviation.spec_count;
+                }
+
+                if (code < 4096) {
+                    if (code >= table->dense_.size())
+                        table->dense_.resize(code + 1, Abbreviation{0, false, 0, 0, 0, {0, 0, 0}, -1});
+                    table->dense_[code] = abbreviation;
+                } else {
+                    table->sparse_[code] = abbreviation;
+                }
+            }
+
+            return *abbreviation_tables_.emplace(offset, std::move(table)).first->second;
+        }
+
+    }
+
+}
@@ -0,0 +1,447 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef INSIGHT_NATIVE_READER_HH
+# define INSIGHT_NATIVE_READER_HH
+
+# include <cstdint>
+# include <deque>
+# include <memory>
+# include <unordered_map>
+# include <utility>
+# include <vector>
+# include <boost/optional.hpp>
+# include "constants.hh"
+# include "util/elf.hh"
+
+// Tags dispatched to their own TaggedDie, other DIEs are TaggedDie<0>.
+# define INSIGHT_NATIVE_TAGS(X) \
+    X(DW_TAG_array_type) \
+    X(DW_TAG_class_type) \
+    X(DW_TAG_enumeration_type) \
+    X(DW_TAG_formal_parameter) \
+    X(DW_TAG_lexical_block) \
+    X(DW_TAG_member) \
+    X(DW_TAG_pointer_type) \
+    X(DW_TAG_compile_unit) \
+    X(DW_TAG_structure_type) \
+    X(DW_TAG_typedef) \
+    X(DW_TAG_union_type) \
+    X(DW_TAG_inheritance) \
+    X(DW_TAG_subrange_type) \
+    X(DW_TAG_base_type) \
+    X(DW_TAG_const_type) \
+    X(DW_TAG_enumerator) \
+    X(DW_TAG_subprogram) \
+    X(DW_TAG_variable) \
+    X(DW_TAG_volatile_type) \
+    X(DW_TAG_namespace) \
+    X(DW_TAG_unspecified_type) \
+    X(DW_TAG_partial_unit) \
+    X(DW_TAG_type_unit) \
+    X(DW_TAG_skeleton_unit)
+
+namespace Insight {
+
+    // A DWARF 2 to 5 reader working in place on the sections of a mapped ELF
+    // file. Its interface is the subset of libdwarf++ used by the builders,
+    // so that either can be selected at build time, but DIEs and attributes
+    // are small values decoded on the stack instead of heap allocated
+    // objects. A Debug and its DIEs are used by one thread at a time.
+    namespace Native {
+
+        typedef uint64_t Off;
+        typedef uint64_t Unsigned;
+        typedef int64_t Signed;
+        typedef uint64_t Addr;
+        typedef uint16_t Half;
+
+        struct Block {
+            Unsigned bl_len;
+            void* bl_data;
+        };
+
+        class Debug;
+        class CompilationUnit;
+        class AnyDie;
+
+        // Position of an attribute from the start of the attributes of a
+        // DIE, depending on the address and offset sizes of its unit.
+        struct AttributeLayout {
+            uint32_t bytes;
+            uint16_t addresses;
+            uint16_t offsets;
+        };
+
+        struct AttributeSpec {
+            Half name;
+            Half form;
+            Signed implicit_const;
+            AttributeLayout position;
+        };
+
+        struct Abbreviation {
+            Half tag;
+            bool has_children;
+            uint32_t first_spec;
+            uint32_t spec_count;
+            // the attributes before fixed_count are at a known position,
+            // and those that follow end after fixed_end
+            uint32_t fixed_count;
+            AttributeLayout fixed_end;
+            int32_t sibling;
+        };
+
+        struct AbbreviationTable {
+            const Abbreviation* find(Unsigned code) const;
+
+            // codes are usually allocated densely from 1
+            std::vector<Abbreviation> dense_;
+            std::unordered_map<Unsigned, Abbreviation> sparse_;
+            std::vector<AttributeSpec> specs_;
+        };
+
+        class Tag {
+        public:
+            Tag(Half id) : id_(id) {}
+            int get_id() const { return id_; }
+
+        private:
+            Half id_;
+        };
+
+        class Attribute {
+        public:
+            Attribute();
+            Attribute(const CompilationUnit* unit, Half form, const char* data, Signed implicit_const);
+
+            explicit operator bool() const { return form_ != 0; }
+            const Attribute* operator->() const { return this; }
+
+            Half form() const { return form_; }
+
+            // Unsigned (as well as Off and Addr), Signed, const char* and
+            // Block*. References are returned as section offsets, and
+            // location expressions holding a single address or constant as
+            // their value.
+            template <typename T>
+            T as() const;
+
+            boost::optional<AnyDie> as_die() const;
+
+        private:
+            Unsigned read_address(Unsigned index) const;
+
+            const CompilationUnit* unit_;
+            Half form_;
+            const char* data_;
+            Signed implicit_const_;
+            mutable Unsigned value_;
+            mutable Block block_;
+        };
+
+        template <> Unsigned Attribute::as<Unsigned>() const;
+        template <> Signed Attribute::as<Signed>() const;
+        template <> const char* Attribute::as<const char*>() const;
+        template <> Block* Attribute::as<Block*>() const;
+
+        class Die {
+        public:
+            enum class TraversalResult { TRAVERSE, SKIP, BREAK };
+
+            struct visitor_to_die {};
+
+            Die(const CompilationUnit* unit, const char* data);
+
+            const char* get_name() const;
+            Off get_offset() const;
+            Attribute get_attribute(Half name) const;
+            Tag get_tag() const;
+            const Debug* get_debug() const;
+
+            // Visits the DIE and, if the visitor returns TRAVERSE, its
+            // children, recursively.
+            template <typename V>
+            void visit(V& visitor) const;
+
+            // Visits the children of the DIE.
+            template <typename V>
+            void visit_headless(V& visitor) const;
+
+            // Whether this is the entry that ends a list of siblings.
+            bool is_null() const { return !abbreviation_; }
+            bool has_children() const { return abbreviation_->has_children; }
+
+            // Position of the first child, or of the next sibling for DIEs
+            // without children.
+            const char* attributes_end() const;
+
+            // Position of the next sibling of a DIE with children as given
+            // by DW_AT_sibling, or null when the producer did not emit it.
+            const char* sibling() const;
+
+        protected:
+            Attribute attribute_at(uint32_t index) const;
+
+            const CompilationUnit* unit_;
+            const char* data_;
+            const Abbreviation* abbreviation_;
+            const char* attributes_;
+        };
+
+        template <int T>
+        class TaggedDie : public Die {
+        public:
+            explicit TaggedDie(const Die& die) : Die(die) {}
+        };
+
+        struct DefaultDieVisitor {};
+
+        template <typename V>
+        auto dispatch(const Die& die, V& visitor) -> decltype(visitor(std::declval<TaggedDie<0>&>())) {
+            switch (die.get_tag().get_id()) {
+# define INSIGHT_NATIVE_DISPATCH(Tag) \
+                case Tag: { \
+                    TaggedDie<Tag> tagged(die); \
+                    return visitor(tagged); \
+                }
+                INSIGHT_NATIVE_TAGS(INSIGHT_NATIVE_DISPATCH)
+# undef INSIGHT_NATIVE_DISPATCH
+                default: {
+                    TaggedDie<0> tagged(die);
+                    return visitor(tagged);
+                }
+            }
+        }
+
+        class AnyDie {
+        public:
+            AnyDie(const Die& die) : die_(die) {}
+
+            template <typename V>
+            auto apply_visitor(V& visitor) -> decltype(dispatch(std::declval<Die&>(), visitor)) {
+                return dispatch(die_, visitor);
+            }
+
+            Die& apply_visitor(Die::visitor_to_die&) {
+                return die_;
+            }
+
+        private:
+            Die die_;
+        };
+
+        class CompilationUnit {
+        public:
+            template <typename V>
+            void visit(V& visitor) const {
+                die().visit(visitor);
+            }
+
+            template <typename V>
+            void visit_headless(V& visitor) const {
+                die().visit_headless(visitor);
+            }
+
+            Die die() const;
+
+            // Reads the abbreviations and the base attributes of the unit,
+            // and makes its part of .debug_info available.
+            void prepare() const;
+
+            // Positions after the unit header and after the last DIE.
+            const char* begin() const { return at(die_offset_); }
+            const char* end() const { return at(end_); }
+
+            // Position of the DIE at an offset inside the unit.
+            const char* at(Off offset) const { return data_ + (offset - base_); }
+
+            bool is_type_unit() const { return unit_type_ == DW_UT_type || unit_type_ == DW_UT_split_type; }
+
+            const Debug* debug_;
+            DebugSection* section_;
+            // Offsets are those of the DIEs, which count the units of
+            // .debug_types from the end of .debug_info.
+            Off base_;
+            Off offset_;
+            Off end_;
+            Off die_offset_;
+            Off abbrev_offset_;
+            uint16_t version_;
+            uint8_t unit_type_;
+            uint8_t address_size_;
+            uint8_t offset_size_;
+            Unsigned id_;           // DWO id or type signature
+            Off type_offset_;       // of the type described by a type unit
+
+            mutable bool prepared_;
+            mutable const char* data_;
+            mutable const AbbreviationTable* abbreviations_;
+            mutable Off str_offsets_base_;
+            mutable Off addr_base_;
+        };
+
+        class Debug {
+        public:
+            class const_iterator {
+            public:
+                const_iterator(const Debug* debug, size_t index) : debug_(debug), index_(index) {}
+
+                const CompilationUnit& operator*() const { return *debug_->unit(index_); }
+                const CompilationUnit* operator->() const { return debug_->unit(index_); }
+                const_iterator& operator++() { ++index_; return *this; }
+
+                bool operator==(const const_iterator& other) const;
+                bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+            private:
+                const Debug* debug_;
+                size_t index_;
+            };
+
+            Debug(int fd);
+
+            // Split units take their addresses from the .debug_addr section
+            // of the file holding their skeletons.
+            Debug(std::shared_ptr<ElfFile> file, std::shared_ptr<ElfFile> skeleton = nullptr);
+
+            Debug(const Debug&) = delete;
+            Debug& operator=(const Debug&) = delete;
+
+            // Units are found as they are iterated over, so that compressed
+            // sections are only inflated up to the units that are read.
+            const_iterator begin() const;
+            const_iterator end() const;
+
+            boost::optional<AnyDie> offdie(Off offset) const;
+
+            template <typename T>
+            void dealloc([[gnu::unused]] T* ptr) const {}
+
+            // The nth unit, or null past the last one.
+            const CompilationUnit* unit(size_t index) const;
+            const CompilationUnit* unit_at(Off offset) const;
+
+            // The type unit with a signature, from .debug_info or
+            // .debug_types, or null.
+            const CompilationUnit* type_unit(Unsigned signature) const;
+
+            const AbbreviationTable& abbreviations(Off offset) const;
+
+            struct Contribution {
+                Off abbrev;
+                Off str_offsets;
+            };
+
+            std::shared_ptr<ElfFile> file_;
+            std::shared_ptr<DebugSection> info_;
+            std::shared_ptr<DebugSection> abbrev_;
+            std::shared_ptr<DebugSection> str_;
+            std::shared_ptr<DebugSection> line_str_;
+            std::shared_ptr<DebugSection> str_offsets_;
+            std::shared_ptr<DebugSection> addr_;
+            std::shared_ptr<DebugSection> types_;
+            bool split_;
+
+            // contributions of the units of a .dwp package, by the offset
+            // of the unit in .debug_info.dwo
+            std::unordered_map<Off, Contribution> package_;
+
+            // .debug_addr bases of the skeletons, by DWO id
+            std::shared_ptr<ElfFile> skeleton_;
+            std::unordered_map<Unsigned, Off> addr_bases_;
+
+        private:
+            void open();
+            void read_package_index();
+            void read_skeletons();
+            bool read_unit_header(DebugSection& section, Off base, Off offset, CompilationUnit& unit) const;
+            void read_type_units() const;
+
+            mutable std::deque<CompilationUnit> units_;
+            mutable bool complete_;
+
+            // the units of .debug_types are only read to resolve signatures
+            mutable std::deque<CompilationUnit> type_units_;
+            mutable std::unordered_map<Unsigned, const CompilationUnit*> signatures_;
+            mutable bool signatures_read_;
+            mutable std::unordered_map<Off, std::unique_ptr<AbbreviationTable>> abbreviation_tables_;
+        };
+
+        // Calls a visitor on a list of siblings, descending into the children
+        // of those for which it returns TRAVERSE. Returns the position after
+        // the list, or null if the visitor asked to stop.
+        template <typename V>
+        const char* visit_siblings(const CompilationUnit* unit, const char* data, V& visitor);
+
+        // Position after the children of a DIE, starting at the first one.
+        const char* skip_siblings(const CompilationUnit* unit, const char* data);
+
+        template <typename V>
+        const char* visit_siblings(const CompilationUnit* unit, const char* data, V& visitor) {
+            while (data < unit->end()) {
+                Die die(unit, data);
+                if (die.is_null())
+                    return die.attributes_end();
+
+                Die::TraversalResult result = dispatch(die, visitor);
+                if (result == Die::TraversalResult::BREAK)
+                    return nullptr;
+
+                // skipped subtrees are jumped over without being decoded
+                const char* next = nullptr;
+                if (die.has_children() && result != Die::TraversalResult::TRAVERSE)
+                    next = die.sibling();
+
+                if (!next) {
+                    next = die.attributes_end();
+                    if (die.has_children()) {
+                        if (result == Die::TraversalResult::TRAVERSE)
+                            next = visit_siblings(unit, next, visitor);
+                        else
+                            next = skip_siblings(unit, next);
+                        if (!next)
+                            return nullptr;
+                    }
+                }
+                data = next;
+            }
+            return data;
+        }
+
+        template <typename V>
+        void Die::visit(V& visitor) const {
+            if (is_null())
+                return;
+            TraversalResult result = dispatch(*this, visitor);
+            if (result == TraversalResult::TRAVERSE && has_children())
+                visit_siblings(unit_, attributes_end(), visitor);
+        }
+
+        template <typename V>
+        void Die::visit_headless(V& visitor) const {
+            if (!is_null() && has_children())
+                visit_siblings(unit_, attributes_end(), visitor);
+        }
+
+    }
+
+}
+
+#endif /* !INSIGHT_NATIVE_READER_HH */
@@ -0,0 +1,150 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <sys/stat.h>
+#include "split.hh"
+
+namespace Insight {
+
+    static bool exists(const std::string& path) {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0;
+    }
+
+    static std::string directory_of(const std::string& path) {
+        size_t slash = path.rfind('/');
+        return slash == std::string::npos ? "." : path.substr(0, slash);
+    }
+
+    SkeletonFinder::SkeletonFinder(const std::string& binary)
+        : binary(binary)
+        , path()
+        , package(false)
+    {}
+
+    Result SkeletonFinder::operator()(Dwarf::TaggedDie<DW_TAG_compile_unit>& die) {
+        return find(die);
+    }
+
+    Result SkeletonFinder::operator()(Dwarf::TaggedDie<DW_TAG_skeleton_unit>& die) {
+        return find(die);
+    }
+
+    // All the units of a binary are in its .dwp package when there is one,
+    // otherwise each one is in the .dwo named by the skeleton, relative to
+    // the compilation directory or, once deployed, to the binary.
+    Result SkeletonFinder::find(Dwarf::Die& die) {
+        auto nameattr = die.get_attribute(DW_AT_dwo_name);
+        if (!nameattr)
+            nameattr = die.get_attribute(DW_AT_GNU_dwo_name);
+        if (!nameattr)
+            return Result::SKIP;
+
+        std::string package = binary + ".dwp";
+        if (!binary.empty() && exists(package)) {
+            path = package;
+            this->package = true;
+            return Result::SKIP;
+        }
+
+        std::string name = nameattr->as<const char*>();
+        auto dirattr = die.get_attribute(DW_AT_comp_dir);
+        if (name[0] == '/' || !dirattr)
+            path = name;
+        else
+            path = std::string(dirattr->as<const char*>()) + "/" + name;
+
+        if (!exists(path)) {
+            std::string local = directory_of(binary) + "/" + name.substr(name.rfind('/') + 1);
+            if (exists(local))
+                path = local;
+        }
+        return Result::SKIP;
+    }
+
+    namespace {
+
+        struct DwoIdFinder : public Dwarf::DefaultDieVisitor {
+            template <typename T>
+            Result operator()(T& die) {
+                auto attr = die.get_attribute(DW_AT_GNU_dwo_id);
+                if (attr)
+                    id = attr->template as<Dwarf::Unsigned>();
+                return Result::BREAK;
+            }
+
+            uint64_t id = 0;
+        };
+
+    }
+
+    // DWARF 5 puts the id in the unit header, the GNU extension in the DIE.
+    uint64_t split_unit_id(const Dwarf::CompilationUnit& cu) {
+#ifdef INSIGHT_NATIVE_DWARF
+        if (cu.version_ >= 5)
+            return cu.id_;
+#endif
+        DwoIdFinder finder;
+        cu.visit(finder);
+        return finder.id;
+    }
+
+    // The unit is read into a registry of its own without locking this one,
+    // which is only locked for the merge. The registry of the unit is kept
+    // as a module, as its elements refer to it.
+    bool RegistryImpl::load_more() {
+        SplitUnit unit;
+        {
+            std::lock_guard<std::mutex> guard(pending_mutex_);
+            if (pending_units_.empty())
+                return false;
+            unit = pending_units_.front();
+            pending_units_.erase(pending_units_.begin());
+        }
+
+        std::shared_ptr<ElfFile> skeleton;
+        {
+            std::lock_guard<std::mutex> guard(statistics_mutex_);
+            if (!files_.empty())
+                skeleton = files_.front();
+        }
+
+        std::shared_ptr<Module> part = std::make_shared<Module>();
+        part->info = ModuleInfo{unit.path, bias_, true, ""};
+        part->file = {};
+        part->registry = std::make_shared<RegistryImpl>(path_);
+        part->registry->track_additions_ = true;
+        part->registry->loaded_ = loaded_;
+        part->registry->filter_ = filter_;
+        part->registry->lazy_members_ = lazy_members_;
+        try {
+            load_file(*part->registry, unit.path, bias_, skeleton, unit.id);
+        } catch (const std::exception&) {
+            return true;
+        }
+
+        std::unique_lock<std::shared_timed_mutex> lock(lock_);
+        std::lock_guard<std::recursive_mutex> guard(build_mutex_);
+        merge_module(*this, *part);
+        std::lock_guard<std::mutex> modules(modules_mutex_);
+        modules_.push_back(part);
+        return true;
+    }
+
+}
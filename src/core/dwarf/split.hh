@@ -0,0 +1,53 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef INSIGHT_SPLIT_HH
+# define INSIGHT_SPLIT_HH
+
+# include "type.hh"
+
+namespace Insight {
+
+    // Finds the split DWARF object of a skeleton unit, built with
+    // -gsplit-dwarf, from the attributes of its unit DIE.
+    struct SkeletonFinder : public Dwarf::DefaultDieVisitor {
+
+        Result operator()(Dwarf::TaggedDie<DW_TAG_compile_unit>& die);
+        Result operator()(Dwarf::TaggedDie<DW_TAG_skeleton_unit>& die);
+
+        template <typename T>
+        Result operator()([[gnu::unused]] T& t) {
+            return Result::SKIP;
+        }
+
+        SkeletonFinder(const std::string& binary);
+
+        Result find(Dwarf::Die& die);
+
+        const std::string& binary;
+        std::string path;   // empty for units that are not skeletons
+        bool package;       // whether the path is the .dwp of the binary
+    };
+
+    // The DWO id of a skeleton or split unit, zero when it has none.
+    uint64_t split_unit_id(const Dwarf::CompilationUnit& cu);
+
+}
+
+#endif /* !INSIGHT_SPLIT_HH */
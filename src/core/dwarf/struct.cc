@@ -17,23 +17,40 @@
  * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
  *
  */
+#include <cassert>
 #include "struct.hh"
 #include "annotation.hh"
 #include "subprogram.hh"
+#include "dedup.hh"
 
 namespace Insight {
 
     Result StructBuilder::operator()(Dwarf::TaggedDie<DW_TAG_member> &die) {
+        return add_member(die);
+    }
+
+    // DWARF 5 producers describe static data members as variables
+    Result StructBuilder::operator()(Dwarf::TaggedDie<DW_TAG_variable> &die) {
+        return add_member(die);
+    }
+
+    Result StructBuilder::add_member(Dwarf::Die &die) {
         std::string name(die.get_name() ?: "");
 
         auto type = tb.get_type_attr(die);
-        if (!type)
+        if (!type) {
+            // keep track of the storage of members we cannot describe, so
+            // that it is not mistaken for padding.
+            size_t offset = get_offset(die);
+            if (offset != static_cast<size_t>(-1))
+                info->opaque_fields_.push_back(offset);
             return Result::SKIP;
+        }
 
         std::string prefix("insight_annotation");
         if (name.substr(0, prefix.size()) == prefix) {
-            std::unique_ptr<const Dwarf::Attribute> locattr = die.get_attribute(DW_AT_location);
-            std::unique_ptr<const Dwarf::Attribute> constattr = die.get_attribute(DW_AT_const_value);
+            auto locattr = die.get_attribute(DW_AT_location);
+            auto constattr = die.get_attribute(DW_AT_const_value);
 
             std::shared_ptr<AnnotationInfoImpl> annotation;
 
@@ -45,13 +62,14 @@ namespace Insight {
                 void *addr = reinterpret_cast<void *>(loc);
 
                 annotation = std::make_shared<AnnotationInfoImpl>(annotationName, addr, type);
+                annotation->bias_ = &tb.ctx.registry.bias_;
             } else if (constattr) {
                 Dwarf::Block *block = constattr->as<Dwarf::Block *>();
 
                 // we leak the block because we need it alive until the program ends
                 void *addr = std::malloc(block->bl_len);
                 std::memcpy(addr, block->bl_data, block->bl_len);
-                std::shared_ptr<const Dwarf::Debug> dbg = die.get_debug();
+                auto dbg = die.get_debug();
                 if (dbg)
                     dbg->dealloc(block);
 
@@ -67,10 +85,15 @@ namespace Insight {
         } else {
 
             size_t offset = get_offset(die);
-            if (offset == static_cast<size_t>(-1))
+            if (offset == static_cast<size_t>(-1)) {
+                // bitfields may only be located by DW_AT_data_bit_offset
+                auto bitattr = die.get_attribute(DW_AT_data_bit_offset);
+                if (bitattr)
+                    info->opaque_fields_.push_back(bitattr->as<Dwarf::Unsigned>() / 8);
                 return Result::SKIP;
+            }
 
-            std::shared_ptr<FieldInfoImpl> finfo = std::make_shared<FieldInfoImpl>(die.get_name(), offset, type,
+            std::shared_ptr<FieldInfoImpl> finfo = std::make_shared<FieldInfoImpl>(name.c_str(), offset, type,
                                                                                    info);
             info->add_field(finfo);
 
@@ -86,12 +109,12 @@ namespace Insight {
 
         auto return_type = tb.get_type_attr(die);
         if (!return_type)
-            return_type = VOID_TYPE;
+            return_type = tb.ctx.registry.void_type_;
 
         std::shared_ptr<MethodInfoImpl> method = std::make_shared<MethodInfoImpl>(die.get_name(), return_type, info);
 
-        std::unique_ptr<const Dwarf::Attribute> vattr = die.get_attribute(DW_AT_virtuality);
-        std::unique_ptr<const Dwarf::Attribute> vtabattr = die.get_attribute(DW_AT_vtable_elem_location);
+        auto vattr = die.get_attribute(DW_AT_virtuality);
+        auto vtabattr = die.get_attribute(DW_AT_vtable_elem_location);
         if (vattr && vtabattr) {
             Dwarf::Signed virtuality = vattr->as<Dwarf::Signed>();
             if (virtuality != DW_VIRTUALITY_none)
@@ -106,6 +129,7 @@ namespace Insight {
         auto it = tb.ctx.method_addresses.find(die.get_offset());
         if (it != tb.ctx.method_addresses.end()) {
             method->address_ = it->second;
+            method->bias_ = &tb.ctx.registry.bias_;
         }
 
         ParameterListBuilder builder(tb);
@@ -124,7 +148,11 @@ namespace Insight {
         if (!super_type)
             return Result::SKIP;
 
-        info->add_supertype(std::dynamic_pointer_cast<StructInfo>(super_type));
+        size_t offset = get_offset(die);
+        if (offset == static_cast<size_t>(-1))
+            offset = 0;
+
+        info->add_supertype(std::dynamic_pointer_cast<StructInfo>(super_type), offset);
 
         return Result::SKIP;
     }
@@ -135,7 +163,7 @@ namespace Insight {
     {}
 
     std::shared_ptr<TypeInfo> build_struct_type(Dwarf::Die &die, TypeBuilder& tb, bool register_parent) {
-        std::unique_ptr<const Dwarf::Attribute> attrsize = die.get_attribute(DW_AT_byte_size);
+        auto attrsize = die.get_attribute(DW_AT_byte_size);
         size_t size = !attrsize ? 0 : attrsize->as<Dwarf::Off>();
 
         std::shared_ptr<Container> parent = get_parent(tb.ctx);
@@ -144,18 +172,101 @@ namespace Insight {
         std::shared_ptr<StructInfoImpl> info = std::make_shared<StructInfoImpl>(name, size);
         tb.ctx.types[die.get_offset()] = info;
 
+        auto attralign = die.get_attribute(DW_AT_alignment);
+        if (attralign)
+            info->alignment_ = attralign->as<Dwarf::Unsigned>();
+
         if (register_parent)
             info->set_parent(parent);
 
+        if (!tb.ctx.member_loader.expired()) {
+            info->member_loader_ = tb.ctx.member_loader;
+            info->die_offset_ = die.get_offset();
+            info->materialized_ = false;
+
+            std::lock_guard<std::mutex> guard(tb.ctx.registry.statistics_mutex_);
+            ++tb.ctx.registry.statistics_.types_deferred;
+        } else {
+            build_struct_members(die, tb, info);
+        }
+
+        mark_element_line(tb.ctx, die, info);
+
+        return info;
+    }
+
+    void build_struct_members(Dwarf::Die &die, TypeBuilder& tb, std::shared_ptr<StructInfoImpl> info) {
         StructBuilder builder(info, tb);
 
         tb.ctx.container_stack.push(AnyContainer(info));
         die.visit_headless(builder);
         tb.ctx.container_stack.pop();
+    }
 
-        mark_element_line(tb.ctx, die, info);
+    namespace {
 
-        return info;
+        size_t count_additions(const RegistryImpl& registry) {
+            const Additions& additions = registry.additions_;
+            return additions.namespaces.size() + additions.members.size()
+                + additions.types.size() + additions.inferred_types.size();
+        }
+
+    }
+
+    MemberBuilder::MemberBuilder(RegistryImpl& registry, std::shared_ptr<const Dwarf::Debug> dbg)
+        : dbg(dbg)
+        , ctx(*dbg, registry)
+        , tb(ctx)
+    {}
+
+    // What is added to the module along with the members is merged by the
+    // next lookup missing it: the shared metadata is not locked here, as the
+    // thread may be reading it.
+    void MemberBuilder::load_members(StructInfoImpl& type) {
+        RegistryImpl& registry = ctx.registry;
+        std::lock_guard<std::recursive_mutex> guard(registry.build_mutex_);
+        if (type.materialized_)
+            return;
+        // building the members never reads those of the same type
+        assert(!type.building_);
+        type.building_ = true;
+        size_t additions = count_additions(registry);
+
+        auto it = ctx.types.find(type.die_offset_);
+        auto info = it != ctx.types.end() ? std::dynamic_pointer_cast<StructInfoImpl>(it->second) : nullptr;
+        auto die = dbg->offdie(type.die_offset_);
+        if (info && die) {
+            // the annotations of the members are matched among themselves,
+            // apart from those of the unit that may be being loaded
+            decltype(ctx.annotations) annotations;
+            decltype(ctx.annotated) annotated;
+            std::swap(annotations, ctx.annotations);
+            std::swap(annotated, ctx.annotated);
+
+            Dwarf::Die::visitor_to_die to_die;
+            build_struct_members(die->apply_visitor(to_die), tb, info);
+
+            std::shared_ptr<TypeInfo> shared = info;
+            for (size_t i = 0; i < type.duplicates_.size(); ++i) {
+                auto duplicate = dbg->offdie(type.duplicates_[i]);
+                if (duplicate)
+                    adopt_methods(ctx, duplicate->apply_visitor(to_die), shared);
+            }
+            process_annotations(ctx);
+
+            ctx.annotations = std::move(annotations);
+            ctx.annotated = std::move(annotated);
+        }
+
+        type.duplicates_.clear();
+        type.duplicates_.shrink_to_fit();
+        type.building_ = false;
+        type.materialized_.store(true, std::memory_order_release);
+        if (count_additions(registry) != additions)
+            default_registry().unmerged_ = true;
+
+        std::lock_guard<std::mutex> statistics(registry.statistics_mutex_);
+        --registry.statistics_.types_deferred;
     }
 
 }
@@ -27,6 +27,7 @@ namespace Insight {
     struct StructBuilder : public Dwarf::DefaultDieVisitor {
 
         Result operator()(Dwarf::TaggedDie<DW_TAG_member> &die);
+        Result operator()(Dwarf::TaggedDie<DW_TAG_variable> &die);
         Result operator()(Dwarf::TaggedDie<DW_TAG_subprogram> &die);
         Result operator()(Dwarf::TaggedDie<DW_TAG_inheritance> &die);
 
@@ -38,11 +39,27 @@ namespace Insight {
         StructBuilder(std::shared_ptr<StructInfoImpl> info, TypeBuilder &tb);
 
     private:
+        Result add_member(Dwarf::Die &die);
+
         std::shared_ptr<StructInfoImpl> info;
         TypeBuilder& tb;
     };
 
     std::shared_ptr<TypeInfo> build_struct_type(Dwarf::Die &die, TypeBuilder& tb, bool register_parent);
+    void build_struct_members(Dwarf::Die &die, TypeBuilder& tb, std::shared_ptr<StructInfoImpl> info);
+
+    // The state of the build of a binary, kept while the members of some of
+    // its structures are left to be built on first access.
+    class MemberBuilder : public MemberLoader {
+    public:
+        MemberBuilder(RegistryImpl& registry, std::shared_ptr<const Dwarf::Debug> dbg);
+
+        virtual void load_members(StructInfoImpl& type) override;
+
+        std::shared_ptr<const Dwarf::Debug> dbg;
+        BuildContext ctx;
+        TypeBuilder tb;
+    };
 
 }
 
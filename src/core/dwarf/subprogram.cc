@@ -23,7 +23,7 @@ using namespace Insight;
 
 Result ParameterListBuilder::operator()(Dwarf::TaggedDie<DW_TAG_formal_parameter>& die) {
     // don't build info for artificial parameters such as "this"
-    std::unique_ptr<const Dwarf::Attribute> artattr = die.get_attribute(DW_AT_artificial);
+    auto artattr = die.get_attribute(DW_AT_artificial);
     if (artattr)
         return Result::SKIP;
 
@@ -18,9 +18,28 @@
  *
  */
 #include "type.hh"
+#include "dedup.hh"
 
 namespace Insight {
 
+    namespace {
+
+        // Adopts a duplicate of a type built by an earlier unit, and moves it
+        // under the given parent.
+        void adopt_published(BuildContext& ctx, Dwarf::Die& die, std::shared_ptr<TypeInfo> type,
+                             std::shared_ptr<Container> parent) {
+            Dwarf::Off offset = die.get_offset();
+            complete_published(ctx, [&ctx, offset, type, parent]() mutable {
+                Dwarf::Die::visitor_to_die to_die;
+                auto die = ctx.dbg.offdie(offset);
+                adopt_duplicate(ctx, die->apply_visitor(to_die), type);
+                if (parent)
+                    std::dynamic_pointer_cast<MutableChild>(type)->set_parent(parent);
+            });
+        }
+
+    }
+
     Type TypeBuilder::Visitor::operator()(Dwarf::TaggedDie<DW_TAG_base_type> &die) {
         static std::unordered_map<std::string, PrimitiveKind> primitiveKinds{
                 {"char",                   PrimitiveKind::CHAR},
@@ -47,7 +66,7 @@ namespace Insight {
         std::shared_ptr<Container> parent = get_parent(ctx);
 
         PrimitiveKind kind = primitiveKinds[die.get_name()];
-        std::unique_ptr<const Dwarf::Attribute> attrsize = die.get_attribute(DW_AT_byte_size);
+        auto attrsize = die.get_attribute(DW_AT_byte_size);
         if (!attrsize) // ignore types with no size
             return nullptr;
 
@@ -99,20 +118,21 @@ namespace Insight {
         std::shared_ptr<PointerTypeInfoImpl> t = std::make_shared<PointerTypeInfoImpl>();
         ctx.types[die.get_offset()] = t;
 
-        std::unique_ptr<const Dwarf::Attribute> attrtype = die.get_attribute(DW_AT_type);
-        std::unique_ptr<const Dwarf::Attribute> attrsize = die.get_attribute(DW_AT_byte_size);
-        if (!attrsize)
+        auto attrtype = die.get_attribute(DW_AT_type);
+        auto attrsize = die.get_attribute(DW_AT_byte_size);
+        if (!attrsize) {
+            ctx.types.erase(die.get_offset());
             return nullptr;
+        }
 
-        if (!attrtype) {
-            t->set_type(VOID_TYPE);
-        } else {
-            std::shared_ptr<TypeInfo> subtype = tb.get_type(attrtype->as<Dwarf::Off>());
-            if (!subtype)
-                return nullptr;
-
-            t->set_type(subtype);
+        // pointers to types that are not described, such as functions, are
+        // left out along with their users
+        std::shared_ptr<TypeInfo> subtype = attrtype ? tb.get_type_attr(die) : ctx.registry.void_type_;
+        if (!subtype) {
+            ctx.types.erase(die.get_offset());
+            return nullptr;
         }
+        t->set_type(subtype);
 
         if (register_parent)
             t->set_parent(parent);
@@ -128,8 +148,10 @@ namespace Insight {
         ctx.types[die.get_offset()] = t;
 
         auto subtype = tb.get_type_attr(die);
-        if (!subtype)
+        if (!subtype) {
+            ctx.types.erase(die.get_offset());
             return nullptr;
+        }
 
         if (register_parent)
             t->set_parent(parent);
@@ -149,8 +171,10 @@ namespace Insight {
         ctx.types[die.get_offset()] = t;
 
         auto subtype = tb.get_type_attr(die);
-        if (!subtype)
+        if (!subtype) {
+            ctx.types.erase(die.get_offset());
             return nullptr;
+        }
 
         if (register_parent)
             t->set_parent(parent);
@@ -159,6 +183,10 @@ namespace Insight {
         return t;
     }
 
+    Type TypeBuilder::Visitor::operator()(Dwarf::TaggedDie<DW_TAG_array_type>& die) {
+        return build_array_type(die, tb, register_parent);
+    }
+
     TypeBuilder::Visitor::Visitor(TypeBuilder& tb, bool rp, BuildContext& c)
             : tb(tb), register_parent(rp), ctx(c)
     {}
@@ -173,15 +201,56 @@ namespace Insight {
         std::string name = die.get_name() ?: "";
 
         const auto it = ctx.types.find(die.get_offset());
+        auto attrsig = die.get_attribute(DW_AT_signature);
         if (it != ctx.types.end() && register_parent) {
             type = it->second;
 
             std::shared_ptr<MutableChild> child = std::dynamic_pointer_cast<MutableChild>(type);
-            child->set_parent(parent);
+            complete_published(ctx, [child, parent] { child->set_parent(parent); });
+        } else if (attrsig) {
+            // declarations standing for a type described in a type unit,
+            // which is built once for all the units referencing it
+            auto definition = attrsig->as_die();
+            type = definition ? get_type(*definition) : nullptr;
+            ctx.types[die.get_offset()] = type;
+            if (!type)
+                return nullptr;
+
+            adopt_published(ctx, die, type, register_parent ? parent : nullptr);
         } else {
-            Visitor visitor(*this, register_parent, ctx);
-            type = anydie.apply_visitor(visitor);
-            all_objects.push_back(type);
+            // types whose signature collides with that of a different type
+            // are built on their own
+            auto& canonical = ctx.registry.canonical_types_;
+            uint64_t signature = type_signature(ctx, die);
+            auto dup = signature ? canonical.find(signature) : canonical.end();
+            if (dup != canonical.end() && !same_shape(die, dup->second)) {
+                dup = canonical.end();
+                signature = 0;
+            }
+            if (dup != canonical.end()) {
+                type = dup->second.type;
+                ctx.types[die.get_offset()] = type;
+                adopt_published(ctx, die, type, register_parent ? parent : nullptr);
+            } else {
+                bool described = signature != 0;
+                Visitor visitor(*this, register_parent, ctx);
+                type = anydie.apply_visitor(visitor);
+
+                if (type && !signature)
+                    signature = derived_signature(*type);
+
+                auto it = signature ? canonical.find(signature) : canonical.end();
+                if (it != canonical.end() && described && !same_shape(die, it->second))
+                    it = canonical.end();
+                if (it != canonical.end()) {
+                    type = it->second.type;
+                    ctx.types[die.get_offset()] = type;
+                } else {
+                    if (type && signature && !canonical.count(signature))
+                        canonical[signature] = described ? canonical_type(die, type) : CanonicalType{type, 0, 0};
+                    ctx.registry.objects_.push_back(type);
+                }
+            }
         }
         if (type && register_parent) {
             add_type_to_parent(ctx, type);
@@ -189,21 +258,24 @@ namespace Insight {
             if (name.empty())
                 return type;
 
-            if (type_registry.count(type->fullname()) != 0)
+            if (ctx.registry.types_.count(type->fullname()) != 0)
                 return type;
 
             std::string unprefixed_name = type->fullname().substr(2, type->fullname().size() - 2);
 
-            type_registry[type->fullname()] = type;
-            type_registry[unprefixed_name] = type;
+            std::vector<std::string> names{type->fullname(), unprefixed_name};
 
             // Special cases for C compatibility
             switch (die.get_tag().get_id()) {
-                case DW_TAG_structure_type:     type_registry["struct " + unprefixed_name] = type; break;
-                case DW_TAG_enumeration_type:   type_registry["enum "   + unprefixed_name] = type; break;
-                case DW_TAG_union_type:         type_registry["union "  + unprefixed_name] = type; break;
+                case DW_TAG_structure_type:     names.push_back("struct " + unprefixed_name); break;
+                case DW_TAG_enumeration_type:   names.push_back("enum "   + unprefixed_name); break;
+                case DW_TAG_union_type:         names.push_back("union "  + unprefixed_name); break;
                 default: break;
             }
+            for (const std::string& key : names) {
+                ctx.registry.types_[key] = type;
+                ctx.registry.added_type(key);
+            }
         }
         return type;
     }
@@ -220,14 +292,14 @@ namespace Insight {
     std::shared_ptr<TypeInfo> TypeBuilder::get_type(Dwarf::Off offset) {
         auto it = ctx.types.find(offset);
         if (it == ctx.types.end()) {
-            std::shared_ptr<Dwarf::AnyDie> die = ctx.dbg.offdie(offset);
+            auto die = ctx.dbg.offdie(offset);
             return die ? build_type(*die, false) : nullptr;
         }
         return it->second;
     }
 
     std::shared_ptr<TypeInfo> TypeBuilder::get_type_attr(Dwarf::Die &die) {
-        std::unique_ptr<const Dwarf::Attribute> attr = die.get_attribute(DW_AT_type);
+        auto attr = die.get_attribute(DW_AT_type);
         if (!attr)
             return nullptr;
 
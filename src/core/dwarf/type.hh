@@ -40,6 +40,7 @@ namespace Insight {
             Type operator()(Dwarf::TaggedDie<DW_TAG_pointer_type>& die);
             Type operator()(Dwarf::TaggedDie<DW_TAG_const_type>& die);
             Type operator()(Dwarf::TaggedDie<DW_TAG_typedef>& die);
+            Type operator()(Dwarf::TaggedDie<DW_TAG_array_type>& die);
 
             template <typename T>
             Type operator()([[gnu::unused]] T& die) {
@@ -68,5 +69,6 @@ namespace Insight {
 # include "struct.hh"
 # include "enum.hh"
 # include "union.hh"
+# include "array.hh"
 
 #endif /* !INSIGHT_TYPE_HH */
@@ -27,7 +27,7 @@ namespace Insight {
         if (!type)
             return Result::SKIP;
 
-        std::shared_ptr<UnionFieldInfoImpl> finfo = std::make_shared<UnionFieldInfoImpl>(die.get_name(), type, info);
+        std::shared_ptr<UnionFieldInfoImpl> finfo = std::make_shared<UnionFieldInfoImpl>(die.get_name() ?: "", type, info);
         info->add_field(finfo);
 
         mark_element_line(tb.ctx, die, finfo);
@@ -41,7 +41,7 @@ namespace Insight {
 
         auto return_type = tb.get_type_attr(die);
         if (!return_type)
-            return_type = VOID_TYPE;
+            return_type = tb.ctx.registry.void_type_;
 
         std::shared_ptr<UnionMethodInfoImpl> method = std::make_shared<UnionMethodInfoImpl>(die.get_name(), return_type, info);
 
@@ -55,6 +55,7 @@ namespace Insight {
         auto it = tb.ctx.method_addresses.find(die.get_offset());
         if (it != tb.ctx.method_addresses.end()) {
             method->address_ = it->second;
+            method->bias_ = &tb.ctx.registry.bias_;
         }
 
         return Result::SKIP;
@@ -66,7 +67,7 @@ namespace Insight {
     {}
 
     std::shared_ptr<TypeInfo> build_union_type(Dwarf::Die &die, TypeBuilder& tb, bool register_parent) {
-        std::unique_ptr<const Dwarf::Attribute> attrsize = die.get_attribute(DW_AT_byte_size);
+        auto attrsize = die.get_attribute(DW_AT_byte_size);
         size_t size = !attrsize ? 0 : attrsize->as<Dwarf::Off>();
 
         std::shared_ptr<Container> parent = get_parent(tb.ctx);
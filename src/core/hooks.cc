@@ -0,0 +1,43 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <dlfcn.h>
+#include "core/core.hh"
+
+// Interposes dlopen and dlclose so that the metadata of libraries is added
+// as soon as they are loaded, and freed as soon as they are unloaded.
+extern "C" void* dlopen(const char* file, int mode) {
+    using dlopen_fn = void* (*)(const char*, int);
+    static dlopen_fn next = reinterpret_cast<dlopen_fn>(dlsym(RTLD_NEXT, "dlopen"));
+
+    void* handle = next(file, mode);
+    if (handle)
+        Insight::modules_changed();
+    return handle;
+}
+
+extern "C" int dlclose(void* handle) {
+    using dlclose_fn = int (*)(void*);
+    static dlclose_fn next = reinterpret_cast<dlclose_fn>(dlsym(RTLD_NEXT, "dlclose"));
+
+    int result = next(handle);
+    if (!result)
+        Insight::modules_changed();
+    return result;
+}
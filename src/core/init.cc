@@ -0,0 +1,123 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include "core/core.hh"
+#include "core/background.hh"
+#include "core/dwarf/dwarf.hh"
+
+extern "C" {
+    // defined by INSIGHT_MANUAL_INIT
+    [[gnu::weak]] extern const bool insight_manual_init;
+}
+
+namespace Insight {
+
+    namespace {
+
+        std::atomic<bool> initialized(false);
+
+        // set once the options of initialize() are stored in the registry
+        std::atomic<bool> configured(false);
+
+        std::vector<std::string> split_list(const char* list) {
+            std::vector<std::string> items;
+            if (!list)
+                return items;
+
+            std::string value(list);
+            size_t start = 0;
+            while (start <= value.size()) {
+                size_t end = value.find(',', start);
+                if (end == std::string::npos)
+                    end = value.size();
+                if (end > start)
+                    items.push_back(value.substr(start, end - start));
+                start = end + 1;
+            }
+            return items;
+        }
+
+    }
+
+    InitOptions InitOptions::from_environment() {
+        InitOptions options{InitMode::EAGER, LoadFilter(), false};
+
+        const char* mode = std::getenv("INSIGHT_INIT");
+        if (mode && std::strcmp(mode, "async") == 0)
+            options.mode = InitMode::ASYNC;
+        else if (mode && std::strcmp(mode, "manual") == 0)
+            options.mode = InitMode::MANUAL;
+
+        options.filter.units = split_list(std::getenv("INSIGHT_UNITS"));
+        options.filter.source_paths = split_list(std::getenv("INSIGHT_SOURCE_PATHS"));
+        options.filter.namespaces = split_list(std::getenv("INSIGHT_NAMESPACES"));
+
+        const char* lazy = std::getenv("INSIGHT_LAZY_MEMBERS");
+        options.lazy_members = lazy && std::strcmp(lazy, "1") == 0;
+        return options;
+    }
+
+    void initialize(const InitOptions& options) {
+        if (initialized.exchange(true))
+            throw std::logic_error("The metadata of the process is already initialized");
+
+        RegistryImpl& registry = default_registry();
+        {
+            std::lock_guard<std::mutex> guard(registry.modules_mutex_);
+            registry.filter_ = make_filter(options.filter);
+            registry.lazy_members_ = options.lazy_members;
+        }
+        configured = true;
+
+        switch (options.mode) {
+            case InitMode::EAGER:
+                update_modules();
+                break;
+            case InitMode::ASYNC:
+                BackgroundLoader::instance().start();
+                break;
+            case InitMode::MANUAL:
+                break;
+        }
+    }
+
+    // Libraries loaded before initialize() are read by it, or by the next
+    // update_modules() in manual mode.
+    void modules_changed() {
+        if (!configured)
+            return;
+        if (!BackgroundLoader::instance().update_later())
+            update_modules();
+    }
+
+}
+
+static class Init {
+public:
+    Init() {
+        Insight::InitOptions options = Insight::InitOptions::from_environment();
+        bool manual = &insight_manual_init && insight_manual_init;
+        if (!manual && options.mode != Insight::InitMode::MANUAL)
+            Insight::initialize(options);
+    }
+} init;
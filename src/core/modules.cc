@@ -0,0 +1,595 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <link.h>
+#include <sys/stat.h>
+#include "core/dwarf/dwarf.hh"
+#include "util/elf.hh"
+#include "core/background.hh"
+#include "ops/plan.hh"
+
+namespace Insight {
+
+    namespace {
+
+        struct LoadedObject {
+            std::string path;
+            uintptr_t bias;
+            uintptr_t start;        // address of its first segment
+            std::string build_id;
+        };
+
+        int collect_object(struct dl_phdr_info* info, [[gnu::unused]] size_t size, void* data) {
+            auto& objects = *static_cast<std::vector<LoadedObject>*>(data);
+
+            // the executable is reported first, without a name
+            std::string path = info->dlpi_name ? info->dlpi_name : "";
+            if (path.empty() && objects.empty()) {
+                char* executable = realpath("/proc/self/exe", nullptr);
+                path = executable ? executable : "/proc/self/exe";
+                free(executable);
+            }
+            if (path.empty())
+                return 0;
+
+            uintptr_t start = 0;
+            for (ElfW(Half) i = 0; i < info->dlpi_phnum; ++i) {
+                if (info->dlpi_phdr[i].p_type == PT_LOAD) {
+                    start = info->dlpi_addr + info->dlpi_phdr[i].p_vaddr;
+                    break;
+                }
+            }
+            objects.push_back(LoadedObject{path, info->dlpi_addr, start, loaded_build_id(*info)});
+            return 0;
+        }
+
+        // Inode of the file mapped at an address, zero if there is none.
+        ino_t mapped_inode(uintptr_t address) {
+            FILE* maps = fopen("/proc/self/maps", "r");
+            if (!maps)
+                return 0;
+
+            ino_t result = 0;
+            char line[4096];
+            while (fgets(line, sizeof (line), maps)) {
+                unsigned long start, end, inode;
+                if (sscanf(line, "%lx-%lx %*s %*s %*s %lu", &start, &end, &inode) == 3
+                        && start <= address && address < end) {
+                    result = inode;
+                    break;
+                }
+            }
+            fclose(maps);
+            return result;
+        }
+
+        bool same_file(const struct stat& a, const struct stat& b) {
+            return a.st_dev == b.st_dev && a.st_ino == b.st_ino && a.st_size == b.st_size
+                && a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+        }
+
+        // Whether the metadata of a module still describes an object. Without
+        // build id, a modified file only means that the object was reloaded
+        // once it is the file mapped in memory.
+        bool is_current(const Module& module, const LoadedObject& object) {
+            if (module.info.bias != object.bias || module.info.path != object.path)
+                return false;
+            if (!module.info.build_id.empty() || !object.build_id.empty())
+                return module.info.build_id == object.build_id;
+
+            struct stat st;
+            if (stat(object.path.c_str(), &st) != 0 || same_file(st, module.file))
+                return true;
+            return mapped_inode(object.start) != st.st_ino;
+        }
+
+        template <typename T, typename Entry>
+        bool add_member(RegistryImpl& registry, RangeCollection<T>& into, const Entry& entry,
+                        std::shared_ptr<NamespaceInfoImpl>& parent, Module& module) {
+            if (!into.emplace(entry.first, entry.second).second)
+                return false;
+            if (auto child = std::dynamic_pointer_cast<MutableChild>(entry.second))
+                child->set_parent(parent);
+            module.members.push_back(std::make_pair(parent, std::dynamic_pointer_cast<Named>(entry.second)));
+            registry.added_member(parent, module.members.back().second);
+            return true;
+        }
+
+        template <typename T>
+        void merge_member(RegistryImpl& registry, RangeCollection<T>& into, const RangeCollection<T>& from,
+                          const std::string& name, std::shared_ptr<NamespaceInfoImpl>& parent, Module& module) {
+            auto it = from.find(name);
+            if (it != from.end())
+                add_member(registry, into, *it, parent, module);
+        }
+
+        // The shared namespace of a full name, created with its parents.
+        std::shared_ptr<NamespaceInfoImpl> shared_namespace(RegistryImpl& registry, const std::string& fullname) {
+            if (fullname.empty())
+                return registry.root_;
+            auto it = registry.namespaces_.find(fullname);
+            if (it != registry.namespaces_.end())
+                return std::dynamic_pointer_cast<NamespaceInfoImpl>(it->second);
+
+            size_t separator = fullname.rfind("::");
+            std::shared_ptr<NamespaceInfoImpl> parent = shared_namespace(registry, fullname.substr(0, separator));
+            auto ns = std::make_shared<NamespaceInfoImpl>(fullname.substr(separator + 2).c_str(), parent);
+            parent->add_nested_namespace(ns);
+            registry.namespaces_[ns->fullname()] = ns;
+            registry.added_namespace(ns);
+            return ns;
+        }
+
+        // Adds the entries of a module under some keys to the shared ones,
+        // and returns the keys that were added.
+        template <typename Map>
+        std::vector<typename Map::key_type> merge_entries(Map& into, const Map& own,
+                                                          const std::vector<typename Map::key_type>& keys) {
+            std::vector<typename Map::key_type> merged;
+            for (auto& key : keys) {
+                auto it = own.find(key);
+                if (it != own.end() && into.insert(*it).second)
+                    merged.push_back(key);
+            }
+            return merged;
+        }
+
+        template <typename T>
+        bool erase_member(RangeCollection<T>& from, const std::string& name, const Named* element) {
+            auto it = from.find(name);
+            if (it == from.end() || dynamic_cast<const Named*>(it->second.get()) != element)
+                return false;
+            from.erase(it);
+            return true;
+        }
+
+        template <typename Map>
+        std::vector<typename Map::key_type> erase_entries(Map& from, const Map& own) {
+            std::vector<typename Map::key_type> erased;
+            for (auto& entry : own) {
+                auto it = from.find(entry.first);
+                if (it != from.end() && it->second == entry.second) {
+                    from.erase(it);
+                    erased.push_back(entry.first);
+                }
+            }
+            return erased;
+        }
+
+        const NamespaceInfoImpl* own_namespace(const RegistryImpl& own, const NamespaceInfoImpl& shared) {
+            if (shared.fullname().empty())
+                return own.root_.get();
+            auto it = own.namespaces_.find(shared.fullname());
+            if (it == own.namespaces_.end())
+                return nullptr;
+            return dynamic_cast<const NamespaceInfoImpl*>(it->second.get());
+        }
+
+        // Removes what a module added to the shared metadata. Names that were
+        // also defined by the other modules fall back to their definitions,
+        // which are looked up by name: the other modules are left as they are.
+        // The members of their structures may be being built meanwhile.
+        void unmerge_module(RegistryImpl& registry, Module& module) {
+            RegistryImpl& own = *module.registry;
+            std::lock_guard<std::recursive_mutex> guard(own.build_mutex_);
+            std::vector<std::shared_ptr<Module>> others;
+            for (auto& other : registry.modules_) {
+                if (other.get() != &module && other->registry)
+                    others.push_back(other);
+            }
+
+            for (auto& member : module.members) {
+                NamespaceInfoImpl& parent = *member.first;
+                const std::string& name = member.second->name();
+                bool type = erase_member(parent.types_, name, member.second.get());
+                bool function = erase_member(parent.functions_, name, member.second.get());
+                bool variable = erase_member(parent.variables_, name, member.second.get());
+                if (!type && !function && !variable)
+                    continue;
+
+                for (auto& other : others) {
+                    std::lock_guard<std::recursive_mutex> building(other->registry->build_mutex_);
+                    const NamespaceInfoImpl* from = own_namespace(*other->registry, parent);
+                    if (!from)
+                        continue;
+                    if (type)
+                        merge_member(registry, parent.types_, from->types_, name, member.first, *other);
+                    if (function)
+                        merge_member(registry, parent.functions_, from->functions_, name, member.first, *other);
+                    if (variable)
+                        merge_member(registry, parent.variables_, from->variables_, name, member.first, *other);
+                }
+            }
+            module.members.clear();
+
+            auto types = erase_entries(registry.types_, own.types_);
+            auto inferred = erase_entries(registry.inferred_types_, own.inferred_types_);
+            for (auto& other : others) {
+                std::lock_guard<std::recursive_mutex> building(other->registry->build_mutex_);
+                merge_entries(registry.types_, other->registry->types_, types);
+                merge_entries(registry.inferred_types_, other->registry->inferred_types_, inferred);
+            }
+            registry.types_["void"] = registry.void_type_;
+        }
+
+        // 64-bit FNV-1a
+        class Fingerprint {
+        public:
+            void add(const std::string& str) {
+                add_bytes(str.c_str(), str.size() + 1);
+            }
+
+            void add(uint64_t value) {
+                add_bytes(&value, sizeof (value));
+            }
+
+            uint64_t value() const {
+                return value_;
+            }
+
+        private:
+            void add_bytes(const void* data, size_t size) {
+                const unsigned char* bytes = static_cast<const unsigned char*>(data);
+                for (size_t i = 0; i < size; ++i) {
+                    value_ ^= bytes[i];
+                    value_ *= 0x100000001b3ull;
+                }
+            }
+
+            uint64_t value_ = 0xcbf29ce484222325ull;
+        };
+
+        // Publishes the units of a module read in the background while
+        // lookups wait for them. Units are built without locking the shared
+        // metadata, which is only locked to complete the elements that may
+        // already be published and to merge the unit.
+        class ModulePublisher : public UnitListener {
+        public:
+            ModulePublisher(RegistryImpl& registry, Module& module)
+                : registry_(registry)
+                , module_(module)
+            {}
+
+            std::vector<std::string> wanted() override {
+                return BackgroundLoader::instance().wanted();
+            }
+
+            bool begin_unit() override {
+                return !BackgroundLoader::instance().stopping();
+            }
+
+            void end_unit(const std::function<void()>& complete) override {
+                BackgroundLoader& loader = BackgroundLoader::instance();
+                bool publish = loader.has_waiters();
+                if (!complete && !publish)
+                    return;
+                {
+                    std::unique_lock<std::shared_timed_mutex> lock(registry_.lock_);
+                    if (complete)
+                        complete();
+                    publish = loader.has_waiters();
+                    if (publish)
+                        merge_module(registry_, module_);
+                }
+                if (publish)
+                    loader.published();
+            }
+
+        private:
+            RegistryImpl& registry_;
+            Module& module_;
+        };
+
+        void load_module(RegistryImpl& registry, Module& module) {
+            // stripped objects may have their debugging information installed
+            // in a separate file, the registry is still named after the object
+            std::string debug_file = find_debug_file(module.info.path);
+            if (debug_file.empty())
+                return;
+
+            module.registry = std::make_shared<RegistryImpl>(module.info.path);
+            module.registry->track_additions_ = true;
+            module.registry->loaded_ = true;
+            module.registry->filter_ = registry.filter_;
+            module.registry->lazy_members_ = registry.lazy_members_;
+            std::unique_ptr<ModulePublisher> publisher;
+            if (BackgroundLoader::in_loader_thread()) {
+                publisher.reset(new ModulePublisher(registry, module));
+                module.registry->listener_ = publisher.get();
+            }
+
+            try {
+                load_file(*module.registry, debug_file, module.info.bias);
+                module.registry->listener_ = nullptr;
+            } catch (const std::exception&) {
+                if (publisher) {
+                    // what was published of the module goes away with it
+                    publisher.reset();
+                    std::unique_lock<std::shared_timed_mutex> lock(registry.lock_);
+                    unmerge_module(registry, module);
+                }
+                module.registry = nullptr;
+            }
+        }
+
+
+        // Building the members of a structure may build more types, which
+        // are added to the registry. The parts of a registry are built too.
+        void build_all_members(RegistryImpl& registry) {
+            {
+                std::lock_guard<std::recursive_mutex> guard(registry.build_mutex_);
+                for (size_t i = 0; i < registry.objects_.size(); ++i) {
+                    if (auto* type = dynamic_cast<StructInfoImpl*>(registry.objects_[i].get()))
+                        type->materialize();
+                }
+            }
+
+            std::vector<std::shared_ptr<Module>> parts;
+            {
+                std::shared_lock<std::shared_timed_mutex> lock(registry.lock_);
+                parts = registry.modules_;
+            }
+            for (auto& part : parts) {
+                if (part->registry)
+                    build_all_members(*part->registry);
+            }
+        }
+
+    }
+
+    // Adds to the shared metadata what a module added since it was last
+    // merged, so that a module read in parts is merged in linear time.
+    // Names already defined by another module keep their definition, the
+    // module adds the last definition it read.
+    bool merge_module(RegistryImpl& registry, Module& module) {
+        RegistryImpl& own = *module.registry;
+        std::lock_guard<std::recursive_mutex> guard(own.build_mutex_);
+        Additions additions;
+        std::swap(additions, own.additions_);
+        if (additions.namespaces.empty() && additions.members.empty()
+                && additions.types.empty() && additions.inferred_types.empty())
+            return false;
+
+        for (auto& ns : additions.namespaces) {
+            std::shared_ptr<NamespaceInfoImpl> shared = shared_namespace(registry, ns->fullname());
+            shared->annotations_.insert(ns->annotations_.begin(), ns->annotations_.end());
+        }
+
+        for (auto& member : additions.members) {
+            const NamespaceInfoImpl& from = *member.first;
+            std::shared_ptr<NamespaceInfoImpl> shared = shared_namespace(registry, from.fullname());
+            const Named* element = member.second.get();
+            const std::string& name = element->name();
+            if (dynamic_cast<const TypeInfo*>(element))
+                merge_member(registry, shared->types_, from.types_, name, shared, module);
+            else if (dynamic_cast<const FunctionInfo*>(element))
+                merge_member(registry, shared->functions_, from.functions_, name, shared, module);
+            else if (dynamic_cast<const VariableInfo*>(element))
+                merge_member(registry, shared->variables_, from.variables_, name, shared, module);
+        }
+
+        for (auto& name : merge_entries(registry.types_, own.types_, additions.types))
+            registry.added_type(name);
+        for (auto address : merge_entries(registry.inferred_types_, own.inferred_types_, additions.inferred_types))
+            registry.added_inferred_type(address);
+        return true;
+    }
+
+    // The modules of a registry are only changed under its exclusive lock,
+    // its parts are merged into a module before the module is merged.
+    bool merge_modules(RegistryImpl& registry) {
+        bool merged = false;
+        for (auto& module : registry.modules_) {
+            RegistryImpl* own = module->registry.get();
+            if (!own)
+                continue;
+            {
+                std::unique_lock<std::shared_timed_mutex> lock(own->lock_);
+                std::lock_guard<std::recursive_mutex> guard(own->build_mutex_);
+                merge_modules(*own);
+            }
+            merged |= merge_module(registry, *module);
+        }
+        return merged;
+    }
+
+    // Split units are read without holding the lock of the modules, and
+    // merged unless their module was unloaded meanwhile.
+    bool SelfRegistryImpl::load_more() {
+        BackgroundLoader::instance().wait_until_done();
+        std::vector<std::shared_ptr<Module>> modules;
+        {
+            std::lock_guard<std::mutex> guard(modules_mutex_);
+            modules = modules_;
+        }
+
+        for (auto& module : modules) {
+            if (module->registry && module->registry->load_more()) {
+                std::unique_lock<std::shared_timed_mutex> lock(lock_);
+                if (std::find(modules_.begin(), modules_.end(), module) != modules_.end())
+                    merge_module(*this, *module);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void update_modules() {
+        std::vector<LoadedObject> objects;
+        dl_iterate_phdr(collect_object, &objects);
+
+        RegistryImpl& registry = default_registry();
+        std::lock_guard<std::mutex> guard(registry.modules_mutex_);
+
+        // modules of objects that were unloaded, or reloaded at their address
+        std::vector<std::shared_ptr<Module>> current;
+        std::vector<std::shared_ptr<Module>> stale;
+        for (auto& module : registry.modules_) {
+            bool found = false;
+            for (const LoadedObject& object : objects) {
+                if (is_current(*module, object)) {
+                    found = true;
+                    break;
+                }
+            }
+            (found ? current : stale).push_back(module);
+        }
+
+        // modules are read without blocking readers
+        std::vector<std::shared_ptr<Module>> fresh;
+        for (const LoadedObject& object : objects) {
+            bool known = false;
+            for (auto& module : current) {
+                if (module->info.bias == object.bias && module->info.path == object.path) {
+                    known = true;
+                    break;
+                }
+            }
+            if (known)
+                continue;
+
+            std::shared_ptr<Module> module = std::make_shared<Module>();
+            module->info = ModuleInfo{object.path, object.bias, false, object.build_id};
+            if (stat(object.path.c_str(), &module->file) != 0)
+                module->file = {};
+            load_module(registry, *module);
+            module->info.has_metadata = module->registry != nullptr;
+            fresh.push_back(module);
+        }
+
+        if (stale.empty() && fresh.empty())
+            return;
+
+        // and swapped in the shared metadata under a single lock, so that a
+        // reloaded object never appears partially or twice
+        {
+            std::unique_lock<std::shared_timed_mutex> lock(registry.lock_);
+            registry.modules_ = current;
+            for (auto& module : stale) {
+                if (module->registry)
+                    unmerge_module(registry, *module);
+            }
+            for (auto& module : fresh) {
+                if (module->registry)
+                    merge_module(registry, *module);
+                registry.modules_.push_back(module);
+            }
+        }
+        // the metadata of stale modules is freed here, outside of the lock
+        stale.clear();
+    }
+
+    // Members are built while lookups go on, what they add is merged once
+    // they are all built, or by the next lookup if the thread holds a
+    // RegistryReadLock.
+    void complete_metadata() {
+        RegistryImpl& registry = default_registry();
+        registry.load_all();
+
+        std::vector<std::shared_ptr<Module>> modules;
+        {
+            LookupLock lock(registry);
+            modules = registry.modules_;
+        }
+        for (auto& module : modules) {
+            if (module->registry)
+                build_all_members(*module->registry);
+        }
+
+        if (!LookupLock::can_load(registry)) {
+            registry.unmerged_ = true;
+            return;
+        }
+        std::unique_lock<std::shared_timed_mutex> lock(registry.lock_);
+        registry.unmerged_ = false;
+        merge_modules(registry);
+    }
+
+    std::vector<ModuleInfo> loaded_modules() {
+        RegistryImpl& registry = default_registry();
+        std::lock_guard<std::mutex> guard(registry.modules_mutex_);
+
+        std::vector<ModuleInfo> modules;
+        for (auto& module : registry.modules_)
+            modules.push_back(module->info);
+        return modules;
+    }
+
+    // Referenced types are described by their name only, so that the id of a
+    // type does not depend on the layout of the types it points to. Members
+    // are hashed separately, as their order of iteration is unspecified.
+    TypeId type_id(const TypeInfo& type) {
+        Fingerprint print;
+        print.add(type.fullname());
+        print.add(type.size_of());
+
+        std::vector<uint64_t> members;
+        auto member = [&](const std::string& name, const std::string& type_name, uint64_t position) {
+            Fingerprint member;
+            member.add(name);
+            member.add(type_name);
+            member.add(position);
+            members.push_back(member.value());
+        };
+
+        if (auto* info = dynamic_cast<const StructInfo*>(&type)) {
+            walk_members(*info,
+                [&](const StructInfo& super, size_t offset) {
+                    member("", super.fullname(), offset);
+                },
+                [&](const FieldInfo& field, size_t offset) {
+                    member(field.name(), field.type().fullname(), offset);
+                },
+                [&](size_t offset, size_t size) {
+                    member("", std::to_string(size), offset);
+                });
+        } else if (auto* info = dynamic_cast<const UnionInfo*>(&type)) {
+            for (auto& field : info->fields())
+                member(field.name(), field.type().fullname(), 0);
+        } else if (auto* info = dynamic_cast<const EnumInfo*>(&type)) {
+            for (auto& constant : info->values()) {
+                uint64_t value = 0;
+                std::memcpy(&value, constant.data_ptr(), std::min(sizeof (value), type.size_of()));
+                member(constant.name(), "", value);
+            }
+        } else if (auto* info = dynamic_cast<const ArrayTypeInfo*>(&type)) {
+            print.add(info->element_type().fullname());
+            print.add(info->length());
+        } else if (auto* info = dynamic_cast<const PointerTypeInfo*>(&type)) {
+            print.add(info->pointed_type().fullname());
+        } else if (auto* info = dynamic_cast<const ConstTypeInfo*>(&type)) {
+            print.add(info->type().fullname());
+        } else if (auto* info = dynamic_cast<const TypeDefInfo*>(&type)) {
+            print.add(info->aliased_type().fullname());
+        } else if (auto* info = dynamic_cast<const PrimitiveTypeInfo*>(&type)) {
+            print.add(static_cast<uint64_t>(info->kind()));
+        }
+
+        std::sort(members.begin(), members.end());
+        for (uint64_t value : members)
+            print.add(value);
+        return print.value();
+    }
+
+}
@@ -20,8 +20,10 @@
 #ifndef INSIGHT_INTERNAL_HH
 # define INSIGHT_INTERNAL_HH
 
-# include <libdwarf++/dwarf.hh>
+# include <atomic>
+# include <mutex>
 # include <unordered_set>
+# include <vector>
 # include "insight/types"
 # include "insight/range"
 
@@ -71,7 +73,7 @@
         }                                                               \
                                                                         \
         virtual Type& Name(std::string name) const override {           \
-            return *Name ## s_.at(name).lock();                         \
+            return *Name ## s_.at(name);                                \
         }                                                               \
                                                                         \
         virtual void add_ ## Name(std::weak_ptr<Type> Name) override {  \
@@ -81,11 +83,14 @@
         WeakRangeCollection<Type> Name ## s_;                           \
     }
 
-
-extern Dwarf::Debug &dbg;
-
 namespace Insight {
 
+    // Addresses read from the debugging information are link-time addresses,
+    // relocated by the load bias of their binary only when they are read.
+    inline void* relocated(void* address, const uintptr_t* bias) {
+        return address && bias ? static_cast<char*>(address) + *bias : address;
+    }
+
     template <class T>
     class NameBase : public T {
     public:
@@ -126,7 +131,7 @@ namespace Insight {
         ChildBase(std::string&& name, std::shared_ptr<Container> parent) : NameBase<AnnotationInfoContainerBase<T>>(parent->fullname(), name), parent_(parent) {}
 
         virtual Container& parent() const override {
-            return *parent_.lock();
+            return *parent_;
         }
 
         virtual void set_parent(std::shared_ptr<Container> parent) override {
@@ -134,7 +139,7 @@ namespace Insight {
             NameBase<AnnotationInfoContainerBase<T>>::set_fullname(parent->fullname(), this->name());
         }
 
-        std::weak_ptr<Container> parent_;
+        WeakRef<Container> parent_;
     };
 
     template <class T>
@@ -199,10 +204,10 @@ namespace Insight {
         {}
 
         virtual TypeInfo& type() const override {
-            return *type_.lock();
+            return *type_;
         }
 
-        std::weak_ptr<TypeInfo> type_;
+        WeakRef<TypeInfo> type_;
     };
 
     class FieldInfoImpl : public TypedBase<FieldInfo> {
@@ -224,6 +229,7 @@ namespace Insight {
         virtual void* address() const override;
 
         void* address_;
+        const uintptr_t* bias_;
     };
 
     template <class T>
@@ -232,16 +238,17 @@ namespace Insight {
         CallableBase(const char *name, std::weak_ptr<TypeInfo> return_type, std::shared_ptr<Container> parent)
                 : ChildBase<T>(std::string(name), parent)
                 , address_(nullptr)
+                , bias_(nullptr)
                 , return_type_(return_type)
                 , parameters_()
         {}
 
         virtual void* address() const override {
-            return address_;
+            return relocated(address_, bias_);
         }
 
         virtual TypeInfo& return_type() const override {
-            return *return_type_.lock();
+            return *return_type_;
         }
 
         virtual const Range<ParameterInfo> parameters() const override {
@@ -249,7 +256,8 @@ namespace Insight {
         }
 
         void* address_;
-        std::weak_ptr<TypeInfo> return_type_;
+        const uintptr_t* bias_;
+        WeakRef<TypeInfo> return_type_;
         RangeCollection<ParameterInfo> parameters_;
     };
 
@@ -275,15 +283,57 @@ namespace Insight {
         FunctionInfoImpl(const char *name, std::weak_ptr<TypeInfo> return_type, std::shared_ptr<Container> parent);
     };
 
+    class StructInfoImpl;
+
+    // Builds the members of the types whose members are only built on first
+    // access.
+    class MemberLoader {
+    public:
+        virtual ~MemberLoader() {}
+        virtual void load_members(StructInfoImpl& type) = 0;
+    };
+
     class StructInfoImpl : public TypeBase<StructTypeBase> {
     public:
         StructInfoImpl(std::string& name, size_t size);
 
+        virtual const Range<FieldInfo> fields() const override;
+        virtual FieldInfo& field(std::string name) const override;
+        virtual const Range<MethodInfo> methods() const override;
+        virtual MethodInfo& method(std::string name) const override;
+        virtual const WeakRange<StructInfo> supertypes() const override;
+        virtual StructInfo& supertype(std::string name) const override;
+        virtual const Range<TypeInfo> types() const override;
+        virtual TypeInfo& type(std::string name) const override;
+        virtual const Range<FunctionInfo> functions() const override;
+        virtual FunctionInfo& function(std::string name) const override;
+        virtual const Range<VariableInfo> variables() const override;
+        virtual VariableInfo& variable(std::string name) const override;
+
         virtual bool is_supertype(const TypeInfo &type) const override;
         virtual bool is_ancestor(const TypeInfo &type) const override;
-        virtual void add_supertype(std::weak_ptr<StructInfo> supertype) override;
-
-        std::unordered_set<std::string> ancestors_;
+        void add_supertype(std::weak_ptr<StructInfo> supertype, size_t offset);
+
+        // Builds the members if they were left to be built on first access.
+        void materialize() const;
+
+        // The names of the ancestors, gathered on first use rather than when
+        // the supertypes are added, which would build the members of the bases.
+        const std::unordered_set<std::string>& ancestors() const;
+
+        std::unordered_map<std::string, size_t> supertype_offsets_;
+        std::vector<size_t> opaque_fields_;
+        size_t alignment_;
+
+        // where the members are read from until they are built: the DIE of
+        // the type, and those of its duplicates in other units
+        std::weak_ptr<MemberLoader> member_loader_;
+        uint64_t die_offset_;
+        std::vector<uint64_t> duplicates_;
+        bool building_;
+        mutable std::atomic<bool> materialized_;
+        mutable std::once_flag ancestors_once_;
+        mutable std::unordered_set<std::string> ancestors_;
     };
 
     class UnionInfoImpl : public TypeBase<UnionTypeBase> {
@@ -313,7 +363,7 @@ namespace Insight {
 
         void set_type(std::shared_ptr<TypeInfo>& type);
 
-        std::weak_ptr<TypeInfo> type_;
+        WeakRef<TypeInfo> type_;
     };
 
     class ConstTypeInfoImpl : public TypeBase<ConstTypeInfo> {
@@ -324,7 +374,19 @@ namespace Insight {
 
         void set_type(std::shared_ptr<TypeInfo>& type);
 
-        std::weak_ptr<TypeInfo> type_;
+        WeakRef<TypeInfo> type_;
+    };
+
+    class ArrayTypeInfoImpl : public TypeBase<ArrayTypeInfo> {
+    public:
+        ArrayTypeInfoImpl();
+        virtual TypeInfo& element_type() const override;
+        virtual size_t length() const override;
+
+        void set_type(std::shared_ptr<TypeInfo>& type, size_t length);
+
+        WeakRef<TypeInfo> type_;
+        size_t length_;
     };
 
     class TypeDefInfoImpl : public TypeBase<TypeDefInfo> {
@@ -335,7 +397,7 @@ namespace Insight {
 
         void set_type(std::shared_ptr<TypeInfo>& type);
 
-        std::weak_ptr<TypeInfo> type_;
+        WeakRef<TypeInfo> type_;
     };
 
     class NamespaceInfoImpl : public ChildBase<NamespaceBase<NamespaceInfo>> {
@@ -354,7 +416,8 @@ namespace Insight {
         void set_annotated(std::shared_ptr<Annotated>& annotated);
 
         void* data_;
-        std::weak_ptr<Annotated> annotated_;
+        const uintptr_t* bias_;
+        WeakRef<Annotated> annotated_;
     };
 
     class EnumConstantInfoImpl : public NameBase<EnumConstantInfo> {
@@ -364,7 +427,7 @@ namespace Insight {
         virtual EnumInfo& type() const override;
 
         void* data_;
-        std::weak_ptr<EnumInfo> type_;
+        WeakRef<EnumInfo> type_;
     };
 
     class EnumInfoImpl : public TypeBase<EnumConstantInfoContainerBase<EnumInfo>> {
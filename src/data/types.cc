@@ -72,16 +72,23 @@ namespace Insight {
     VariableInfoImpl::VariableInfoImpl(const char *name, void* address, std::weak_ptr<TypeInfo> type, std::shared_ptr<Container> parent)
         : TypedBase<VariableInfo>(name, type, parent)
         , address_(address)
+        , bias_(nullptr)
     {}
 
     void* VariableInfoImpl::address() const {
-        return address_;
+        return relocated(address_, bias_);
     }
 
     // StructInfo
 
     StructInfoImpl::StructInfoImpl(std::string& name, size_t size)
         : TypeBase(name, size)
+        , alignment_(0)
+        , member_loader_()
+        , die_offset_(0)
+        , duplicates_()
+        , building_(false)
+        , materialized_(true)
     {}
 
     UnionInfoImpl::UnionInfoImpl(std::string &name, size_t size)
@@ -128,7 +135,7 @@ namespace Insight {
     {}
 
     TypeInfo &PointerTypeInfoImpl::pointed_type() const {
-        return *type_.lock();
+        return *type_;
     }
 
     ConstTypeInfoImpl::ConstTypeInfoImpl(std::shared_ptr<TypeInfo>& type)
@@ -142,7 +149,7 @@ namespace Insight {
     {}
 
     TypeInfo &ConstTypeInfoImpl::type() const {
-        return *type_.lock();
+        return *type_;
     }
 
     TypeDefInfoImpl::TypeDefInfoImpl(const char* name, std::shared_ptr<TypeInfo>& type)
@@ -151,7 +158,7 @@ namespace Insight {
     {}
 
     TypeInfo &TypeDefInfoImpl::aliased_type() const {
-        return *type_.lock();
+        return *type_;
     }
 
     TypeDefInfoImpl::TypeDefInfoImpl(const char *name)
@@ -173,22 +180,120 @@ namespace Insight {
         type_ = type;
     }
 
+    ArrayTypeInfoImpl::ArrayTypeInfoImpl()
+        : TypeBase()
+        , type_()
+        , length_(0)
+    {}
+
+    TypeInfo &ArrayTypeInfoImpl::element_type() const {
+        return *type_;
+    }
+
+    size_t ArrayTypeInfoImpl::length() const {
+        return length_;
+    }
+
+    void ArrayTypeInfoImpl::set_type(std::shared_ptr<TypeInfo> &type, size_t length) {
+        type_ = type;
+        length_ = length;
+        size_ = type->size_of() * length;
+        name_ = type->name() + "[" + std::to_string(length) + "]";
+    }
+
+    void StructInfoImpl::materialize() const {
+        if (materialized_.load(std::memory_order_acquire))
+            return;
+        if (auto loader = member_loader_.lock())
+            loader->load_members(const_cast<StructInfoImpl&>(*this));
+    }
+
+    const Range<FieldInfo> StructInfoImpl::fields() const {
+        materialize();
+        return Range<FieldInfo>(fields_);
+    }
+
+    FieldInfo& StructInfoImpl::field(std::string name) const {
+        materialize();
+        return *fields_.at(name);
+    }
+
+    const Range<MethodInfo> StructInfoImpl::methods() const {
+        materialize();
+        return Range<MethodInfo>(methods_);
+    }
+
+    MethodInfo& StructInfoImpl::method(std::string name) const {
+        materialize();
+        return *methods_.at(name);
+    }
+
+    const WeakRange<StructInfo> StructInfoImpl::supertypes() const {
+        materialize();
+        return WeakRange<StructInfo>(supertypes_);
+    }
+
+    StructInfo& StructInfoImpl::supertype(std::string name) const {
+        materialize();
+        return *supertypes_.at(name);
+    }
+
+    const Range<TypeInfo> StructInfoImpl::types() const {
+        materialize();
+        return Range<TypeInfo>(types_);
+    }
+
+    TypeInfo& StructInfoImpl::type(std::string name) const {
+        materialize();
+        return *types_.at(name);
+    }
+
+    const Range<FunctionInfo> StructInfoImpl::functions() const {
+        materialize();
+        return Range<FunctionInfo>(functions_);
+    }
+
+    FunctionInfo& StructInfoImpl::function(std::string name) const {
+        materialize();
+        return *functions_.at(name);
+    }
+
+    const Range<VariableInfo> StructInfoImpl::variables() const {
+        materialize();
+        return Range<VariableInfo>(variables_);
+    }
+
+    VariableInfo& StructInfoImpl::variable(std::string name) const {
+        materialize();
+        return *variables_.at(name);
+    }
+
     bool StructInfoImpl::is_supertype(const TypeInfo &type) const {
+        materialize();
         return supertypes_.count(type.name()) > 0;
     }
 
     bool StructInfoImpl::is_ancestor(const TypeInfo &type) const {
-        if (auto* t = dynamic_cast<const StructInfoImpl*>(&type)) {
-            return t->ancestors_.count(name_) > 0;
-        }
+        if (auto* t = dynamic_cast<const StructInfoImpl*>(&type))
+            return t->ancestors().count(name_) > 0;
         return false;
     }
 
-    void StructInfoImpl::add_supertype(std::weak_ptr<StructInfo> supertype) {
+    const std::unordered_set<std::string>& StructInfoImpl::ancestors() const {
+        std::call_once(ancestors_once_, [this] {
+            materialize();
+            for (auto& supertype : supertypes_) {
+                ancestors_.insert(supertype.first);
+                if (auto* t = dynamic_cast<const StructInfoImpl*>(supertype.second.get()))
+                    ancestors_.insert(t->ancestors().begin(), t->ancestors().end());
+            }
+        });
+        return ancestors_;
+    }
+
+    void StructInfoImpl::add_supertype(std::weak_ptr<StructInfo> supertype, size_t offset) {
         SupertypeContainerBase::add_supertype(supertype);
-        auto t = std::dynamic_pointer_cast<StructInfoImpl>(supertype.lock());
-        ancestors_.insert(t->name());
-        ancestors_.insert(t->ancestors_.begin(), t->ancestors_.end());
+        supertype_offsets_[supertype.lock()->name()] = offset;
     }
 
     UnspecifiedTypeInfoImpl::UnspecifiedTypeInfoImpl(const char *name)
@@ -198,14 +303,15 @@ namespace Insight {
     AnnotationInfoImpl::AnnotationInfoImpl(std::string name, void* data, std::weak_ptr<TypeInfo> type)
         : TypedBase(name, type)
         , data_(data)
+        , bias_(nullptr)
     {}
 
     void* AnnotationInfoImpl::data_ptr() const {
-        return data_;
+        return relocated(data_, bias_);
     }
 
     Annotated &AnnotationInfoImpl::annotated_element() const {
-        return *annotated_.lock();
+        return *annotated_;
     }
 
     void AnnotationInfoImpl::set_annotated(std::shared_ptr<Annotated> &annotated) {
@@ -223,7 +329,7 @@ namespace Insight {
     }
 
     EnumInfo& EnumConstantInfoImpl::type() const {
-        return *type_.lock();
+        return *type_;
     }
 
     EnumInfoImpl::EnumInfoImpl(std::string name, size_t size)
@@ -0,0 +1,213 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <link.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "insight/coredump"
+#include "util/elf.hh"
+
+namespace Insight {
+
+    namespace {
+
+        struct MappedFile {
+            uintptr_t start;
+            uintptr_t end;
+            uint64_t offset;
+            std::string path;
+        };
+
+        // Files mapped by the process, from the NT_FILE note: a count and a
+        // page size, then a (start, end, page offset) triple per mapping,
+        // followed by the same number of NUL terminated paths.
+        std::vector<MappedFile> parse_file_note(const char* desc, size_t size) {
+            std::vector<MappedFile> files;
+            const ElfW(Addr)* words = reinterpret_cast<const ElfW(Addr)*>(desc);
+            if (size < 2 * sizeof (ElfW(Addr)))
+                return files;
+
+            size_t count = words[0];
+            size_t page_size = words[1];
+            if ((2 + 3 * count) * sizeof (ElfW(Addr)) > size)
+                return files;
+
+            const char* name = desc + (2 + 3 * count) * sizeof (ElfW(Addr));
+            const char* end = desc + size;
+            for (size_t i = 0; i < count && name < end; ++i) {
+                const ElfW(Addr)* entry = words + 2 + 3 * i;
+                size_t length = strnlen(name, end - name);
+                files.push_back(MappedFile{entry[0], entry[1], entry[2] * page_size, std::string(name, length)});
+                name += length + 1;
+            }
+            return files;
+        }
+
+        size_t align_note(size_t size) {
+            return (size + 3) & ~static_cast<size_t>(3);
+        }
+
+    }
+
+    CoreAddressSpace::CoreAddressSpace(const std::string& path)
+        : data_(nullptr)
+        , size_(0)
+        , map_()
+        , entry_(0)
+        , offsets_()
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw std::runtime_error("Could not open " + path);
+
+        struct stat st;
+        void* data = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+            data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+            throw std::runtime_error("Could not map " + path);
+
+        data_ = static_cast<const char*>(data);
+        size_ = st.st_size;
+
+        const ElfW(Ehdr)* ehdr = reinterpret_cast<const ElfW(Ehdr)*>(data_);
+        if (size_ < sizeof (*ehdr) || std::memcmp(ehdr->e_ident, ELFMAG, SELFMAG)
+                || ehdr->e_ident[EI_CLASS] != (sizeof (void*) == 8 ? ELFCLASS64 : ELFCLASS32)
+                || ehdr->e_type != ET_CORE
+                || ehdr->e_phentsize != sizeof (ElfW(Phdr))
+                || ehdr->e_phoff + ehdr->e_phnum * sizeof (ElfW(Phdr)) > size_) {
+            munmap(const_cast<char*>(data_), size_);
+            throw std::runtime_error(path + " is not a core file");
+        }
+
+        const ElfW(Phdr)* phdrs = reinterpret_cast<const ElfW(Phdr)*>(data_ + ehdr->e_phoff);
+
+        std::vector<MappedFile> files;
+        for (size_t i = 0; i < ehdr->e_phnum; ++i) {
+            const ElfW(Phdr)& phdr = phdrs[i];
+            if (phdr.p_type != PT_NOTE || phdr.p_offset + phdr.p_filesz > size_)
+                continue;
+
+            size_t off = phdr.p_offset;
+            size_t end = phdr.p_offset + phdr.p_filesz;
+            while (off + sizeof (ElfW(Nhdr)) <= end) {
+                const ElfW(Nhdr)* note = reinterpret_cast<const ElfW(Nhdr)*>(data_ + off);
+                size_t desc = off + sizeof (*note) + align_note(note->n_namesz);
+                if (desc + note->n_descsz > end)
+                    break;
+                if (note->n_type == NT_FILE)
+                    files = parse_file_note(data_ + desc, note->n_descsz);
+                else if (note->n_type == NT_AUXV)
+                    entry_ = auxv_entry(data_ + desc, note->n_descsz);
+                off = desc + align_note(note->n_descsz);
+            }
+        }
+
+        // Segments that were not dumped have no file contents, and only the
+        // dumped part of a segment is readable.
+        std::vector<std::pair<MemoryRegion, size_t>> segments;
+        for (size_t i = 0; i < ehdr->e_phnum; ++i) {
+            const ElfW(Phdr)& phdr = phdrs[i];
+            if (phdr.p_type != PT_LOAD || !phdr.p_filesz || phdr.p_offset + phdr.p_filesz > size_)
+                continue;
+
+            MemoryRegion region;
+            region.start = phdr.p_vaddr;
+            region.end = phdr.p_vaddr + phdr.p_filesz;
+            region.readable = true;
+            region.writable = phdr.p_flags & PF_W;
+            region.offset = 0;
+            for (const MappedFile& file : files) {
+                if (region.start >= file.start && region.start < file.end) {
+                    region.offset = file.offset + (region.start - file.start);
+                    region.path = file.path;
+                    break;
+                }
+            }
+            segments.push_back(std::make_pair(region, phdr.p_offset));
+        }
+        std::sort(segments.begin(), segments.end(), [](const std::pair<MemoryRegion, size_t>& a, const std::pair<MemoryRegion, size_t>& b) {
+            return a.first.start < b.first.start;
+        });
+
+        std::vector<MemoryRegion> regions;
+        for (auto& segment : segments) {
+            regions.push_back(segment.first);
+            offsets_.push_back(segment.second);
+        }
+        map_ = MemoryMap(std::move(regions));
+    }
+
+    CoreAddressSpace::~CoreAddressSpace() {
+        munmap(const_cast<char*>(data_), size_);
+    }
+
+    const MemoryMap& CoreAddressSpace::map() const {
+        return map_;
+    }
+
+    const void* CoreAddressSpace::translate(uintptr_t address, size_t size) const {
+        const MemoryRegion* r = map_.find(address);
+        if (!r || size > r->end - address)
+            return nullptr;
+        return data_ + offsets_[r - map_.regions().data()] + (address - r->start);
+    }
+
+    uintptr_t CoreAddressSpace::entry() const {
+        return entry_;
+    }
+
+    void CoreAddressSpace::read(Read* reads, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            Read& r = reads[i];
+            if (const void* src = translate(r.address, r.size)) {
+                std::memcpy(r.buffer, src, r.size);
+                r.ok = true;
+                continue;
+            }
+
+            // the range spans several segments
+            r.ok = map_.readable(r.address, r.size);
+            for (size_t done = 0; r.ok && done < r.size;) {
+                const MemoryRegion* region = map_.find(r.address + done);
+                size_t chunk = std::min(r.size - done, static_cast<size_t>(region->end - (r.address + done)));
+                std::memcpy(static_cast<char*>(r.buffer) + done, translate(r.address + done, chunk), chunk);
+                done += chunk;
+            }
+        }
+    }
+
+    CoreDump::CoreDump(const std::string& core, const std::string& executable)
+        : Target(executable)
+        , memory_(core)
+    {
+        relocate(memory_.entry());
+    }
+
+    CoreAddressSpace& CoreDump::memory() {
+        return memory_;
+    }
+
+}
@@ -0,0 +1,138 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include "insight/memory"
+
+namespace Insight {
+
+    MemoryMap::MemoryMap()
+        : regions_()
+    {}
+
+    MemoryMap::MemoryMap(std::vector<MemoryRegion> regions)
+        : regions_(std::move(regions))
+    {
+        std::sort(regions_.begin(), regions_.end(), [](const MemoryRegion& a, const MemoryRegion& b) {
+            return a.start < b.start;
+        });
+    }
+
+    static MemoryMap load(const std::string& path) {
+        std::vector<MemoryRegion> regions;
+        std::ifstream maps(path);
+
+        // start-end perms offset dev inode [path]
+        std::string line;
+        while (std::getline(maps, line)) {
+            std::istringstream in(line);
+            std::string range, perms, offset, dev, inode, path;
+            in >> range >> perms >> offset >> dev >> inode;
+            std::getline(in >> std::ws, path);
+
+            size_t dash = range.find('-');
+            if (dash == std::string::npos || perms.size() < 2)
+                continue;
+
+            MemoryRegion region;
+            region.start = std::stoull(range.substr(0, dash), nullptr, 16);
+            region.end = std::stoull(range.substr(dash + 1), nullptr, 16);
+            region.readable = perms[0] == 'r';
+            region.writable = perms[1] == 'w';
+            region.offset = std::stoull(offset, nullptr, 16);
+            region.path = path;
+            regions.push_back(region);
+        }
+        return MemoryMap(std::move(regions));
+    }
+
+    MemoryMap MemoryMap::self() {
+        return load("/proc/self/maps");
+    }
+
+    MemoryMap MemoryMap::of(pid_t pid) {
+        return load("/proc/" + std::to_string(pid) + "/maps");
+    }
+
+    const MemoryRegion* MemoryMap::find(uintptr_t address) const {
+        // lookups tend to hit the same region repeatedly. The hint is per
+        // thread so that maps can be searched concurrently, and is only used
+        // when it designates a region of this map.
+        static thread_local const MemoryRegion* last = nullptr;
+        auto first = reinterpret_cast<uintptr_t>(regions_.data());
+        auto hint = reinterpret_cast<uintptr_t>(last);
+        if (hint >= first && hint < first + regions_.size() * sizeof (MemoryRegion)
+                && address >= last->start && address < last->end)
+            return last;
+
+        auto it = std::upper_bound(regions_.begin(), regions_.end(), address, [](uintptr_t addr, const MemoryRegion& r) {
+            return addr < r.start;
+        });
+        if (it == regions_.begin())
+            return nullptr;
+        --it;
+        if (address >= it->end)
+            return nullptr;
+
+        last = &*it;
+        return last;
+    }
+
+    bool MemoryMap::readable(uintptr_t address, size_t size) const {
+        uintptr_t end = address + size;
+        if (end < address)
+            return false;
+
+        // objects may span several adjacent mappings
+        while (address < end || !size) {
+            const MemoryRegion* r = find(address);
+            if (!r || !r->readable)
+                return false;
+            if (!size)
+                return true;
+            address = r->end;
+        }
+        return true;
+    }
+
+    const std::vector<MemoryRegion>& MemoryMap::regions() const {
+        return regions_;
+    }
+
+    LocalAddressSpace::LocalAddressSpace()
+        : map_(MemoryMap::self())
+    {}
+
+    const MemoryMap& LocalAddressSpace::map() const {
+        return map_;
+    }
+
+    void LocalAddressSpace::read(Read* reads, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            Read& r = reads[i];
+            r.ok = map_.readable(r.address, r.size);
+            if (r.ok)
+                std::memcpy(r.buffer, reinterpret_cast<const void*>(r.address), r.size);
+        }
+    }
+
+}
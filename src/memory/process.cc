@@ -0,0 +1,119 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <sys/uio.h>
+#include "insight/process"
+#include "util/elf.hh"
+
+namespace Insight {
+
+    ProcessAddressSpace::ProcessAddressSpace(pid_t pid)
+        : pid_(pid)
+        , map_(MemoryMap::of(pid))
+        , entry_(0)
+    {
+        std::ifstream in("/proc/" + std::to_string(pid) + "/auxv", std::ios::binary);
+        std::string auxv((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        entry_ = auxv_entry(auxv.data(), auxv.size());
+    }
+
+    const MemoryMap& ProcessAddressSpace::map() const {
+        return map_;
+    }
+
+    void ProcessAddressSpace::refresh() {
+        map_ = MemoryMap::of(pid_);
+    }
+
+    pid_t ProcessAddressSpace::pid() const {
+        return pid_;
+    }
+
+    uintptr_t ProcessAddressSpace::entry() const {
+        return entry_;
+    }
+
+    // Reads are issued as scatter/gather batches of up to IOV_MAX elements.
+    // The kernel stops at the first remote element it cannot read, so a
+    // short count tells which element failed and the batch resumes after it.
+    void ProcessAddressSpace::read(Read* reads, size_t count) {
+        std::vector<struct iovec> local;
+        std::vector<struct iovec> remote;
+        std::vector<Read*> pending;
+
+        for (size_t i = 0; i < count; ++i) {
+            reads[i].ok = false;
+            if (reads[i].size && map_.readable(reads[i].address, reads[i].size))
+                pending.push_back(&reads[i]);
+        }
+
+        size_t next = 0;
+        while (next < pending.size()) {
+            size_t n = std::min(pending.size() - next, static_cast<size_t>(IOV_MAX));
+            local.resize(n);
+            remote.resize(n);
+            for (size_t i = 0; i < n; ++i) {
+                Read& r = *pending[next + i];
+                local[i] = {r.buffer, r.size};
+                remote[i] = {reinterpret_cast<void*>(r.address), r.size};
+            }
+
+            ssize_t done = process_vm_readv(pid_, local.data(), n, remote.data(), n, 0);
+            if (done < 0) {
+                if (errno != EFAULT)
+                    return;
+                done = 0;
+            }
+
+            size_t i = 0;
+            for (size_t left = done; i < n && pending[next + i]->size <= left; ++i) {
+                pending[next + i]->ok = true;
+                left -= pending[next + i]->size;
+            }
+            // skip the element that failed
+            next += std::min(i + 1, n);
+        }
+    }
+
+    Process::Process(pid_t pid)
+        : Process(pid, "/proc/" + std::to_string(pid) + "/exe")
+    {}
+
+    Process::Process(pid_t pid, const std::string& executable)
+        : Target(executable)
+        , memory_(pid)
+    {
+        relocate(memory_.entry());
+    }
+
+    pid_t Process::pid() const {
+        return memory_.pid();
+    }
+
+    ProcessAddressSpace& Process::memory() {
+        return memory_;
+    }
+
+}
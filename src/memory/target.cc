@@ -0,0 +1,67 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "insight/target"
+#include "core/core.hh"
+#include "util/elf.hh"
+
+namespace Insight {
+
+    Target::Target(const std::string& executable)
+        : executable_(executable)
+        , registry_(load_registry(executable))
+    {}
+
+    Target::~Target() {}
+
+    // The addresses of the metadata are relocated to the address space of
+    // the target, rather than to that of the current process.
+    void Target::relocate(uintptr_t entry) {
+        static_cast<RegistryImpl&>(*registry_).bias_ = executable_load_bias(executable_, entry);
+    }
+
+    Registry& Target::registry() const {
+        return *registry_;
+    }
+
+    NamespaceInfo& Target::root_namespace() const {
+        return registry_->root_namespace();
+    }
+
+    TypeInfo& Target::find_type(const std::string& name) const {
+        return registry_->find_type(name);
+    }
+
+    NamespaceInfo& Target::find_namespace(const std::string& name) const {
+        return registry_->find_namespace(name);
+    }
+
+    uintptr_t Target::load_bias() const {
+        return static_cast<RegistryImpl&>(*registry_).bias_;
+    }
+
+    uintptr_t Target::address_of(const VariableInfo& variable) const {
+        return reinterpret_cast<uintptr_t>(variable.address());
+    }
+
+    bool Target::read(const VariableInfo& variable, void* buffer) {
+        return memory().read(address_of(variable), buffer, variable.type().size_of());
+    }
+
+}
@@ -0,0 +1,297 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include "insight/clone"
+#include "plan.hh"
+
+namespace Insight {
+
+    struct CopyPlan {
+        struct Step {
+            enum Kind { POINTER, STRING, REPEAT };
+
+            Kind kind;
+            size_t offset;
+            size_t stride;          // stride of a REPEAT
+            size_t count;           // number of REPEAT iterations
+            const CopyPlan* plan;   // plan of the pointee or of the repeated element
+        };
+
+        size_t size;
+
+        // objects are first copied with a single memcpy, then the steps
+        // patch the pointers that need to be followed; an object without
+        // any step is trivially copyable.
+        std::vector<Step> steps;
+    };
+
+    class CopyPlanCache : public PlanCache {
+    public:
+        const CopyPlan& get(const TypeInfo& type) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const CopyPlan& plan = lookup(type);
+            prune_repeats(compiled_);
+            return plan;
+        }
+
+        void forget(const std::unordered_set<const TypeInfo*>& types) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            forget_plans(plans_, types);
+        }
+
+    private:
+        using Step = CopyPlan::Step;
+
+        const CopyPlan& lookup(const TypeInfo& type) {
+            auto it = plans_.find(&type);
+            if (it != plans_.end())
+                return *it->second;
+
+            CopyPlan* plan = new CopyPlan();
+            plans_[&type].reset(plan);
+            compiled_.push_back(plan);
+
+            plan->size = resolve_alias(type).size_of();
+            compile(type, 0, false, plan->steps);
+            return *plan;
+        }
+
+        static bool is_const_pointee(const TypeInfo& type) {
+            const TypeInfo* t = &type;
+            while (auto* td = dynamic_cast<const TypeDefInfo*>(t))
+                t = &td->aliased_type();
+            return dynamic_cast<const ConstTypeInfo*>(t) != nullptr;
+        }
+
+        // string tells whether the member is annotated with CString.
+        void compile(const TypeInfo& t, size_t base, bool string, std::vector<Step>& steps) {
+            const TypeInfo& type = resolve_alias(t);
+
+            if (auto* info = dynamic_cast<const StructInfo*>(&type)) {
+                walk_members(*info,
+                    [&](const StructInfo& super, size_t offset) {
+                        compile(super, base + offset, false, steps);
+                    },
+                    [&](const FieldInfo& field, size_t offset) {
+                        if (!is_vtable_pointer(field))
+                            compile(field.type(), base + offset, find_annotation(field, "CString") != nullptr, steps);
+                    },
+                    [](size_t, size_t) {});
+            } else if (auto* info = dynamic_cast<const PointerTypeInfo*>(&type)) {
+                if (is_const_pointee(info->pointed_type()))
+                    return;
+
+                const TypeInfo& pointee = resolve_alias(info->pointed_type());
+                // the length of what a char pointer points to is unknown
+                auto* prim = dynamic_cast<const PrimitiveTypeInfo*>(&pointee);
+                if (prim && (prim->kind() == CHAR || prim->kind() == UNSIGNED_CHAR)) {
+                    if (string)
+                        steps.push_back(Step{Step::STRING, base, 0, 0, nullptr});
+                } else if (pointee.size_of() > 0) {
+                    steps.push_back(Step{Step::POINTER, base, 0, 0, &lookup(pointee)});
+                }
+            } else if (auto* info = dynamic_cast<const ArrayTypeInfo*>(&type)) {
+                const TypeInfo& element = resolve_alias(info->element_type());
+                const CopyPlan& plan = lookup(element);
+                if (info->length() > 0)
+                    steps.push_back(Step{Step::REPEAT, base, element.size_of(), info->length(), &plan});
+            }
+        }
+
+        std::mutex mutex_;
+        std::unordered_map<const TypeInfo*, std::unique_ptr<CopyPlan>> plans_;
+        std::vector<CopyPlan*> compiled_;   // not pruned yet
+    };
+
+    static CopyPlanCache plan_cache;
+
+    static void* allocate(size_t size) {
+        return ::operator new(size ? size : 1);
+    }
+
+    static inline void*& pointer_at(void* base, size_t offset) {
+        return *reinterpret_cast<void**>(static_cast<char*>(base) + offset);
+    }
+
+    // Objects are copied from a work list rather than recursively, so that
+    // long linked structures do not recurse as deep as they are long. Each
+    // copied block is recorded by its address range, and a pointer into a
+    // block that was already copied is redirected into its copy.
+    struct Copier {
+        using Step = CopyPlan::Step;
+
+        struct Pending {
+            const CopyPlan* plan;
+            const char* src;
+            char* dst;
+        };
+
+        void* copy(const CopyPlan& plan, const void* src, size_t count) {
+            void* dst = allocate(plan.size * count);
+            std::memcpy(dst, src, plan.size * count);
+            record(src, plan.size * count, dst);
+
+            if (!plan.steps.empty()) {
+                for (size_t i = 0; i < count; ++i) {
+                    size_t off = i * plan.size;
+                    pending.push_back(Pending{&plan, static_cast<const char*>(src) + off, static_cast<char*>(dst) + off});
+                }
+            }
+            return dst;
+        }
+
+        void* copy_string(const char* src) {
+            size_t len = std::strlen(src) + 1;
+            void* dst = allocate(len);
+            std::memcpy(dst, src, len);
+            record(src, len, dst);
+            return dst;
+        }
+
+        void record(const void* src, size_t size, void* dst) {
+            copies.emplace(static_cast<const char*>(src), Block{size, static_cast<char*>(dst)});
+        }
+
+        void* find(const void* target) const {
+            auto* p = static_cast<const char*>(target);
+            auto it = copies.upper_bound(p);
+            if (it == copies.begin())
+                return nullptr;
+            --it;
+            if (p >= it->first + it->second.size)
+                return nullptr;
+            return it->second.dst + (p - it->first);
+        }
+
+        void patch(const CopyPlan& plan, const char* src, char* dst) {
+            for (const Step& step : plan.steps) {
+                if (step.kind == Step::REPEAT) {
+                    for (size_t i = 0; i < step.count; ++i) {
+                        size_t off = step.offset + i * step.stride;
+                        patch(*step.plan, src + off, dst + off);
+                    }
+                    continue;
+                }
+
+                void* target = pointer_at(dst, step.offset);
+                if (!target)
+                    continue;
+
+                if (void* moved = find(target))
+                    pointer_at(dst, step.offset) = moved;
+                else if (step.kind == Step::STRING)
+                    pointer_at(dst, step.offset) = copy_string(static_cast<const char*>(target));
+                else
+                    pointer_at(dst, step.offset) = copy(*step.plan, target, 1);
+            }
+        }
+
+        void run() {
+            while (!pending.empty()) {
+                Pending p = pending.back();
+                pending.pop_back();
+                patch(*p.plan, p.src, p.dst);
+            }
+        }
+
+        struct Block {
+            size_t size;
+            char* dst;
+        };
+
+        std::map<const char*, Block> copies;
+        std::vector<Pending> pending;
+    };
+
+    void* clone_(const void* instances, const TypeInfo& type, size_t count) {
+        size_t size = resolve_alias(type).size_of() * count;
+        void* dst = allocate(size);
+        std::memcpy(dst, instances, size);
+        return dst;
+    }
+
+    void* deep_clone_(const void* instances, const TypeInfo& type, size_t count) {
+        const CopyPlan& plan = plan_cache.get(type);
+
+        Copier copier;
+        void* dst = copier.copy(plan, instances, count);
+        copier.run();
+        return dst;
+    }
+
+    // Blocks of a copy by address, with the largest extent they were reached
+    // with. A pointer into another block is not an allocation of its own.
+    using Blocks = std::map<char*, size_t>;
+
+    static void collect(const CopyPlan& plan, char* obj, Blocks& blocks, std::vector<std::pair<const CopyPlan*, char*>>& pending) {
+        for (const CopyPlan::Step& step : plan.steps) {
+            if (step.kind == CopyPlan::Step::REPEAT) {
+                for (size_t i = 0; i < step.count; ++i)
+                    collect(*step.plan, obj + step.offset + i * step.stride, blocks, pending);
+                continue;
+            }
+
+            char* target = static_cast<char*>(pointer_at(obj, step.offset));
+            if (!target)
+                continue;
+            size_t size = step.kind == CopyPlan::Step::STRING ? std::strlen(target) + 1 : step.plan->size;
+            auto inserted = blocks.emplace(target, size);
+            if (!inserted.second) {
+                inserted.first->second = std::max(inserted.first->second, size);
+                continue;
+            }
+            if (step.kind == CopyPlan::Step::POINTER)
+                pending.emplace_back(step.plan, target);
+        }
+    }
+
+    void deep_free_(void* instances, const TypeInfo& type, size_t count) {
+        if (!instances)
+            return;
+
+        const CopyPlan& plan = plan_cache.get(type);
+
+        Blocks blocks;
+        std::vector<std::pair<const CopyPlan*, char*>> pending;
+
+        blocks.emplace(static_cast<char*>(instances), plan.size * count);
+        for (size_t i = 0; i < count; ++i)
+            pending.emplace_back(&plan, static_cast<char*>(instances) + i * plan.size);
+
+        while (!pending.empty()) {
+            auto p = pending.back();
+            pending.pop_back();
+            collect(*p.first, p.second, blocks, pending);
+        }
+
+        char* end = nullptr;
+        for (auto& block : blocks) {
+            if (block.first < end)
+                continue;
+            ::operator delete(block.first);
+            end = block.first + block.second;
+        }
+    }
+
+}
@@ -0,0 +1,393 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include "insight/hash"
+#include "plan.hh"
+
+namespace Insight {
+
+    struct HashPlan {
+        struct Step {
+            enum Kind { BYTES, POINTER, REPEAT };
+
+            Kind kind;
+            size_t offset;
+            size_t size;            // length of a BYTES block, stride of a REPEAT
+            size_t count;           // number of REPEAT iterations
+            const HashPlan* plan;   // plan of the pointee or of the repeated element
+        };
+
+        std::vector<Step> steps;
+    };
+
+    class HashPlanCache : public PlanCache {
+    public:
+        const HashPlan& get(const TypeInfo& type, PointerPolicy policy) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const HashPlan& plan = lookup(type, policy);
+            prune_repeats(compiled_);
+            return plan;
+        }
+
+        void forget(const std::unordered_set<const TypeInfo*>& types) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& plans : plans_)
+                forget_plans(plans, types);
+        }
+
+    private:
+        using Step = HashPlan::Step;
+
+        const HashPlan& lookup(const TypeInfo& type, PointerPolicy policy) {
+            auto& plans = plans_[static_cast<int>(policy)];
+            auto it = plans.find(&type);
+            if (it != plans.end())
+                return *it->second;
+
+            // register the plan before compiling it so that self-referencing
+            // types resolve to it instead of recursing forever.
+            HashPlan* plan = new HashPlan();
+            plans[&type].reset(plan);
+            compiled_.push_back(plan);
+
+            compile(type, 0, policy, plan->steps);
+            coalesce(plan->steps);
+            return *plan;
+        }
+
+        void bytes(std::vector<Step>& steps, size_t offset, size_t size) {
+            if (size)
+                steps.push_back(Step{Step::BYTES, offset, size, 0, nullptr});
+        }
+
+        void compile(const TypeInfo& t, size_t base, PointerPolicy policy, std::vector<Step>& steps) {
+            const TypeInfo& type = resolve_alias(t);
+
+            if (auto* info = dynamic_cast<const StructInfo*>(&type)) {
+                walk_members(*info,
+                    [&](const StructInfo& super, size_t offset) {
+                        compile(super, base + offset, policy, steps);
+                    },
+                    [&](const FieldInfo& field, size_t offset) {
+                        if (is_vtable_pointer(field))
+                            bytes(steps, base + offset, field.type().size_of());
+                        else
+                            compile(field.type(), base + offset, policy, steps);
+                    },
+                    [&](size_t offset, size_t size) {
+                        bytes(steps, base + offset, size);
+                    });
+            } else if (auto* info = dynamic_cast<const PrimitiveTypeInfo*>(&type)) {
+                // x87 extended precision values only use 10 of their bytes
+                size_t size = info->size_of();
+                bool x87 = std::numeric_limits<long double>::digits == 64;
+                if (x87 && info->kind() == LONG_DOUBLE) {
+                    bytes(steps, base, 10);
+                } else if (x87 && info->kind() == LONG_DOUBLE_COMPLEX) {
+                    bytes(steps, base, 10);
+                    bytes(steps, base + size / 2, 10);
+                } else {
+                    bytes(steps, base, size);
+                }
+            } else if (auto* info = dynamic_cast<const PointerTypeInfo*>(&type)) {
+                const TypeInfo& pointee = resolve_alias(info->pointed_type());
+                if (policy == PointerPolicy::FOLLOW && pointee.size_of() > 0)
+                    steps.push_back(Step{Step::POINTER, base, info->size_of(), 0, &lookup(pointee, policy)});
+                else
+                    bytes(steps, base, info->size_of());
+            } else if (auto* info = dynamic_cast<const ArrayTypeInfo*>(&type)) {
+                const TypeInfo& element = resolve_alias(info->element_type());
+                size_t stride = element.size_of();
+                const HashPlan& plan = lookup(element, policy);
+
+                if (plan.steps.size() == 1 && plan.steps[0].kind == Step::BYTES
+                        && plan.steps[0].offset == 0 && plan.steps[0].size == stride) {
+                    bytes(steps, base, stride * info->length());
+                } else if (info->length() > 0) {
+                    steps.push_back(Step{Step::REPEAT, base, stride, info->length(), &plan});
+                }
+            } else {
+                // enums, unions and unspecified types are opaque blocks
+                bytes(steps, base, type.size_of());
+            }
+        }
+
+        // merge contiguous blocks so that padding-free regions are handled
+        // with a single memcmp or hash round.
+        void coalesce(std::vector<Step>& steps) {
+            std::stable_sort(steps.begin(), steps.end(), [](const Step& a, const Step& b) {
+                return a.offset < b.offset;
+            });
+
+            std::vector<Step> merged;
+            for (auto& step : steps) {
+                if (!merged.empty() && step.kind == Step::BYTES && merged.back().kind == Step::BYTES) {
+                    Step& last = merged.back();
+                    if (step.offset <= last.offset + last.size) {
+                        last.size = std::max(last.size, step.offset + step.size - last.offset);
+                        continue;
+                    }
+                }
+                merged.push_back(step);
+            }
+            steps.swap(merged);
+        }
+
+        std::mutex mutex_;
+        std::unordered_map<const TypeInfo*, std::unique_ptr<HashPlan>> plans_[2];
+        std::vector<HashPlan*> compiled_;   // not pruned yet
+    };
+
+    static HashPlanCache plan_cache;
+
+    static inline uint64_t load_word(const unsigned char* p) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof (v));
+        return v;
+    }
+
+    static inline uint64_t mix(uint64_t h, uint64_t v) {
+        h ^= v;
+        h *= 0x9e3779b97f4a7c15ull;
+        return h ^ (h >> 32);
+    }
+
+    // Blocks are consumed a word at a time on two independent lanes so
+    // that the multiplications of consecutive words can overlap.
+    static uint64_t hash_block(uint64_t h, const unsigned char* p, size_t size) {
+        uint64_t a = h;
+        uint64_t b = h ^ size;
+        for (; size >= 16; p += 16, size -= 16) {
+            a = mix(a, load_word(p));
+            b = mix(b, load_word(p + 8));
+        }
+        if (size >= 8) {
+            a = mix(a, load_word(p));
+            p += 8;
+            size -= 8;
+        }
+        if (size) {
+            uint64_t tail = 0;
+            std::memcpy(&tail, p, size);
+            b = mix(b, tail);
+        }
+        return mix(a, b);
+    }
+
+    struct PairHash {
+        template <typename A, typename B>
+        size_t operator()(const std::pair<A, B>& pair) const {
+            return mix(mix(0, reinterpret_cast<uintptr_t>(pair.first)), reinterpret_cast<uintptr_t>(pair.second));
+        }
+    };
+
+    struct Walker {
+        using Step = HashPlan::Step;
+
+        // compare() holds cycles to be equal when they unfold into the same
+        // infinite tree, so a self-loop equals a two-node cycle of the same
+        // values. Hashing the unfolding up to the back-edges would tell them
+        // apart. Instead, every object reachable from the root is a node,
+        // labelled by its own bytes and refined a few times by the labels of
+        // its successors, and the hash covers the label of the root and the
+        // set of the labels of the graph, which only depend on the unfolding.
+        static const int refinements = 3;
+
+        struct Node {
+            const HashPlan* plan;
+            const unsigned char* at;
+            uint64_t label;
+            std::vector<size_t> successors;
+        };
+
+        static const size_t null = SIZE_MAX;
+
+        uint64_t label(const HashPlan& plan, const unsigned char* p, uint64_t h, std::vector<size_t>& successors) {
+            for (const Step& step : plan.steps) {
+                const unsigned char* at = p + step.offset;
+                switch (step.kind) {
+                    case Step::BYTES:
+                        h = hash_block(h, at, step.size);
+                        break;
+                    case Step::REPEAT:
+                        for (size_t i = 0; i < step.count; ++i, at += step.size)
+                            h = label(*step.plan, at, h, successors);
+                        break;
+                    case Step::POINTER: {
+                        auto* target = *reinterpret_cast<const unsigned char* const*>(at);
+                        h = mix(h, target != nullptr);
+                        successors.push_back(target ? node(*step.plan, target) : null);
+                    } break;
+                }
+            }
+            return h;
+        }
+
+        size_t node(const HashPlan& plan, const unsigned char* p) {
+            auto inserted = index.emplace(std::make_pair(p, &plan), nodes.size());
+            if (inserted.second)
+                nodes.push_back(Node{&plan, p, 0, {}});
+            return inserted.first->second;
+        }
+
+        uint64_t hash(const HashPlan& plan, const unsigned char* p) {
+            node(plan, p);
+            for (size_t i = 0; i < nodes.size(); ++i) {
+                std::vector<size_t> successors;
+                uint64_t h = label(*nodes[i].plan, nodes[i].at, 0, successors);
+                nodes[i].label = h;
+                nodes[i].successors.swap(successors);
+            }
+
+            std::vector<uint64_t> labels(nodes.size());
+            for (int round = 0; round < refinements; ++round) {
+                for (size_t i = 0; i < nodes.size(); ++i) {
+                    uint64_t h = nodes[i].label;
+                    for (size_t succ : nodes[i].successors)
+                        h = mix(h, succ == null ? 0 : nodes[succ].label);
+                    labels[i] = h;
+                }
+                for (size_t i = 0; i < nodes.size(); ++i)
+                    nodes[i].label = labels[i];
+            }
+
+            std::sort(labels.begin(), labels.end());
+            labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+            uint64_t h = nodes[0].label;
+            for (uint64_t l : labels)
+                h = mix(h, l);
+            return h;
+        }
+
+        // Objects are compared from a stack rather than recursively, so that
+        // long linked structures do not recurse as deep as they are long.
+        // Each frame goes through the steps of a plan, once per element of a
+        // repetition.
+        struct Frame {
+            const HashPlan* plan;
+            const unsigned char* lhs;
+            const unsigned char* rhs;
+            size_t step;
+            size_t count;           // elements left, this one included
+            size_t stride;
+            bool pointed;           // whether the pair is being compared
+        };
+
+        int compare(const HashPlan& plan, const unsigned char* lhs, const unsigned char* rhs) {
+            std::vector<Frame> stack{Frame{&plan, lhs, rhs, 0, 1, 0, false}};
+            while (!stack.empty()) {
+                Frame& frame = stack.back();
+                if (frame.step == frame.plan->steps.size()) {
+                    if (--frame.count) {
+                        frame.lhs += frame.stride;
+                        frame.rhs += frame.stride;
+                        frame.step = 0;
+                        continue;
+                    }
+                    if (frame.pointed)
+                        pairs.erase(std::make_pair(frame.lhs, frame.rhs));
+                    stack.pop_back();
+                    continue;
+                }
+
+                const Step& step = frame.plan->steps[frame.step++];
+                const unsigned char* l = frame.lhs + step.offset;
+                const unsigned char* r = frame.rhs + step.offset;
+                int res = 0;
+                switch (step.kind) {
+                    case Step::BYTES:
+                        res = std::memcmp(l, r, step.size);
+                        break;
+                    case Step::REPEAT:
+                        if (step.count)
+                            stack.push_back(Frame{step.plan, l, r, 0, step.count, step.size, false});
+                        break;
+                    case Step::POINTER: {
+                        auto* lt = *reinterpret_cast<const unsigned char* const*>(l);
+                        auto* rt = *reinterpret_cast<const unsigned char* const*>(r);
+                        if (lt == rt)
+                            break;
+                        if (!lt || !rt) {
+                            res = lt ? 1 : -1;
+                            break;
+                        }
+                        // pairs already being compared are assumed equal
+                        if (pairs.insert(std::make_pair(lt, rt)).second)
+                            stack.push_back(Frame{step.plan, lt, rt, 0, 1, 0, true});
+                    } break;
+                }
+                if (res) {
+                    for (const Frame& pending : stack) {
+                        if (pending.pointed)
+                            pairs.erase(std::make_pair(pending.lhs, pending.rhs));
+                    }
+                    return res;
+                }
+            }
+            return 0;
+        }
+
+        std::vector<Node> nodes;
+        std::unordered_map<std::pair<const unsigned char*, const HashPlan*>, size_t, PairHash> index;
+        std::unordered_set<std::pair<const unsigned char*, const unsigned char*>, PairHash> pairs;
+    };
+
+    size_t hash_(const void* instance, const TypeInfo& type, PointerPolicy policy) {
+        const HashPlan& plan = plan_cache.get(type, policy);
+        auto* p = static_cast<const unsigned char*>(instance);
+
+        if (plan.steps.size() == 1 && plan.steps[0].kind == HashPlan::Step::BYTES)
+            return hash_block(0, p + plan.steps[0].offset, plan.steps[0].size);
+
+        Walker walker;
+        if (policy == PointerPolicy::ADDRESS) {
+            std::vector<size_t> none;
+            return walker.label(plan, p, 0, none);
+        }
+        return walker.hash(plan, p);
+    }
+
+    int compare_(const void* lhs, const void* rhs, const TypeInfo& type, PointerPolicy policy) {
+        const HashPlan& plan = plan_cache.get(type, policy);
+        auto* l = static_cast<const unsigned char*>(lhs);
+        auto* r = static_cast<const unsigned char*>(rhs);
+
+        if (l == r)
+            return 0;
+
+        if (plan.steps.size() == 1 && plan.steps[0].kind == HashPlan::Step::BYTES)
+            return std::memcmp(l + plan.steps[0].offset, r + plan.steps[0].offset, plan.steps[0].size);
+
+        Walker walker;
+        if (policy == PointerPolicy::FOLLOW)
+            walker.pairs.emplace(l, r);
+        return walker.compare(plan, l, r);
+    }
+
+    bool equals_(const void* lhs, const void* rhs, const TypeInfo& type, PointerPolicy policy) {
+        return compare_(lhs, rhs, type, policy) == 0;
+    }
+
+}
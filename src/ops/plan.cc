@@ -0,0 +1,58 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <mutex>
+#include "plan.hh"
+
+namespace Insight {
+
+    namespace {
+
+        // Never destroyed, as registries may be freed after the caches
+        // during the static destruction.
+        struct Caches {
+            std::mutex mutex;
+            std::vector<PlanCache*> caches;
+        };
+
+        Caches& caches() {
+            static Caches* caches = new Caches();
+            return *caches;
+        }
+
+    }
+
+    PlanCache::PlanCache() {
+        std::lock_guard<std::mutex> lock(caches().mutex);
+        caches().caches.push_back(this);
+    }
+
+    PlanCache::~PlanCache() {
+        std::lock_guard<std::mutex> lock(caches().mutex);
+        auto& list = caches().caches;
+        list.erase(std::remove(list.begin(), list.end(), this), list.end());
+    }
+
+    void forget_plans(const std::unordered_set<const TypeInfo*>& types) {
+        std::lock_guard<std::mutex> lock(caches().mutex);
+        for (PlanCache* cache : caches().caches)
+            cache->forget(types);
+    }
+
+}
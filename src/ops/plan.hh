@@ -0,0 +1,222 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef INSIGHT_PLAN_HH
+# define INSIGHT_PLAN_HH
+
+# include <algorithm>
+# include <cstddef>
+# include <memory>
+# include <unordered_map>
+# include <unordered_set>
+# include <vector>
+# include "data/internal.hh"
+
+namespace Insight {
+
+    // Typedefs and const qualifiers do not change the representation of an
+    // object, so plans are always compiled against the underlying type.
+    inline const TypeInfo& resolve_alias(const TypeInfo& type) {
+        const TypeInfo* t = &type;
+        for (;;) {
+            if (auto* td = dynamic_cast<const TypeDefInfo*>(t))
+                t = &td->aliased_type();
+            else if (auto* ct = dynamic_cast<const ConstTypeInfo*>(t))
+                t = &ct->type();
+            else
+                return *t;
+        }
+    }
+
+    inline const AnnotationInfo* find_annotation(const Annotated& element, const std::string& name) {
+        for (auto& annotation : element.annotations()) {
+            if (annotation.name() == name)
+                return &annotation;
+        }
+        return nullptr;
+    }
+
+    inline bool is_vtable_pointer(const FieldInfo& field) {
+        return field.name().compare(0, 5, "_vptr") == 0;
+    }
+
+    // Calls base_fn(type, offset) for each direct base subobject and
+    // field_fn(field, offset) for each field of a structure, then reports
+    // the byte ranges of the members whose type could not be described
+    // through opaque_fn(offset, size).
+    template <typename BaseFn, typename FieldFn, typename OpaqueFn>
+    void walk_members(const StructInfo& info, BaseFn base_fn, FieldFn field_fn, OpaqueFn opaque_fn) {
+        std::vector<size_t> starts;
+        auto* impl = dynamic_cast<const StructInfoImpl*>(&info);
+
+        for (auto& super : info.supertypes()) {
+            size_t offset = 0;
+            if (impl) {
+                auto it = impl->supertype_offsets_.find(super.name());
+                if (it != impl->supertype_offsets_.end())
+                    offset = it->second;
+            }
+            starts.push_back(offset);
+            base_fn(super, offset);
+        }
+
+        for (auto& field : info.fields()) {
+            starts.push_back(field.offset());
+            field_fn(field, field.offset());
+        }
+
+        if (!impl)
+            return;
+
+        starts.insert(starts.end(), impl->opaque_fields_.begin(), impl->opaque_fields_.end());
+
+        // an opaque member extends up to the next known member
+        for (size_t off : impl->opaque_fields_) {
+            size_t end = info.size_of();
+            for (size_t s : starts) {
+                if (s > off && s < end)
+                    end = s;
+            }
+            if (end > off)
+                opaque_fn(off, end - off);
+        }
+    }
+
+    // Plans are cached by the address of the type they were compiled from,
+    // so they have to go before the type does: a type allocated at the same
+    // address afterwards would get them. Caches register themselves, and
+    // registries make them forget their types before freeing them.
+    class PlanCache {
+    public:
+        PlanCache();
+        virtual ~PlanCache();
+
+        PlanCache(const PlanCache&) = delete;
+        PlanCache& operator=(const PlanCache&) = delete;
+
+        virtual void forget(const std::unordered_set<const TypeInfo*>& types) = 0;
+    };
+
+    void forget_plans(const std::unordered_set<const TypeInfo*>& types);
+
+    // Drops the plans of some types, and those referring to them through
+    // the plan of a step.
+    template <typename Plan>
+    void forget_plans(std::unordered_map<const TypeInfo*, std::unique_ptr<Plan>>& plans,
+                      const std::unordered_set<const TypeInfo*>& types) {
+        std::unordered_set<const Plan*> dropped;
+        for (auto& entry : plans) {
+            if (types.count(entry.first))
+                dropped.insert(entry.second.get());
+        }
+
+        for (bool more = !dropped.empty(); more;) {
+            more = false;
+            for (auto& entry : plans) {
+                if (dropped.count(entry.second.get()))
+                    continue;
+                for (auto& step : entry.second->steps) {
+                    if (step.plan && dropped.count(step.plan)) {
+                        dropped.insert(entry.second.get());
+                        more = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        for (auto it = plans.begin(); it != plans.end();) {
+            if (dropped.count(it->second.get()))
+                it = plans.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    // Drops the repetitions of elements that need no step. The plan of an
+    // element may still be being compiled when an array of it is compiled,
+    // so they are dropped once all the plans are. Repetitions never form a
+    // cycle, as an object cannot contain itself.
+    template <typename Plan>
+    void prune_repeats(Plan& plan, std::unordered_set<const Plan*>& pruned) {
+        if (!pruned.insert(&plan).second)
+            return;
+        auto& steps = plan.steps;
+        for (auto& step : steps) {
+            if (step.kind == Plan::Step::REPEAT)
+                prune_repeats(const_cast<Plan&>(*step.plan), pruned);
+        }
+        steps.erase(std::remove_if(steps.begin(), steps.end(), [](const typename Plan::Step& step) {
+            return step.kind == Plan::Step::REPEAT && step.plan->steps.empty();
+        }), steps.end());
+    }
+
+    template <typename Plan>
+    void prune_repeats(std::vector<Plan*>& compiled) {
+        std::unordered_set<const Plan*> pruned;
+        for (Plan* plan : compiled)
+            prune_repeats(*plan, pruned);
+        compiled.clear();
+    }
+
+    // DWARF only records explicit alignments, so the natural alignment of a
+    // type is inferred from the alignment of its members.
+    inline size_t alignment_of(const TypeInfo& t) {
+        const TypeInfo& type = resolve_alias(t);
+
+        if (auto* info = dynamic_cast<const StructInfo*>(&type)) {
+            size_t align = 1;
+            auto* impl = dynamic_cast<const StructInfoImpl*>(info);
+            if (impl && impl->alignment_)
+                align = impl->alignment_;
+
+            walk_members(*info,
+                [&](const StructInfo& super, size_t) {
+                    align = std::max(align, alignment_of(super));
+                },
+                [&](const FieldInfo& field, size_t) {
+                    align = std::max(align, alignment_of(field.type()));
+                },
+                [](size_t, size_t) {});
+            return align;
+        } else if (auto* info = dynamic_cast<const UnionInfo*>(&type)) {
+            size_t align = 1;
+            for (auto& field : info->fields())
+                align = std::max(align, alignment_of(field.type()));
+            return align;
+        } else if (auto* info = dynamic_cast<const ArrayTypeInfo*>(&type)) {
+            return alignment_of(info->element_type());
+        }
+
+        size_t size = type.size_of();
+        if (auto* info = dynamic_cast<const PrimitiveTypeInfo*>(&type)) {
+            if (info->kind() & COMPLEX)
+                size /= 2;
+        }
+
+        // scalars are aligned on their size, rounded down to a power of two
+        size_t align = 1;
+        while (align * 2 <= size && align * 2 <= alignof(std::max_align_t))
+            align *= 2;
+        return align;
+    }
+
+}
+
+#endif /* !INSIGHT_PLAN_HH */
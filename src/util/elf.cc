@@ -0,0 +1,533 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#ifdef INSIGHT_HAVE_ZSTD
+# include <zstd.h>
+#endif
+#include "elf.hh"
+
+#ifndef ELFCOMPRESS_ZSTD
+# define ELFCOMPRESS_ZSTD 2
+#endif
+
+namespace Insight {
+
+    static const char* const DEBUG_DIRECTORY = "/usr/lib/debug";
+
+    // Compressed sections are inflated by at least this much at a time, to
+    // amortize the calls for small units.
+    static const size_t DECOMPRESSION_CHUNK = 64 * 1024;
+
+    DebugSection::DebugSection(const char* data, size_t size)
+        : compression_(NONE)
+        , compressed_(data)
+        , compressed_size_(size)
+        , size_(size)
+        , available_(size)
+        , consumed_(size)
+        , stream_(nullptr)
+        , time_(0)
+    {}
+
+    DebugSection::DebugSection(Compression compression, const char* data, size_t size, size_t decompressed_size)
+        : compression_(compression)
+        , compressed_(data)
+        , compressed_size_(size)
+        , size_(decompressed_size)
+        , available_(0)
+        , consumed_(0)
+        , stream_(nullptr)
+        , time_(0)
+    {}
+
+    DebugSection::~DebugSection() {
+        if (!stream_)
+            return;
+        if (compression_ == ZLIB) {
+            z_stream* stream = static_cast<z_stream*>(stream_);
+            inflateEnd(stream);
+            delete stream;
+        }
+#ifdef INSIGHT_HAVE_ZSTD
+        if (compression_ == ZSTD)
+            ZSTD_freeDStream(static_cast<ZSTD_DStream*>(stream_));
+#endif
+    }
+
+    size_t DebugSection::size() const {
+        return size_;
+    }
+
+    size_t DebugSection::compressed_size() const {
+        return compressed_size_;
+    }
+
+    DebugSection::Compression DebugSection::compression() const {
+        return compression_;
+    }
+
+    const char* DebugSection::data() {
+        return data(size_);
+    }
+
+    const char* DebugSection::data(size_t end) {
+        if (compression_ == NONE)
+            return compressed_;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (end > available_) {
+            auto start = std::chrono::steady_clock::now();
+            decompress(std::min(size_, std::max(end, available_ + DECOMPRESSION_CHUNK)));
+            time_ += std::chrono::steady_clock::now() - start;
+        }
+        return buffer_.get();
+    }
+
+    // The buffer is allocated once for the whole section, so that the
+    // pointers returned earlier stay valid. Its pages are only committed as
+    // they are written.
+    void DebugSection::decompress(size_t end) {
+        if (!buffer_)
+            buffer_.reset(new char[size_]);
+
+        if (compression_ == ZLIB) {
+            z_stream* stream = static_cast<z_stream*>(stream_);
+            if (!stream) {
+                stream = new z_stream();
+                if (inflateInit(stream) != Z_OK) {
+                    delete stream;
+                    throw std::runtime_error("Could not initialize zlib");
+                }
+                stream_ = stream;
+            }
+
+            while (available_ < end) {
+                stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed_ + consumed_));
+                stream->avail_in = static_cast<uInt>(std::min<size_t>(compressed_size_ - consumed_, UINT_MAX));
+                stream->next_out = reinterpret_cast<Bytef*>(buffer_.get() + available_);
+                stream->avail_out = static_cast<uInt>(std::min<size_t>(end - available_, UINT_MAX));
+
+                int status = inflate(stream, Z_SYNC_FLUSH);
+                consumed_ = stream->next_in - reinterpret_cast<const Bytef*>(compressed_);
+                available_ = reinterpret_cast<char*>(stream->next_out) - buffer_.get();
+                if (status == Z_STREAM_END && available_ < size_)
+                    throw std::runtime_error("Truncated compressed section");
+                if (status != Z_OK && status != Z_STREAM_END)
+                    throw std::runtime_error("Corrupted compressed section");
+            }
+            return;
+        }
+
+#ifdef INSIGHT_HAVE_ZSTD
+        ZSTD_DStream* stream = static_cast<ZSTD_DStream*>(stream_);
+        if (!stream) {
+            stream = ZSTD_createDStream();
+            if (!stream)
+                throw std::runtime_error("Could not initialize zstd");
+            stream_ = stream;
+        }
+
+        while (available_ < end) {
+            ZSTD_inBuffer in = {compressed_, compressed_size_, consumed_};
+            ZSTD_outBuffer out = {buffer_.get(), end, available_};
+            size_t status = ZSTD_decompressStream(stream, &out, &in);
+            if (ZSTD_isError(status))
+                throw std::runtime_error("Corrupted compressed section");
+            if (in.pos == consumed_ && out.pos == available_)
+                throw std::runtime_error("Truncated compressed section");
+            consumed_ = in.pos;
+            available_ = out.pos;
+        }
+#else
+        throw std::runtime_error("Insight was built without zstd support");
+#endif
+    }
+
+    DebugSection::Statistics DebugSection::statistics() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (compression_ == NONE)
+            return Statistics{0, 0, std::chrono::nanoseconds(0)};
+        return Statistics{consumed_, available_, time_};
+    }
+
+    ElfFile::ElfFile(const std::string& path)
+        : data_(nullptr)
+        , size_(0)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return;
+        map(fd);
+        close(fd);
+    }
+
+    ElfFile::ElfFile(int fd)
+        : data_(nullptr)
+        , size_(0)
+    {
+        map(fd);
+    }
+
+    void ElfFile::map(int fd) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof (ElfW(Ehdr))) {
+            void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                // debugging information is read sparsely, read-ahead would
+                // only make more of it resident
+                madvise(data, st.st_size, MADV_RANDOM);
+                data_ = static_cast<const char*>(data);
+                size_ = st.st_size;
+            }
+        }
+
+        if (!data_)
+            return;
+
+        const ElfW(Ehdr)& ehdr = header();
+        bool valid = !std::memcmp(ehdr.e_ident, ELFMAG, SELFMAG)
+            && ehdr.e_ident[EI_CLASS] == (sizeof (void*) == 8 ? ELFCLASS64 : ELFCLASS32)
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            && ehdr.e_ident[EI_DATA] == ELFDATA2MSB
+#else
+            && ehdr.e_ident[EI_DATA] == ELFDATA2LSB
+#endif
+            && (!ehdr.e_phnum || (ehdr.e_phentsize == sizeof (ElfW(Phdr))
+                    && ehdr.e_phoff + ehdr.e_phnum * sizeof (ElfW(Phdr)) <= size_))
+            && (!ehdr.e_shnum || (ehdr.e_shentsize == sizeof (ElfW(Shdr))
+                    && ehdr.e_shoff + ehdr.e_shnum * sizeof (ElfW(Shdr)) <= size_
+                    && ehdr.e_shstrndx < ehdr.e_shnum));
+        if (!valid) {
+            munmap(const_cast<char*>(data_), size_);
+            data_ = nullptr;
+            size_ = 0;
+        }
+    }
+
+    ElfFile::~ElfFile() {
+        if (data_)
+            munmap(const_cast<char*>(data_), size_);
+    }
+
+    bool ElfFile::valid() const {
+        return data_ != nullptr;
+    }
+
+    const ElfW(Ehdr)& ElfFile::header() const {
+        return *reinterpret_cast<const ElfW(Ehdr)*>(data_);
+    }
+
+    const ElfW(Phdr)* ElfFile::program_headers() const {
+        return reinterpret_cast<const ElfW(Phdr)*>(data_ + header().e_phoff);
+    }
+
+    bool ElfFile::section(const std::string& name, Section& section) const {
+        if (!data_ || !header().e_shnum)
+            return false;
+
+        if (header().e_shoff + header().e_shnum * sizeof (ElfW(Shdr)) > size_ || header().e_shstrndx >= header().e_shnum)
+            return false;
+
+        const ElfW(Shdr)* shdrs = reinterpret_cast<const ElfW(Shdr)*>(data_ + header().e_shoff);
+        const ElfW(Shdr)& strtab = shdrs[header().e_shstrndx];
+        if (strtab.sh_offset + strtab.sh_size > size_)
+            return false;
+
+        // the name and its terminator must both be inside the string table
+        const char* names = data_ + strtab.sh_offset;
+        for (size_t i = 0; i < header().e_shnum; ++i) {
+            const ElfW(Shdr)& shdr = shdrs[i];
+            if (shdr.sh_name >= strtab.sh_size || name.size() >= strtab.sh_size - shdr.sh_name)
+                continue;
+            if (memcmp(names + shdr.sh_name, name.c_str(), name.size()) || names[shdr.sh_name + name.size()])
+                continue;
+
+            // sections without contents in the file, such as .bss
+            if (shdr.sh_type == SHT_NOBITS || shdr.sh_offset + shdr.sh_size > size_)
+                return false;
+
+            section = Section{data_ + shdr.sh_offset, shdr.sh_size, shdr.sh_type, shdr.sh_flags, shdr.sh_addr};
+            return true;
+        }
+        return false;
+    }
+
+    bool ElfFile::has_section(const std::string& name) const {
+        Section unused;
+        return section(name, unused);
+    }
+
+    // The GNU build id in a sequence of notes, as lowercase hexadecimal.
+    static std::string note_build_id(const char* notes, size_t size) {
+        size_t off = 0;
+        while (off + sizeof (ElfW(Nhdr)) <= size) {
+            const ElfW(Nhdr)* note = reinterpret_cast<const ElfW(Nhdr)*>(notes + off);
+            size_t desc = off + sizeof (*note) + ((note->n_namesz + 3) & ~3u);
+            if (desc + note->n_descsz > size)
+                break;
+
+            if (note->n_type == NT_GNU_BUILD_ID) {
+                static const char digits[] = "0123456789abcdef";
+                std::string id;
+                for (size_t i = 0; i < note->n_descsz; ++i) {
+                    unsigned char c = notes[desc + i];
+                    id += digits[c >> 4];
+                    id += digits[c & 0xf];
+                }
+                return id;
+            }
+            off = desc + ((note->n_descsz + 3) & ~3u);
+        }
+        return "";
+    }
+
+    std::string ElfFile::build_id() const {
+        Section notes;
+        if (!section(".note.gnu.build-id", notes))
+            return "";
+        return note_build_id(notes.data, notes.size);
+    }
+
+    std::string loaded_build_id(const struct dl_phdr_info& info) {
+        for (ElfW(Half) i = 0; i < info.dlpi_phnum; ++i) {
+            const ElfW(Phdr)& phdr = info.dlpi_phdr[i];
+            if (phdr.p_type != PT_NOTE)
+                continue;
+            const char* notes = reinterpret_cast<const char*>(info.dlpi_addr + phdr.p_vaddr);
+            std::string id = note_build_id(notes, phdr.p_memsz);
+            if (!id.empty())
+                return id;
+        }
+        return "";
+    }
+
+    // The section holds a NUL terminated file name, padded to 4 bytes, then
+    // the CRC32 of the debug file.
+    bool ElfFile::debuglink(std::string& name, uint32_t& crc) const {
+        Section link;
+        if (!section(".gnu_debuglink", link))
+            return false;
+
+        size_t length = strnlen(link.data, link.size);
+        size_t crc_offset = (length + 4) & ~static_cast<size_t>(3);
+        if (!length || crc_offset + sizeof (crc) > link.size)
+            return false;
+
+        name.assign(link.data, length);
+        std::memcpy(&crc, link.data + crc_offset, sizeof (crc));
+        return true;
+    }
+
+    uint32_t ElfFile::crc32() const {
+        uLong crc = ::crc32(0, Z_NULL, 0);
+        for (size_t off = 0; off < size_;) {
+            uInt chunk = static_cast<uInt>(std::min<size_t>(size_ - off, 1u << 30));
+            crc = ::crc32(crc, reinterpret_cast<const Bytef*>(data_ + off), chunk);
+            off += chunk;
+        }
+        return static_cast<uint32_t>(crc);
+    }
+
+    std::shared_ptr<DebugSection> ElfFile::debug_section(const std::string& name) const {
+        std::lock_guard<std::mutex> lock(sections_mutex_);
+        auto it = sections_.find(name);
+        if (it != sections_.end())
+            return it->second;
+
+        std::shared_ptr<DebugSection> result;
+        Section raw;
+        if (section(name, raw)) {
+            if (!(raw.flags & SHF_COMPRESSED)) {
+                result = std::make_shared<DebugSection>(raw.data, raw.size);
+            } else if (raw.size >= sizeof (ElfW(Chdr))) {
+                ElfW(Chdr) chdr;
+                std::memcpy(&chdr, raw.data, sizeof (chdr));
+                DebugSection::Compression compression;
+                if (chdr.ch_type == ELFCOMPRESS_ZLIB)
+                    compression = DebugSection::ZLIB;
+                else if (chdr.ch_type == ELFCOMPRESS_ZSTD)
+                    compression = DebugSection::ZSTD;
+                else
+                    throw std::runtime_error("Unknown compression for section " + name);
+                result = std::make_shared<DebugSection>(compression, raw.data + sizeof (chdr),
+                                                        raw.size - sizeof (chdr), chdr.ch_size);
+            }
+        } else if (name.compare(0, 7, ".debug_") == 0 && section(".z" + name.substr(1), raw)) {
+            // GNU format: "ZLIB" then the big endian size of the contents
+            if (raw.size >= 12 && !std::memcmp(raw.data, "ZLIB", 4)) {
+                uint64_t size = 0;
+                for (size_t i = 4; i < 12; ++i)
+                    size = (size << 8) | static_cast<unsigned char>(raw.data[i]);
+                result = std::make_shared<DebugSection>(DebugSection::ZLIB, raw.data + 12, raw.size - 12, size);
+            } else {
+                result = std::make_shared<DebugSection>(raw.data, raw.size);
+            }
+        }
+
+        sections_.emplace(name, result);
+        return result;
+    }
+
+    DebugSection::Statistics ElfFile::statistics() const {
+        DebugSection::Statistics total{0, 0, std::chrono::nanoseconds(0)};
+        std::lock_guard<std::mutex> lock(sections_mutex_);
+        for (auto& entry : sections_) {
+            if (!entry.second)
+                continue;
+            DebugSection::Statistics stats = entry.second->statistics();
+            total.compressed_bytes += stats.compressed_bytes;
+            total.decompressed_bytes += stats.decompressed_bytes;
+            total.decompression_time += stats.decompression_time;
+        }
+        return total;
+    }
+
+    std::vector<std::string> ElfFile::section_names() const {
+        std::vector<std::string> result;
+        if (!data_ || !header().e_shnum)
+            return result;
+        if (header().e_shoff + header().e_shnum * sizeof (ElfW(Shdr)) > size_ || header().e_shstrndx >= header().e_shnum)
+            return result;
+
+        const ElfW(Shdr)* shdrs = reinterpret_cast<const ElfW(Shdr)*>(data_ + header().e_shoff);
+        const ElfW(Shdr)& strtab = shdrs[header().e_shstrndx];
+        if (strtab.sh_offset + strtab.sh_size > size_)
+            return result;
+
+        const char* names = data_ + strtab.sh_offset;
+        for (size_t i = 0; i < header().e_shnum; ++i) {
+            size_t name = shdrs[i].sh_name;
+            if (name < strtab.sh_size)
+                result.emplace_back(names + name, strnlen(names + name, strtab.sh_size - name));
+        }
+        return result;
+    }
+
+    DebugSection::Statistics ElfFile::compressed_sizes() const {
+        DebugSection::Statistics total{0, 0, std::chrono::nanoseconds(0)};
+        for (std::string name : section_names()) {
+            if (name.compare(0, 8, ".zdebug_") == 0)
+                name.erase(1, 1);
+            else if (name.compare(0, 7, ".debug_") != 0)
+                continue;
+
+            std::shared_ptr<DebugSection> section = debug_section(name);
+            if (section && section->compression() != DebugSection::NONE) {
+                total.compressed_bytes += section->compressed_size();
+                total.decompressed_bytes += section->size();
+            }
+        }
+        return total;
+    }
+
+    static std::string resolve_path(const std::string& path) {
+        char* resolved = realpath(path.c_str(), nullptr);
+        std::string result = resolved ? resolved : path;
+        free(resolved);
+        return result;
+    }
+
+    uintptr_t auxv_entry(const char* data, size_t size) {
+        for (size_t off = 0; off + sizeof (ElfW(auxv_t)) <= size; off += sizeof (ElfW(auxv_t))) {
+            ElfW(auxv_t) entry;
+            std::memcpy(&entry, data + off, sizeof (entry));
+            if (entry.a_type == AT_NULL)
+                break;
+            if (entry.a_type == AT_ENTRY)
+                return entry.a_un.a_val;
+        }
+        return 0;
+    }
+
+    uintptr_t executable_load_bias(const std::string& executable, uintptr_t entry) {
+        ElfFile elf(executable);
+        if (!elf.valid())
+            throw std::runtime_error("Could not read " + executable);
+
+        // only position independent executables are relocated
+        if (elf.header().e_type != ET_DYN)
+            return 0;
+
+        uintptr_t bias = entry - elf.header().e_entry;
+        if (!entry || bias % sysconf(_SC_PAGESIZE))
+            throw std::runtime_error("Could not find where " + executable + " is loaded");
+        return bias;
+    }
+
+    static bool has_debug_info(const ElfFile& elf) {
+        return elf.has_section(".debug_info") || elf.has_section(".zdebug_info");
+    }
+
+    bool has_debug_info(const std::string& path) {
+        ElfFile elf(path);
+        return elf.valid() && has_debug_info(elf);
+    }
+
+    std::string find_debug_file(const std::string& path) {
+        ElfFile elf(path);
+        if (!elf.valid())
+            return "";
+        if (has_debug_info(elf))
+            return path;
+
+        std::string id = elf.build_id();
+        if (id.size() > 2) {
+            std::string candidate = std::string(DEBUG_DIRECTORY) + "/.build-id/" + id.substr(0, 2) + "/" + id.substr(2) + ".debug";
+            if (has_debug_info(candidate))
+                return candidate;
+        }
+
+        std::string name;
+        uint32_t crc;
+        if (!elf.debuglink(name, crc))
+            return "";
+
+        std::string resolved = resolve_path(path);
+        std::string directory = resolved.substr(0, resolved.rfind('/'));
+        for (const std::string& candidate : {
+                directory + "/" + name,
+                directory + "/.debug/" + name,
+                std::string(DEBUG_DIRECTORY) + directory + "/" + name }) {
+            if (candidate == resolved)
+                continue;
+
+            ElfFile debug(candidate);
+            if (!debug.valid() || !has_debug_info(debug))
+                continue;
+
+            // the build id identifies the debug file without reading all of
+            // it, the checksum is only used for binaries without one
+            if (id.empty() ? debug.crc32() == crc : debug.build_id() == id)
+                return candidate;
+        }
+        return "";
+    }
+
+}
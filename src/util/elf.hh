@@ -0,0 +1,162 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef INSIGHT_ELF_HH
+# define INSIGHT_ELF_HH
+
+# include <chrono>
+# include <cstdint>
+# include <map>
+# include <memory>
+# include <mutex>
+# include <string>
+# include <vector>
+# include <link.h>
+
+namespace Insight {
+
+    // The contents of a debugging section. Compressed sections, either
+    // SHF_COMPRESSED or legacy .zdebug_*, are inflated incrementally: only the
+    // prefix that was asked for is decompressed, so reading the first units
+    // of .debug_info does not decompress the whole section.
+    class DebugSection {
+    public:
+        enum Compression { NONE, ZLIB, ZSTD };
+
+        DebugSection(const char* data, size_t size);
+        DebugSection(Compression compression, const char* data, size_t size, size_t decompressed_size);
+        ~DebugSection();
+
+        DebugSection(const DebugSection&) = delete;
+        DebugSection& operator=(const DebugSection&) = delete;
+
+        size_t size() const;
+        size_t compressed_size() const;
+        Compression compression() const;
+
+        // The section contents, of which at least the first `end` bytes are
+        // available. Bytes past those may not be decompressed yet.
+        const char* data(size_t end);
+        const char* data();
+
+        struct Statistics {
+            size_t compressed_bytes;
+            size_t decompressed_bytes;
+            std::chrono::nanoseconds decompression_time;
+        };
+        Statistics statistics() const;
+
+    private:
+        void decompress(size_t end);
+
+        Compression compression_;
+        const char* compressed_;
+        size_t compressed_size_;
+        size_t size_;
+
+        mutable std::mutex mutex_;
+        std::unique_ptr<char[]> buffer_;
+        size_t available_;
+        size_t consumed_;
+        void* stream_;
+        std::chrono::nanoseconds time_;
+    };
+
+    // An ELF file mapped in memory. Only the pages of the parts that are
+    // accessed are read from the disk.
+    class ElfFile {
+    public:
+        struct Section {
+            const char* data;
+            size_t size;
+            uint32_t type;
+            uint64_t flags;
+            uint64_t addr;      // link-time address of allocated sections
+        };
+
+        ElfFile(const std::string& path);
+        ElfFile(int fd);    // the descriptor may be closed afterwards
+        ~ElfFile();
+
+        ElfFile(const ElfFile&) = delete;
+        ElfFile& operator=(const ElfFile&) = delete;
+
+        bool valid() const;
+        const ElfW(Ehdr)& header() const;
+        const ElfW(Phdr)* program_headers() const;
+
+        bool section(const std::string& name, Section& section) const;
+        bool has_section(const std::string& name) const;
+
+        // Lowercase hexadecimal GNU build id, or an empty string.
+        std::string build_id() const;
+
+        // Name and checksum from the .gnu_debuglink section.
+        bool debuglink(std::string& name, uint32_t& crc) const;
+
+        uint32_t crc32() const;
+
+        // A DWARF section by its name without compression prefix, such as
+        // ".debug_info". Decompression is deferred until the contents are
+        // read. Null if the file has no such section.
+        std::shared_ptr<DebugSection> debug_section(const std::string& name) const;
+
+        // Sum of the statistics of the debug sections opened so far.
+        DebugSection::Statistics statistics() const;
+
+        // Sizes of all the compressed debug sections, as accounted for by
+        // readers that decompress them whole.
+        DebugSection::Statistics compressed_sizes() const;
+
+    private:
+        void map(int fd);
+        std::vector<std::string> section_names() const;
+
+        const char* data_;
+        size_t size_;
+
+        mutable std::mutex sections_mutex_;
+        mutable std::map<std::string, std::shared_ptr<DebugSection>> sections_;
+    };
+
+    // Build id of an object loaded in the current process, read from its
+    // notes in memory rather than from its file.
+    std::string loaded_build_id(const struct dl_phdr_info& info);
+
+    // Entry point of a process from its auxiliary vector, as read from
+    // /proc/<pid>/auxv or from the NT_AUXV note of a core. Zero if absent.
+    uintptr_t auxv_entry(const char* data, size_t size);
+
+    // Load bias of an executable whose entry point is at entry in a process,
+    // which holds wherever the file is now. Zero for executables that are
+    // not position independent. Throws std::runtime_error when the entry is
+    // unknown or does not belong to the executable.
+    uintptr_t executable_load_bias(const std::string& executable, uintptr_t entry);
+
+    // Whether an ELF file has a DWARF .debug_info section, without loading it.
+    bool has_debug_info(const std::string& path);
+
+    // The file holding the debugging information of a binary: the binary
+    // itself, or a separate debug file found through its build id or its
+    // .gnu_debuglink section. Empty if there is none.
+    std::string find_debug_file(const std::string& path);
+
+}
+
+#endif /* !INSIGHT_ELF_HH */
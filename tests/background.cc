@@ -0,0 +1,55 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <gtest/gtest.h>
+#include "insight/insight"
+#include "insight/registry"
+#include "child.hh"
+
+using namespace Insight;
+
+namespace Background {
+    struct Wanted {
+        int a;
+        Wanted* next;
+    };
+}
+
+Background::Wanted background_wanted;
+
+// Run by Background.Async in a process loading its metadata in the
+// background, and as any other test otherwise.
+TEST(BackgroundLookup, WaitsForUnits) {
+    prioritize("Background::Wanted");
+
+    TypeInfo& type = self_registry().find_type("Background::Wanted");
+    EXPECT_EQ(sizeof (Background::Wanted), type.size_of());
+
+    StructInfo& inferred = type_of(Background::Wanted);
+    EXPECT_EQ(&type, &inferred);
+    EXPECT_EQ(offsetof(Background::Wanted, next), inferred.field("next").offset());
+    EXPECT_EQ(&type, &root_namespace().variable("background_wanted").type());
+}
+
+TEST(Background, Async) {
+    if (in_child("INSIGHT_INIT", "async"))
+        return;
+
+    run_child("INSIGHT_INIT", "async", "BackgroundLookup.*");
+}
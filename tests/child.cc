@@ -0,0 +1,48 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "child.hh"
+
+bool in_child(const char* variable, const char* value) {
+    const char* current = std::getenv(variable);
+    return current && std::strcmp(current, value) == 0;
+}
+
+void run_child(const char* variable, const char* value, const char* filter) {
+    std::string option = std::string("--gtest_filter=") + filter;
+
+    pid_t pid = fork();
+    ASSERT_NE(-1, pid);
+    if (!pid) {
+        setenv(variable, value, 1);
+        execl("/proc/self/exe", "test_insight", option.c_str(), nullptr);
+        _exit(127);
+    }
+
+    int status;
+    ASSERT_EQ(pid, waitpid(pid, &status, 0));
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(0, WEXITSTATUS(status));
+}
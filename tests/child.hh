@@ -0,0 +1,30 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef INSIGHT_TEST_CHILD_HH
+# define INSIGHT_TEST_CHILD_HH
+
+// Whether this process was started by run_child with the given setting.
+bool in_child(const char* variable, const char* value);
+
+// Runs the tests matching the filter in a new instance of this executable
+// whose environment has the variable set, and expects them to pass.
+void run_child(const char* variable, const char* value, const char* filter);
+
+#endif /* !INSIGHT_TEST_CHILD_HH */
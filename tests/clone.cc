@@ -0,0 +1,164 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <cstring>
+#include <gtest/gtest.h>
+#include "insight/insight"
+#include "insight/clone"
+
+using namespace Insight;
+
+struct CloneTest {
+    int value;
+    $(CString)
+    char* name;
+    const char* label;
+    CloneTest* next;
+};
+
+// each type refers to the other, the holder being compiled first
+struct CloneArray;
+
+struct CloneHolder {
+    CloneArray* array;
+    int value;
+};
+
+struct CloneArray {
+    CloneHolder items[2];
+};
+
+TEST(Clone, Shallow) {
+    char name[] = "foo";
+    CloneTest a = {42, name, "bar", &a};
+
+    StructInfo& type = type_of(CloneTest);
+    CloneTest* c = clone(a, type);
+
+    EXPECT_EQ(42, c->value);
+    EXPECT_EQ(name, c->name);
+    EXPECT_EQ(&a, c->next);
+    ::operator delete(c);
+}
+
+TEST(Clone, Deep) {
+    char na[] = "a";
+    char nb[] = "b";
+    CloneTest b = {2, nb, "shared", nullptr};
+    CloneTest a = {1, na, "shared", &b};
+    b.next = &a;
+
+    StructInfo& type = type_of(CloneTest);
+    CloneTest* c = deep_clone(a, type);
+
+    EXPECT_EQ(1, c->value);
+    EXPECT_STREQ("a", c->name);
+    EXPECT_NE(na, c->name);
+    EXPECT_EQ(a.label, c->label);
+
+    ASSERT_NE(&b, c->next);
+    EXPECT_EQ(2, c->next->value);
+    EXPECT_STREQ("b", c->next->name);
+    EXPECT_EQ(c, c->next->next);
+
+    deep_free(c, type);
+}
+
+TEST(Clone, Array) {
+    char name[] = "x";
+    CloneTest items[3] = {
+        {0, name, nullptr, nullptr},
+        {1, name, nullptr, nullptr},
+        {2, name, nullptr, nullptr},
+    };
+    items[2].next = &items[0];
+
+    StructInfo& type = type_of(CloneTest);
+    CloneTest* c = deep_clone_array(items, 3, type);
+
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(i, c[i].value);
+        EXPECT_STREQ("x", c[i].name);
+    }
+    // all copies of the same string are shared, as in the original
+    EXPECT_EQ(c[0].name, c[1].name);
+    EXPECT_EQ(&c[0], c[2].next);
+
+    deep_free(c, type, 3);
+}
+
+struct CloneBuffer {
+    char* bytes;
+    CloneBuffer* items;
+    CloneBuffer* current;
+};
+
+struct CloneBuffers {
+    CloneBuffer items[3];
+    CloneBuffer* current;
+};
+
+TEST(Clone, UnannotatedCharPointersAreShared) {
+    char bytes[4] = {'a', 'b', 'c', 'd'};
+    CloneBuffer a = {bytes, nullptr, nullptr};
+
+    StructInfo& type = type_of(CloneBuffer);
+    CloneBuffer* c = deep_clone(a, type);
+    EXPECT_EQ(bytes, c->bytes);
+    deep_free(c, type);
+}
+
+TEST(Clone, InteriorPointers) {
+    CloneBuffer items[4] = {};
+    for (auto& item : items)
+        item.current = &items[2];
+
+    StructInfo& type = type_of(CloneBuffer);
+    CloneBuffer* c = deep_clone_array(items, 4, type);
+    for (int i = 0; i < 4; ++i)
+        EXPECT_EQ(&c[2], c[i].current);
+    deep_free(c, type, 4);
+
+    CloneBuffers root = {};
+    root.current = &root.items[1];
+    root.items[0].current = &root.items[2];
+
+    StructInfo& buffers = type_of(CloneBuffers);
+    CloneBuffers* b = deep_clone(root, buffers);
+    EXPECT_EQ(&b->items[1], b->current);
+    EXPECT_EQ(&b->items[2], b->items[0].current);
+    deep_free(b, buffers);
+}
+
+TEST(Clone, MutuallyRecursiveArrays) {
+    CloneArray inner = {{{nullptr, 3}, {nullptr, 4}}};
+    CloneArray outer = {{{&inner, 1}, {nullptr, 2}}};
+    CloneHolder holder = {&outer, 0};
+
+    StructInfo& type = type_of(CloneHolder);
+    CloneHolder* c = deep_clone(holder, type);
+
+    ASSERT_NE(&outer, c->array);
+    ASSERT_NE(nullptr, c->array->items[0].array);
+    EXPECT_NE(&inner, c->array->items[0].array);
+    EXPECT_EQ(3, c->array->items[0].array->items[0].value);
+    EXPECT_EQ(nullptr, c->array->items[1].array);
+
+    deep_free(c, type);
+}
@@ -0,0 +1,117 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <cstdlib>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "insight/insight"
+#include "insight/coredump"
+
+using namespace Insight;
+
+TEST(CoreDump, RejectsNonCoreFiles) {
+    EXPECT_THROW(CoreAddressSpace("/proc/self/exe"), std::runtime_error);
+    EXPECT_THROW(CoreAddressSpace("/nonexistent/core"), std::runtime_error);
+}
+
+struct CoreTestValue {
+    int id;
+    double ratio;
+    char tag[8];
+};
+
+CoreTestValue core_test_value = {1, 0.5, "parent"};
+
+// Dumps the core of a child that changed core_test_value, in a directory
+// of its own. Empty when core files are piped or disabled.
+static std::string dump_child_core(const std::string& directory) {
+    std::ifstream in("/proc/sys/kernel/core_pattern");
+    std::string pattern;
+    std::getline(in, pattern);
+    if (pattern.empty() || pattern.find_first_of("|%/") != std::string::npos)
+        return "";
+
+    pid_t pid = fork();
+    if (!pid) {
+        struct rlimit limit = {RLIM_INFINITY, RLIM_INFINITY};
+        setrlimit(RLIMIT_CORE, &limit);
+        if (chdir(directory.c_str()))
+            _exit(1);
+        core_test_value = {7, 2.25, "child"};
+        abort();
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFSIGNALED(status) || !WCOREDUMP(status))
+        return "";
+
+    for (const std::string& name : {pattern, pattern + "." + std::to_string(pid)}) {
+        std::string path = directory + "/" + name;
+        if (access(path.c_str(), R_OK) == 0)
+            return path;
+    }
+    return "";
+}
+
+TEST(CoreDump, ReadVariable) {
+    char directory[] = "/tmp/insight-core-XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(directory));
+
+    std::string core = dump_child_core(directory);
+    if (core.empty()) {
+        rmdir(directory);
+        GTEST_SKIP() << "core files are not written to the working directory";
+    }
+
+    // the executable may have moved since the crash
+    std::string executable = std::string(directory) + "/moved";
+    {
+        std::ifstream src("/proc/self/exe", std::ios::binary);
+        std::ofstream dst(executable, std::ios::binary);
+        dst << src.rdbuf();
+    }
+
+    {
+        CoreDump dump(core, executable);
+
+        const VariableInfo* variable = nullptr;
+        for (auto& v : dump.root_namespace().variables()) {
+            if (v.name() == "core_test_value")
+                variable = &v;
+        }
+        ASSERT_NE(nullptr, variable);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(&core_test_value), dump.address_of(*variable));
+        EXPECT_EQ(type_of(CoreTestValue).size_of(), variable->type().size_of());
+
+        CoreTestValue value;
+        ASSERT_TRUE(dump.read(*variable, &value));
+        EXPECT_EQ(7, value.id);
+        EXPECT_EQ(2.25, value.ratio);
+        EXPECT_STREQ("child", value.tag);
+    }
+
+    unlink(executable.c_str());
+    unlink(core.c_str());
+    rmdir(directory);
+}
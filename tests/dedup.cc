@@ -0,0 +1,71 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <gtest/gtest.h>
+#include "insight/insight"
+#include "dedup.hh"
+
+using namespace Insight;
+
+DedupShared dedup_here;
+DedupShared* dedup_here_pointer;
+const char* dedup_here_array[2][3];
+
+struct DedupLayout {
+    int a;
+};
+
+namespace {
+    struct DedupPrivate {
+        int a;
+    };
+}
+
+DedupLayout dedup_layout_here;
+[[gnu::used]] DedupPrivate dedup_private_here;
+
+static TypeInfo& variable_type(const char* name) {
+    return root_namespace().variable(name).type();
+}
+
+TEST(Dedup, SharedAcrossUnits) {
+    StructInfo& type = type_of(DedupShared);
+    EXPECT_EQ(&type, &variable_type("dedup_here"));
+    EXPECT_EQ(&type, &variable_type("dedup_other"));
+
+    auto& next = dynamic_cast<PointerTypeInfo&>(type.field("next").type());
+    EXPECT_EQ(&type, &next.pointed_type());
+}
+
+TEST(Dedup, DerivedTypes) {
+    EXPECT_EQ(&variable_type("dedup_here_pointer"), &variable_type("dedup_other_pointer"));
+    EXPECT_EQ(&variable_type("dedup_here_array"), &variable_type("dedup_other_array"));
+}
+
+TEST(Dedup, DifferentLayouts) {
+    TypeInfo& here = variable_type("dedup_layout_here");
+    TypeInfo& other = variable_type("dedup_layout_other");
+    EXPECT_NE(&here, &other);
+    EXPECT_EQ(sizeof (DedupLayout), here.size_of());
+    EXPECT_EQ(2 * sizeof (double), other.size_of());
+}
+
+TEST(Dedup, AnonymousNamespaces) {
+    EXPECT_NE(&variable_type("dedup_private_here"), &variable_type("dedup_private_other"));
+}
@@ -0,0 +1,38 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "dedup.hh"
+
+DedupShared dedup_other;
+DedupShared* dedup_other_pointer;
+const char* dedup_other_array[2][3];
+
+struct DedupLayout {
+    double b;
+    char c;
+};
+
+namespace {
+    struct DedupPrivate {
+        int a;
+    };
+}
+
+DedupLayout dedup_layout_other;
+[[gnu::used]] DedupPrivate dedup_private_other;
@@ -0,0 +1,124 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <gtest/gtest.h>
+#include "insight/insight"
+#include "insight/graph"
+
+using namespace Insight;
+
+struct GraphNode {
+    long value;
+    GraphNode* next;
+    GraphNode* other;
+};
+
+// each type refers to the other, the holder being compiled first
+struct GraphArray;
+
+struct GraphHolder {
+    GraphArray* array;
+    long value;
+};
+
+struct GraphArray {
+    GraphHolder items[2];
+};
+
+TEST(Graph, Cycle) {
+    GraphNode c = {3, nullptr, nullptr};
+    GraphNode b = {2, &c, nullptr};
+    GraphNode a = {1, &b, &c};
+    c.next = &a;
+    GraphNode* head = &a;
+
+    GraphWalker walker;
+    walker.add_root("head", reinterpret_cast<uintptr_t>(&head), type_of(head));
+    GraphUsage usage = walker.walk();
+
+    EXPECT_EQ(3u, usage.objects);
+    EXPECT_EQ(3 * sizeof (GraphNode), usage.bytes);
+    EXPECT_EQ(0u, usage.invalid_pointers);
+    ASSERT_EQ(1u, usage.types.size());
+    EXPECT_EQ(&type_of(a), usage.types[0].type);
+}
+
+TEST(Graph, SharedObjects) {
+    GraphNode shared = {0, nullptr, nullptr};
+    GraphNode a = {1, &shared, nullptr};
+    GraphNode b = {2, &shared, nullptr};
+
+    GraphWalker walker;
+    walker.add_root("a", reinterpret_cast<uintptr_t>(&a), type_of(a));
+    walker.add_root("b", reinterpret_cast<uintptr_t>(&b), type_of(b));
+    GraphUsage usage = walker.walk();
+
+    ASSERT_EQ(2u, usage.roots.size());
+    EXPECT_EQ(1u, usage.roots[0].objects);
+    EXPECT_EQ(0u, usage.roots[1].objects);
+    EXPECT_EQ(1u, usage.objects);
+}
+
+TEST(Graph, InvalidPointers) {
+    GraphNode a = {1, reinterpret_cast<GraphNode*>(0x10), nullptr};
+    GraphNode b = {2, nullptr, nullptr};
+    a.other = reinterpret_cast<GraphNode*>(reinterpret_cast<char*>(&b) + 1);
+
+    GraphWalker walker;
+    walker.add_root("a", reinterpret_cast<uintptr_t>(&a), type_of(a));
+    GraphUsage usage = walker.walk();
+
+    EXPECT_EQ(0u, usage.objects);
+    EXPECT_EQ(2u, usage.invalid_pointers);
+}
+
+GraphNode graph_test_leaf = {2, nullptr, nullptr};
+GraphNode graph_test_root = {1, &graph_test_leaf, nullptr};
+
+TEST(Graph, VariableRoots) {
+    const VariableInfo* variable = nullptr;
+    for (auto& v : root_namespace().variables()) {
+        if (v.name() == "graph_test_root")
+            variable = &v;
+    }
+    ASSERT_NE(nullptr, variable);
+
+    // the addresses of variables are already relocated
+    GraphWalker walker;
+    walker.add_root(*variable);
+    GraphUsage usage = walker.walk();
+
+    ASSERT_EQ(1u, usage.roots.size());
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(&graph_test_root), usage.roots[0].address);
+    EXPECT_EQ(1u, usage.objects);
+    EXPECT_EQ(0u, usage.invalid_pointers);
+}
+
+TEST(Graph, MutuallyRecursiveArrays) {
+    GraphArray inner = {{{nullptr, 3}, {nullptr, 4}}};
+    GraphArray outer = {{{&inner, 1}, {nullptr, 2}}};
+    GraphHolder holder = {&outer, 0};
+
+    GraphWalker walker;
+    walker.add_root("holder", reinterpret_cast<uintptr_t>(&holder), type_of(holder));
+    GraphUsage usage = walker.walk();
+
+    EXPECT_EQ(2u, usage.objects);
+    EXPECT_EQ(2 * sizeof (GraphArray), usage.bytes);
+}
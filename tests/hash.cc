@@ -0,0 +1,173 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <cstring>
+#include <vector>
+#include <gtest/gtest.h>
+#include "insight/insight"
+#include "insight/hash"
+
+using namespace Insight;
+
+struct HashTest {
+    char c;
+    int i;
+    double d;
+    char name[5];
+    HashTest* next;
+};
+
+// each type refers to the other, the holder being compiled first
+struct HashArray;
+
+struct HashHolder {
+    HashArray* array;
+};
+
+struct HashArray {
+    HashHolder items[2];
+    int value;
+};
+
+static void init(HashTest& t, unsigned char garbage) {
+    std::memset(&t, garbage, sizeof (t));
+    t.c = 'c';
+    t.i = 42;
+    t.d = 1.5;
+    std::strcpy(t.name, "test");
+    t.next = nullptr;
+}
+
+TEST(Hash, IgnoresPadding) {
+    HashTest a, b;
+    init(a, 0xaa);
+    init(b, 0x55);
+
+    StructInfo& type = type_of(HashTest);
+    EXPECT_TRUE(equals(a, b, type));
+    EXPECT_EQ(0, compare(a, b, type));
+    EXPECT_EQ(hash(a, type), hash(b, type));
+}
+
+TEST(Hash, Fields) {
+    HashTest a, b;
+    init(a, 0);
+    init(b, 0);
+    b.name[2] = 'x';
+
+    StructInfo& type = type_of(HashTest);
+    EXPECT_FALSE(equals(a, b, type));
+    EXPECT_NE(hash(a, type), hash(b, type));
+    EXPECT_NE(0, compare(a, b, type));
+    EXPECT_EQ(compare(a, b, type) < 0, compare(b, a, type) > 0);
+}
+
+TEST(Hash, PointerPolicy) {
+    HashTest a, b, na, nb;
+    init(a, 0);
+    init(b, 0);
+    init(na, 0);
+    init(nb, 0);
+
+    // two distinct but identical cycles
+    a.next = &na;
+    na.next = &a;
+    b.next = &nb;
+    nb.next = &b;
+
+    StructInfo& type = type_of(HashTest);
+    EXPECT_FALSE(equals(a, b, type, PointerPolicy::ADDRESS));
+    EXPECT_TRUE(equals(a, b, type, PointerPolicy::FOLLOW));
+    EXPECT_EQ(hash(a, type, PointerPolicy::FOLLOW), hash(b, type, PointerPolicy::FOLLOW));
+
+    nb.i = 0;
+    EXPECT_FALSE(equals(a, b, type, PointerPolicy::FOLLOW));
+}
+
+TEST(Hash, CyclesOfDifferentLengths) {
+    HashTest a, b, nb;
+    init(a, 0);
+    init(b, 0);
+    init(nb, 0);
+
+    // a self-loop unfolds into the same values as a two-node cycle
+    a.next = &a;
+    b.next = &nb;
+    nb.next = &b;
+
+    StructInfo& type = type_of(HashTest);
+    EXPECT_TRUE(equals(a, b, type, PointerPolicy::FOLLOW));
+    EXPECT_EQ(hash(a, type, PointerPolicy::FOLLOW), hash(b, type, PointerPolicy::FOLLOW));
+
+    // objects sharing a successor that points back to one of them
+    HashTest c, shared;
+    init(c, 0);
+    init(shared, 0);
+    a.next = &shared;
+    c.next = &shared;
+    shared.next = &a;
+    EXPECT_TRUE(equals(a, c, type, PointerPolicy::FOLLOW));
+    EXPECT_EQ(hash(a, type, PointerPolicy::FOLLOW), hash(c, type, PointerPolicy::FOLLOW));
+}
+
+TEST(Hash, LongLists) {
+    std::vector<HashTest> a(10000), b(10000);
+    for (size_t i = 0; i < a.size(); ++i) {
+        init(a[i], 0);
+        init(b[i], 0);
+        a[i].i = b[i].i = static_cast<int>(i);
+        a[i].next = i + 1 < a.size() ? &a[i + 1] : nullptr;
+        b[i].next = i + 1 < b.size() ? &b[i + 1] : nullptr;
+    }
+
+    StructInfo& type = type_of(HashTest);
+    EXPECT_EQ(hash(a[0], type, PointerPolicy::FOLLOW), hash(b[0], type, PointerPolicy::FOLLOW));
+
+    std::swap(b[10].i, b[20].i);
+    EXPECT_NE(hash(a[0], type, PointerPolicy::FOLLOW), hash(b[0], type, PointerPolicy::FOLLOW));
+
+    // compared as deep as the lists are long
+    a.resize(200000);
+    b.resize(200000);
+    for (size_t i = 0; i < a.size(); ++i) {
+        init(a[i], 0);
+        init(b[i], 0);
+        a[i].next = i + 1 < a.size() ? &a[i + 1] : nullptr;
+        b[i].next = i + 1 < b.size() ? &b[i + 1] : nullptr;
+    }
+    EXPECT_TRUE(equals(a[0], b[0], type, PointerPolicy::FOLLOW));
+    b.back().i = 0;
+    EXPECT_FALSE(equals(a[0], b[0], type, PointerPolicy::FOLLOW));
+}
+
+TEST(Hash, MutuallyRecursiveArrays) {
+    HashArray a = {{{nullptr}, {nullptr}}, 1};
+    HashArray b = {{{nullptr}, {nullptr}}, 2};
+    HashArray outer_a = {{{&a}, {nullptr}}, 0};
+    HashArray outer_b = {{{&b}, {nullptr}}, 0};
+    HashHolder x = {&outer_a};
+    HashHolder y = {&outer_b};
+
+    StructInfo& type = type_of(HashHolder);
+    EXPECT_FALSE(equals(x, y, type, PointerPolicy::FOLLOW));
+    EXPECT_NE(hash(x, type, PointerPolicy::FOLLOW), hash(y, type, PointerPolicy::FOLLOW));
+    b.value = 1;
+    EXPECT_TRUE(equals(x, y, type, PointerPolicy::FOLLOW));
+    EXPECT_EQ(hash(x, type, PointerPolicy::FOLLOW), hash(y, type, PointerPolicy::FOLLOW));
+}
@@ -0,0 +1,89 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <stdexcept>
+#include <dlfcn.h>
+#include <gtest/gtest.h>
+#include "insight/insight"
+#include "insight/registry"
+#include "child.hh"
+
+using namespace Insight;
+
+namespace InitKept {
+    struct Type {
+        int a;
+    } kept;
+}
+
+namespace InitSkipped {
+    struct Type {
+        int b;
+    } skipped;
+}
+
+static bool manual_init() {
+    return in_child("INSIGHT_INIT", "manual");
+}
+
+// Run by Init.Manual in a process that is not initialized automatically.
+TEST(ManualInit, Filtered) {
+    if (!manual_init())
+        return;
+
+    EXPECT_TRUE(loaded_modules().empty());
+
+    // libraries loaded before initialize() are read by it, with its options
+    void* handle = dlopen(INSIGHT_TEST_PLUGIN, RTLD_NOW);
+    ASSERT_NE(nullptr, handle);
+    EXPECT_TRUE(loaded_modules().empty());
+
+    InitOptions options = InitOptions::from_environment();
+    EXPECT_EQ(InitMode::MANUAL, options.mode);
+    options.mode = InitMode::EAGER;
+    options.filter.namespaces = {"InitKept"};
+    initialize(options);
+
+    EXPECT_FALSE(loaded_modules().empty());
+    EXPECT_EQ(sizeof (InitKept::Type), self_registry().find_type("InitKept::Type").size_of());
+    EXPECT_THROW(self_registry().find_namespace("InitSkipped"), std::out_of_range);
+    EXPECT_THROW(initialize(options), std::logic_error);
+
+    bool plugin = false;
+    for (auto& module : loaded_modules())
+        plugin = plugin || module.path == INSIGHT_TEST_PLUGIN;
+    EXPECT_TRUE(plugin);
+    EXPECT_EQ(16u, self_registry().find_type("PluginType").size_of());
+    EXPECT_EQ(0, dlclose(handle));
+    EXPECT_THROW(self_registry().find_type("PluginType"), std::out_of_range);
+}
+
+TEST(Init, Manual) {
+    if (manual_init())
+        return;
+
+    run_child("INSIGHT_INIT", "manual", "ManualInit.*");
+}
+
+TEST(Init, AlreadyInitialized) {
+    if (manual_init())
+        return;
+
+    EXPECT_THROW(initialize(InitOptions::from_environment()), std::logic_error);
+}
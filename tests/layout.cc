@@ -0,0 +1,63 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <gtest/gtest.h>
+#include "insight/insight"
+#include "insight/layout"
+
+using namespace Insight;
+
+struct LayoutTest {
+    char a;
+    double b;
+    char c;
+    int d;
+    char tail[60];
+};
+
+TEST(Layout, Holes) {
+    StructLayout layout = analyze_layout(type_of(LayoutTest));
+
+    ASSERT_EQ(5u, layout.members.size());
+    EXPECT_EQ(sizeof (LayoutTest), layout.size);
+
+    // 7 bytes after a, 3 after c, 4 of trailing padding
+    ASSERT_EQ(3u, layout.holes.size());
+    EXPECT_EQ(1u, layout.holes[0].offset);
+    EXPECT_EQ(7u, layout.holes[0].size);
+    EXPECT_EQ(14u, layout.wasted);
+}
+
+TEST(Layout, CacheLines) {
+    StructLayout layout = analyze_layout(type_of(LayoutTest));
+
+    ASSERT_EQ(2u, layout.cache_lines.size());
+    ASSERT_EQ(1u, layout.straddling.size());
+    EXPECT_EQ("tail", layout.members[layout.straddling[0]].name);
+    EXPECT_EQ(5u, layout.cache_lines[0].size());
+    EXPECT_EQ(1u, layout.cache_lines[1].size());
+}
+
+TEST(Layout, Reorder) {
+    StructLayout layout = analyze_layout(type_of(LayoutTest));
+
+    EXPECT_EQ(80u, layout.suggested_size);
+    EXPECT_EQ(8u, layout.savings());
+    EXPECT_EQ("b", layout.members[layout.suggested_order[0]].name);
+}
@@ -0,0 +1,141 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <dlfcn.h>
+#include <gtest/gtest.h>
+#include "insight/insight"
+#include "insight/registry"
+#include "child.hh"
+
+using namespace Insight;
+
+struct LazyBase {
+    int a;
+    virtual ~LazyBase() {}
+};
+
+struct LazyDerived : LazyBase {
+    long b;
+    int get_a() const;
+};
+
+// defined before the members of the type are built
+int LazyDerived::get_a() const {
+    return a;
+}
+
+struct LazyRoot {
+    int a;
+};
+
+struct LazyMiddle : LazyRoot {
+    int b;
+};
+
+struct LazyLeaf : LazyMiddle {
+    int c;
+};
+
+struct LazyShared {
+    int a;
+    long b;
+    LazyShared* next;
+};
+
+static bool lazy_members() {
+    return in_child("INSIGHT_LAZY_MEMBERS", "1");
+}
+
+// Run by Lazy.Members, along with the tests of the reflection of members,
+// in a process whose members are built on first access.
+TEST(LazyMembers, FirstAccess) {
+    if (!lazy_members())
+        return;
+
+    size_t deferred = self_registry().statistics().types_deferred;
+    EXPECT_LT(0u, deferred);
+
+    StructInfo& type = type_of(LazyDerived);
+    EXPECT_EQ(sizeof (LazyDerived), type.size_of());
+    EXPECT_EQ(sizeof (LazyBase), type.field("b").offset());
+    EXPECT_TRUE(type.is_supertype(type_of(LazyBase)));
+    EXPECT_TRUE(type_of(LazyBase).is_ancestor(type));
+    EXPECT_GT(deferred, self_registry().statistics().types_deferred);
+
+    LazyDerived derived;
+    derived.a = 42;
+    EXPECT_EQ(42, type.method("get_a").call<int>(derived));
+}
+
+TEST(LazyMembers, BasesStayDeferred) {
+    if (!lazy_members())
+        return;
+
+    size_t deferred = self_registry().statistics().types_deferred;
+    StructInfo& type = type_of(LazyLeaf);
+    EXPECT_EQ(sizeof (LazyMiddle), type.field("c").offset());
+    EXPECT_EQ(deferred - 1, self_registry().statistics().types_deferred);
+
+    EXPECT_TRUE(type_of(LazyRoot).is_ancestor(type));
+    EXPECT_FALSE(type.is_ancestor(type_of(LazyRoot)));
+}
+
+TEST(LazyMembers, ConcurrentFirstAccess) {
+    if (!lazy_members())
+        return;
+
+    const size_t count = 8;
+    std::atomic<bool> start(false);
+    std::vector<size_t> fields(count);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < count; ++i) {
+        threads.emplace_back([&, i] {
+            while (!start)
+                std::this_thread::yield();
+            for (auto& field : type_of(LazyShared).fields()) {
+                (void) field;
+                ++fields[i];
+            }
+        });
+    }
+
+    start = true;
+    void* handle = dlopen(INSIGHT_TEST_PLUGIN, RTLD_NOW);
+    EXPECT_NE(nullptr, handle);
+    if (handle) {
+        EXPECT_EQ(16u, self_registry().find_type("PluginType").size_of());
+        EXPECT_EQ(0, dlclose(handle));
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        threads[i].join();
+        EXPECT_EQ(3u, fields[i]);
+    }
+}
+
+TEST(Lazy, Members) {
+    if (lazy_members())
+        return;
+
+    run_child("INSIGHT_LAZY_MEMBERS", "1",
+              "LazyMembers.*:Virtual.*:Class.*:Annotation.*:Hash.*:Clone.*:Layout.*:Dedup.*:TypeUnits.*");
+}
@@ -0,0 +1,273 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <gtest/gtest.h>
+#include <dlfcn.h>
+#include <link.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include "insight/insight"
+#include "insight/registry"
+#include "insight/hash"
+
+using namespace Insight;
+
+long modules_test_variable = 7;
+
+int modules_test_function(int x) {
+    return x * 2;
+}
+
+static int first_object(struct dl_phdr_info* info, [[gnu::unused]] size_t size, void* data) {
+    *static_cast<uintptr_t*>(data) = info->dlpi_addr;
+    return 1;
+}
+
+TEST(Modules, Executable) {
+    uintptr_t bias = 0;
+    dl_iterate_phdr(first_object, &bias);
+
+    std::vector<ModuleInfo> modules = loaded_modules();
+    ASSERT_FALSE(modules.empty());
+    EXPECT_EQ(bias, modules[0].bias);
+    EXPECT_TRUE(modules[0].has_metadata);
+}
+
+TEST(Modules, RelocatedAddresses) {
+    void* function = nullptr;
+    for (auto& f : root_namespace().functions()) {
+        if (f.name() == "modules_test_function")
+            function = f.address();
+    }
+    void* variable = nullptr;
+    for (auto& v : root_namespace().variables()) {
+        if (v.name() == "modules_test_variable")
+            variable = v.address();
+    }
+    EXPECT_EQ(reinterpret_cast<void*>(&modules_test_function), function);
+    EXPECT_EQ(&modules_test_variable, variable);
+}
+
+TEST(Modules, UpdateIsIncremental) {
+    size_t count = loaded_modules().size();
+    update_modules();
+    EXPECT_EQ(count, loaded_modules().size());
+}
+
+TEST(Modules, LoadAndUnload) {
+    EXPECT_THROW(self_registry().find_type("PluginType"), std::out_of_range);
+
+    void* handle = dlopen(INSIGHT_TEST_PLUGIN, RTLD_NOW);
+    ASSERT_NE(nullptr, handle);
+    EXPECT_EQ(16u, self_registry().find_type("PluginType").size_of());
+
+    ASSERT_EQ(0, dlclose(handle));
+    EXPECT_THROW(self_registry().find_type("PluginType"), std::out_of_range);
+}
+
+// Installs a file in place of another, the way plugins are deployed.
+static void install(const std::string& from, const std::string& to) {
+    std::string temporary = to + ".new";
+    {
+        std::ifstream in(from, std::ios::binary);
+        std::ofstream out(temporary, std::ios::binary);
+        out << in.rdbuf();
+    }
+    ASSERT_EQ(0, rename(temporary.c_str(), to.c_str()));
+}
+
+// The loaded modules of a path, the current one once a reload dropped the
+// metadata of the previous one.
+static std::vector<ModuleInfo> find_modules(const std::string& path) {
+    std::vector<ModuleInfo> found;
+    for (auto& module : loaded_modules()) {
+        if (module.path == path)
+            found.push_back(module);
+    }
+    return found;
+}
+
+// Reloads a plugin behind the back of the hooks on dlopen and dlclose, so
+// that update_modules() finds the same object at its address, changed.
+static void test_reload(const char* first, const char* second, bool build_id) {
+    using dlopen_fn = void* (*)(const char*, int);
+    using dlclose_fn = int (*)(void*);
+    void* libc = dlopen("libc.so.6", RTLD_NOW | RTLD_NOLOAD);
+    ASSERT_NE(nullptr, libc);
+    auto real_dlopen = reinterpret_cast<dlopen_fn>(dlsym(libc, "dlopen"));
+    auto real_dlclose = reinterpret_cast<dlclose_fn>(dlsym(libc, "dlclose"));
+    if (!real_dlopen || !real_dlclose)
+        return;     // libdl is separate from the C library
+
+    char directory[] = "/tmp/insight-reload-XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(directory));
+    std::string path = std::string(directory) + "/plugin.so";
+    install(first, path);
+
+    void* handle = dlopen(path.c_str(), RTLD_NOW);
+    ASSERT_NE(nullptr, handle);
+    std::vector<ModuleInfo> modules = find_modules(path);
+    ASSERT_EQ(1u, modules.size());
+    std::string old_build_id = modules[0].build_id;
+    EXPECT_EQ(build_id, !old_build_id.empty());
+
+    TypeId plugin_type_id = type_id(self_registry().find_type("PluginType"));
+    TypeId state_id = type_id(self_registry().find_type("PluginState"));
+    TypeInfo& executable_type = self_registry().find_type("double");
+    EXPECT_EQ(4u, self_registry().find_type("PluginState").size_of());
+
+    ASSERT_EQ(0, real_dlclose(handle));
+    install(second, path);
+    handle = real_dlopen(path.c_str(), RTLD_NOW);
+    ASSERT_NE(nullptr, handle);
+    update_modules();
+
+    modules = find_modules(path);
+    ASSERT_EQ(1u, modules.size());
+    if (build_id) {
+        EXPECT_NE(old_build_id, modules[0].build_id);
+    }
+
+    TypeInfo& state = self_registry().find_type("PluginState");
+    EXPECT_EQ(16u, state.size_of());
+    EXPECT_NE(state_id, type_id(state));
+    EXPECT_EQ(plugin_type_id, type_id(self_registry().find_type("PluginType")));
+    EXPECT_EQ(&executable_type, &self_registry().find_type("double"));
+
+    ASSERT_EQ(0, dlclose(handle));
+    EXPECT_THROW(self_registry().find_type("PluginState"), std::out_of_range);
+    unlink(path.c_str());
+    rmdir(directory);
+}
+
+TEST(Modules, ReloadByBuildId) {
+    test_reload(INSIGHT_TEST_PLUGIN, INSIGHT_TEST_PLUGIN_V2, true);
+}
+
+TEST(Modules, ReloadByModificationTime) {
+    test_reload(INSIGHT_TEST_PLUGIN_NOID, INSIGHT_TEST_PLUGIN_NOID_V2, false);
+}
+
+// The plans of a type must go with it: the next version of a type may be
+// allocated where the previous one was.
+TEST(Modules, PlansOfUnloadedTypes) {
+    void* handle = dlopen(INSIGHT_TEST_PLUGIN, RTLD_NOW);
+    ASSERT_NE(nullptr, handle);
+    void* state = dlsym(handle, "plugin_state");
+    ASSERT_NE(nullptr, state);
+    TypeInfo& type = self_registry().find_type("PluginState");
+    ASSERT_EQ(4u, type.size_of());
+    hash_(state, type, PointerPolicy::ADDRESS);
+    ASSERT_EQ(0, dlclose(handle));
+
+    handle = dlopen(INSIGHT_TEST_PLUGIN_V2, RTLD_NOW);
+    ASSERT_NE(nullptr, handle);
+    struct { int count; long total; } a = {1, 2}, b = {1, 3};
+    TypeInfo& reloaded = self_registry().find_type("PluginState");
+    ASSERT_EQ(sizeof (a), reloaded.size_of());
+    EXPECT_NE(hash_(&a, reloaded, PointerPolicy::ADDRESS), hash_(&b, reloaded, PointerPolicy::ADDRESS));
+    EXPECT_FALSE(equals_(&a, &b, reloaded, PointerPolicy::ADDRESS));
+    ASSERT_EQ(0, dlclose(handle));
+}
+
+TEST(Modules, TypeIdDependsOnLayout) {
+    TypeInfo& type = self_registry().find_type("double");
+    EXPECT_EQ(type_id(type), type_id(type));
+    EXPECT_NE(type_id(type), type_id(self_registry().find_type("int")));
+}
+
+static long private_dirty_kb() {
+    std::ifstream in("/proc/self/smaps_rollup");
+    std::string line;
+    long total = -1;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 14, "Private_Dirty:") == 0)
+            total = atol(line.c_str() + 14);
+    }
+    return total;
+}
+
+static size_t read_everything(const Container& container) {
+    size_t count = 0;
+    for (auto& type : container.types()) {
+        count += type.size_of();
+        if (auto* info = dynamic_cast<const StructInfo*>(&type)) {
+            for (auto& field : info->fields())
+                count += field.type().size_of();
+            for (auto& method : info->methods()) {
+                count += method.return_type().size_of();
+                for (auto& param : method.parameters())
+                    count += param.type().size_of();
+            }
+            for (auto& super : info->supertypes())
+                count += super.size_of();
+        } else if (auto* info = dynamic_cast<const PointerTypeInfo*>(&type)) {
+            count += info->pointed_type().size_of();
+        } else if (auto* info = dynamic_cast<const TypeDefInfo*>(&type)) {
+            count += info->aliased_type().size_of();
+        }
+    }
+    for (auto& function : container.functions()) {
+        count += function.return_type().size_of();
+        for (auto& param : function.parameters())
+            count += param.type().size_of();
+    }
+    for (auto& variable : container.variables())
+        count += variable.type().size_of();
+    if (auto* ns = dynamic_cast<const NamespaceInfo*>(&container)) {
+        for (auto& nested : ns->nested_namespaces())
+            count += read_everything(nested);
+    }
+    return count;
+}
+
+TEST(Modules, ForkedReadersShareMetadata) {
+    if (private_dirty_kb() < 0)
+        return;     // no smaps_rollup before Linux 4.14
+
+    complete_metadata();
+
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    pid_t pid = fork();
+    ASSERT_NE(-1, pid);
+    if (!pid) {
+        long before = private_dirty_kb();
+        size_t count = read_everything(root_namespace());
+        long dirtied = private_dirty_kb() - before;
+        ssize_t written = write(fds[1], &dirtied, sizeof (dirtied));
+        _exit(count && written == sizeof (dirtied) ? 0 : 1);
+    }
+    close(fds[1]);
+    long dirtied = -1;
+    ASSERT_EQ(static_cast<ssize_t>(sizeof (dirtied)), read(fds[0], &dirtied, sizeof (dirtied)));
+    close(fds[0]);
+    int status;
+    ASSERT_EQ(pid, waitpid(pid, &status, 0));
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(0, WEXITSTATUS(status));
+
+    // reading copies a few pages of the stack and of the locks, not the
+    // tens of megabytes of the metadata
+    EXPECT_LT(dirtied, 1024);
+}
@@ -0,0 +1,41 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+struct PluginType {
+    int value;
+    double weight;
+};
+
+PluginType plugin_instance = {1, 2.0};
+
+// changed by the second version of the plugin, to test reloads
+#if PLUGIN_VERSION >= 2
+struct PluginState {
+    int count;
+    long total;
+};
+
+PluginState plugin_state = {1, 2};
+#else
+struct PluginState {
+    int count;
+};
+
+PluginState plugin_state = {1};
+#endif
@@ -0,0 +1,97 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "insight/insight"
+#include "insight/process"
+
+using namespace Insight;
+
+long process_test_value = 42;
+
+TEST(Process, ReadVariable) {
+    Process process(getpid());
+
+    const VariableInfo* variable = nullptr;
+    for (auto& v : process.root_namespace().variables()) {
+        if (v.name() == "process_test_value")
+            variable = &v;
+    }
+    ASSERT_NE(nullptr, variable);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(&process_test_value), process.address_of(*variable));
+
+    long value = 0;
+    ASSERT_TRUE(process.read(*variable, &value));
+    EXPECT_EQ(42, value);
+}
+
+TEST(Process, BatchedReads) {
+    long values[3] = {1, 2, 3};
+    long out[3] = {0, 0, 0};
+
+    ProcessAddressSpace space(getpid());
+    AddressSpace::Read reads[3] = {
+        {reinterpret_cast<uintptr_t>(&values[0]), &out[0], sizeof (long), false},
+        {0, &out[1], sizeof (long), false},
+        {reinterpret_cast<uintptr_t>(&values[2]), &out[2], sizeof (long), false},
+    };
+    space.read(reads, 3);
+
+    EXPECT_TRUE(reads[0].ok);
+    EXPECT_FALSE(reads[1].ok);
+    EXPECT_TRUE(reads[2].ok);
+    EXPECT_EQ(1, out[0]);
+    EXPECT_EQ(3, out[2]);
+}
+
+// pages unmapped after the mappings were read fail in process_vm_readv
+// itself, which stops at the first element it cannot read
+TEST(Process, BatchedReadsAcrossHoles) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    char* pages = static_cast<char*>(mmap(nullptr, 3 * page, PROT_READ | PROT_WRITE,
+                                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    ASSERT_NE(MAP_FAILED, pages);
+    for (size_t i = 0; i < 3; ++i)
+        *reinterpret_cast<long*>(pages + i * page) = i + 1;
+
+    ProcessAddressSpace space(getpid());
+    ASSERT_EQ(0, munmap(pages + page, page));
+
+    long out[4] = {0, 0, 0, 0};
+    uintptr_t base = reinterpret_cast<uintptr_t>(pages);
+    AddressSpace::Read reads[4] = {
+        {base + page, &out[0], sizeof (long), false},
+        {base, &out[1], sizeof (long), false},
+        {base + page, &out[2], sizeof (long), false},
+        {base + 2 * page, &out[3], sizeof (long), false},
+    };
+    space.read(reads, 4);
+
+    EXPECT_FALSE(reads[0].ok);
+    EXPECT_TRUE(reads[1].ok);
+    EXPECT_FALSE(reads[2].ok);
+    EXPECT_TRUE(reads[3].ok);
+    EXPECT_EQ(1, out[1]);
+    EXPECT_EQ(3, out[3]);
+
+    munmap(pages, page);
+    munmap(pages + 2 * page, page);
+}
@@ -0,0 +1,138 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <gtest/gtest.h>
+#include <future>
+#include <stdexcept>
+#include "insight/insight"
+#include "insight/registry"
+
+using namespace Insight;
+
+struct RegistryTest {
+    int a;
+    double b;
+};
+
+namespace Filtered {
+    struct Kept {
+        int a;
+    } kept;
+
+    namespace Nested {
+        struct Deep {
+            int b;
+        } deep;
+    }
+}
+
+namespace Unfiltered {
+    struct Skipped {
+        int c;
+    } skipped;
+}
+
+TEST(Registry, Self) {
+    EXPECT_EQ(&type_of(RegistryTest), &self_registry().find_type("RegistryTest"));
+    EXPECT_EQ(&root_namespace(), &self_registry().root_namespace());
+}
+
+TEST(Registry, LoadFromFile) {
+    std::shared_ptr<Registry> registry = load_registry("/proc/self/exe");
+
+    TypeInfo& type = registry->find_type("RegistryTest");
+    EXPECT_NE(&type_of(RegistryTest), &type);
+    EXPECT_EQ(sizeof (RegistryTest), type.size_of());
+    EXPECT_EQ("/proc/self/exe", registry->path());
+}
+
+TEST(Registry, ConcurrentLoads) {
+    auto load = [] { return load_registry("/proc/self/exe"); };
+    std::future<std::shared_ptr<Registry>> first = std::async(std::launch::async, load);
+    std::future<std::shared_ptr<Registry>> second = std::async(std::launch::async, load);
+
+    std::shared_ptr<Registry> a = first.get();
+    std::shared_ptr<Registry> b = second.get();
+    EXPECT_NE(&a->find_type("RegistryTest"), &b->find_type("RegistryTest"));
+    EXPECT_EQ(a->find_type("RegistryTest").size_of(), b->find_type("RegistryTest").size_of());
+}
+
+TEST(Registry, SeparateDebugFile) {
+    std::shared_ptr<Registry> registry = load_registry(INSIGHT_TEST_STRIPPED_PLUGIN);
+    EXPECT_EQ(16u, registry->find_type("PluginType").size_of());
+    EXPECT_EQ(INSIGHT_TEST_STRIPPED_PLUGIN, registry->path());
+}
+
+TEST(Registry, Statistics) {
+    std::shared_ptr<Registry> registry = load_registry("/proc/self/exe");
+    LoadStatistics stats = registry->statistics();
+    EXPECT_LT(0u, stats.units_loaded);
+    EXPECT_LT(0, stats.load_time.count());
+    EXPECT_LE(stats.units_loaded, self_registry().statistics().units_loaded);
+}
+
+static void test_compressed(const char* path) {
+    std::shared_ptr<Registry> registry = load_registry(path);
+    EXPECT_EQ(16u, registry->find_type("PluginType").size_of());
+
+    LoadStatistics stats = registry->statistics();
+    EXPECT_LT(0u, stats.compressed_bytes);
+    EXPECT_LT(0u, stats.decompressed_bytes);
+}
+
+TEST(Registry, ZlibSections) {
+    test_compressed(INSIGHT_TEST_PLUGIN_ZLIB);
+}
+
+#ifdef INSIGHT_TEST_PLUGIN_ZSTD
+TEST(Registry, ZstdSections) {
+    test_compressed(INSIGHT_TEST_PLUGIN_ZSTD);
+}
+#endif
+
+TEST(Registry, NamespaceFilter) {
+    LoadFilter filter;
+    filter.namespaces = {"Filtered::Nested"};
+    std::shared_ptr<Registry> registry = load_registry("/proc/self/exe", filter);
+
+    EXPECT_EQ(sizeof (Filtered::Nested::Deep), registry->find_type("Filtered::Nested::Deep").size_of());
+    EXPECT_EQ(sizeof (RegistryTest), registry->find_type("RegistryTest").size_of());
+    EXPECT_THROW(registry->find_type("Filtered::Kept"), std::out_of_range);
+    EXPECT_THROW(registry->find_namespace("Unfiltered"), std::out_of_range);
+    EXPECT_THROW(registry->find_namespace("std"), std::out_of_range);
+}
+
+TEST(Registry, UnitFilter) {
+    LoadFilter filter;
+    filter.units = {"registry.cc"};
+    std::shared_ptr<Registry> registry = load_registry("/proc/self/exe", filter);
+    EXPECT_EQ(sizeof (RegistryTest), registry->find_type("RegistryTest").size_of());
+    EXPECT_THROW(registry->find_type("DedupShared"), std::out_of_range);
+
+    std::string file = __FILE__;
+    filter.units.clear();
+    filter.source_paths = {file.substr(0, file.rfind('/'))};
+    registry = load_registry("/proc/self/exe", filter);
+    EXPECT_EQ(sizeof (RegistryTest), registry->find_type("RegistryTest").size_of());
+    EXPECT_NO_THROW(registry->find_type("DedupShared"));
+
+    filter.source_paths = {file.substr(0, file.rfind('/')) + "-other"};
+    registry = load_registry("/proc/self/exe", filter);
+    EXPECT_THROW(registry->find_type("RegistryTest"), std::out_of_range);
+}
@@ -0,0 +1,93 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <gtest/gtest.h>
+#include "insight/insight"
+#include "insight/sharing"
+
+using namespace Insight;
+
+struct SharingTest {
+    std::atomic<long> produced;
+    std::atomic<long> consumed;
+    alignas(64) std::mutex lock;
+    int config;
+};
+
+template <typename T>
+struct SharingBox {
+    int value;
+};
+
+struct SharingOwnerTest {
+    SharingBox<std::mutex> box;
+    std::vector<std::atomic<int>> counters;
+    std::unique_ptr<std::mutex> lock;
+    std::mutex* shared;
+    std::atomic<int> state[2];
+};
+
+struct SharingAnnotatedTest {
+    $(Insight::HotWrite, .group = 0)
+    long hits;
+
+    $(Insight::HotWrite, .group = 1)
+    long misses;
+
+    $(Insight::HotWrite, .group = 1)
+    long evictions;
+};
+
+TEST(Sharing, Atomics) {
+    SharingReport report = analyze_sharing(type_of(SharingTest));
+
+    ASSERT_EQ(3u, report.fields.size());
+    EXPECT_EQ("produced", report.fields[0].name);
+    EXPECT_EQ(ConcurrentField::SYNCHRONIZATION, report.fields[0].reason);
+
+    // the mutex is on its own cache line, but both counters share one
+    ASSERT_EQ(1u, report.conflicts.size());
+    EXPECT_EQ(0u, report.conflicts[0].index);
+    EXPECT_EQ(2u, report.conflicts[0].writers);
+}
+
+// containers and pointers of synchronization objects are written through,
+// not in place
+TEST(Sharing, Owners) {
+    SharingReport report = analyze_sharing(type_of(SharingOwnerTest));
+
+    ASSERT_EQ(2u, report.fields.size());
+    EXPECT_EQ("state[0]", report.fields[0].name);
+    EXPECT_EQ("state[1]", report.fields[1].name);
+}
+
+TEST(Sharing, Annotated) {
+    SharingReport report = analyze_sharing(type_of(SharingAnnotatedTest));
+
+    ASSERT_EQ(3u, report.fields.size());
+    EXPECT_EQ(ConcurrentField::ANNOTATED, report.fields[0].reason);
+
+    // misses and evictions are written by the same thread
+    ASSERT_EQ(1u, report.conflicts.size());
+    EXPECT_EQ(2u, report.conflicts[0].writers);
+}
@@ -0,0 +1,55 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <gtest/gtest.h>
+#include "insight/insight"
+#include "insight/registry"
+
+using namespace Insight;
+
+// This file is built with -gsplit-dwarf, so its types are only described in
+// its .dwo file.
+struct SplitDwarfType {
+    long a;
+    char b;
+};
+
+SplitDwarfType split_dwarf_instance;
+
+TEST(SplitDwarf, LazyLookup) {
+    TypeInfo& type = type_of(SplitDwarfType);
+    EXPECT_EQ(sizeof (SplitDwarfType), type.size_of());
+    EXPECT_EQ(&type, &type_of(split_dwarf_instance));
+}
+
+#ifdef INSIGHT_TEST_PACKAGE
+TEST(SplitDwarf, PackageUnitsLoadedOneAtATime) {
+    std::shared_ptr<Registry> registry = load_registry(INSIGHT_TEST_PACKAGE);
+    EXPECT_EQ(0u, registry->statistics().units_loaded);
+    EXPECT_EQ(2u, registry->statistics().units_deferred);
+
+    EXPECT_EQ(sizeof (int), registry->find_type("PackagedType").size_of());
+    EXPECT_EQ(1u, registry->statistics().units_loaded);
+    EXPECT_EQ(1u, registry->statistics().units_deferred);
+
+    EXPECT_EQ(sizeof (double), registry->find_type("OtherPackagedType").size_of());
+    EXPECT_EQ(2u, registry->statistics().units_loaded);
+    EXPECT_EQ(0u, registry->statistics().units_deferred);
+}
+#endif
@@ -18,6 +18,7 @@
  *
  */
 #include <gtest/gtest.h>
+#include <dlfcn.h>
 #include "insight/insight"
 
 using namespace Insight;
@@ -138,3 +139,25 @@ TEST(Typeof, Expression) {
     EXPECT_EQ(type_of(TypeofTest(42)), type_of(TypeofTest));
     EXPECT_EQ(type_of(TypeofUnionTest({42})), type_of(TypeofUnionTest));
 }
+
+TEST(Typeof, NestedScope) {
+    for (int i = 0; i < 2; ++i) {
+        if (i) {
+            EXPECT_EQ(type_of(short), type_of(short int));
+        }
+    }
+
+    auto lambda = [] () -> TypeInfo& { return type_of(TypeofTest); };
+    EXPECT_EQ(lambda(), type_of(TypeofTest));
+}
+
+// The records of the plugin are zeroed in its file, they are read from its
+// relocated memory.
+TEST(Typeof, RelocatedRecords) {
+    void* handle = dlopen(INSIGHT_TEST_TYPEOF_PLUGIN, RTLD_NOW);
+    ASSERT_NE(nullptr, handle);
+    auto size = reinterpret_cast<size_t (*)()>(dlsym(handle, "typeof_plugin_size"));
+    ASSERT_NE(nullptr, size);
+    EXPECT_EQ(16u, size());
+    dlclose(handle);
+}
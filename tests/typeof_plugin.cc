@@ -0,0 +1,32 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <cstddef>
+#include "insight/insight"
+
+// Built into a plugin whose file has its typeof records zeroed, as linked by
+// linkers leaving them to the dynamic relocations.
+struct TypeofPluginType {
+    int a;
+    char b[12];
+};
+
+extern "C" size_t typeof_plugin_size() {
+    return type_of(TypeofPluginType).size_of();
+}
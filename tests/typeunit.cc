@@ -0,0 +1,55 @@
+/*
+ * This file is part of Insight.
+ *
+ * Copyright © 2015 Franklin "Snaipe" Mathieu <http://snaipe.me>
+ *
+ * Insight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Insight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Insight.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <gtest/gtest.h>
+#include "insight/insight"
+#include "typeunit.hh"
+
+using namespace Insight;
+
+// This file is built with -fdebug-types-section, so its types are described
+// by DWARF 5 type units and referenced by their signature. typeunit4.cc
+// does the same with the .debug_types section of DWARF 4.
+int TypeUnits::Point::sum() const {
+    return x + y;
+}
+
+TypeUnits::Point type_unit_point;
+
+TEST(TypeUnits, Signature) {
+    StructInfo& type = type_of(TypeUnits::Point);
+    EXPECT_EQ(sizeof (TypeUnits::Point), type.size_of());
+    EXPECT_EQ(&type, &root_namespace().variable("type_unit_point").type());
+    EXPECT_EQ(offsetof(TypeUnits::Point, y), type.field("y").offset());
+
+    auto& next = dynamic_cast<PointerTypeInfo&>(type.field("next").type());
+    EXPECT_EQ(&type, &next.pointed_type());
+
+    TypeUnits::Point point{1, 2, nullptr};
+    EXPECT_EQ(3, type.method("sum").call<int>(point));
+}
+
+TEST(TypeUnits, DebugTypesSection) {
+    StructInfo& type = type_of(TypeUnits::Legacy);
+    EXPECT_EQ(sizeof (TypeUnits::Legacy), type.size_of());
+    EXPECT_EQ(&type_of(TypeUnits::Point), &type.field("b").type());
+
+    TypeUnits::Legacy legacy{42, {}};
+    EXPECT_EQ(42, type.method("get_a").call<long>(legacy));
+}